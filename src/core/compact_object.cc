@@ -27,6 +27,8 @@ extern "C" {
 #include "base/pod_array.h"
 #include "core/bloom.h"
 #include "core/detail/bitpacking.h"
+#include "core/huff_coder.h"
+#include "core/ring_list.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
 #include "core/string_set.h"
@@ -198,12 +200,18 @@ static_assert(ascii_len(14) == 16);
 static_assert(ascii_len(15) == 17);
 static_assert(ascii_len(16) == 18);
 static_assert(ascii_len(17) == 19);
+static_assert(kEncodingRingList == OBJ_ENCODING_RINGLIST);
 
 struct TL {
   MemoryResource* local_mr = PMR_NS::get_default_resource();
   size_t small_str_bytes;
   base::PODArray<uint8_t> tmp_buf;
   string tmp_str;
+
+  HuffmanEncoder huff_encoder;
+  HuffmanDecoder huff_decoder;
+  string huff_table;
+  uint64_t huff_encode_total = 0, huff_encode_success = 0;
 };
 
 thread_local TL tl;
@@ -214,6 +222,8 @@ constexpr bool kUseSmallStrings = true;
 /// file and implement with SIMD instructions.
 constexpr bool kUseAsciiEncoding = true;
 
+constexpr size_t kMaxHuffLen = CompactObj::MaxHuffLen();
+
 }  // namespace
 
 static_assert(sizeof(CompactObj) == 18);
@@ -229,6 +239,8 @@ size_t RobjWrapper::MallocUsed() const {
       CHECK_EQ(OBJ_ENCODING_RAW, encoding_);
       return InnerObjMallocUsed();
     case OBJ_LIST:
+      if (encoding_ == kEncodingRingList)
+        return ((RingList*)inner_obj_)->MallocUsed() + zmalloc_usable_size(inner_obj_);
       DCHECK_EQ(encoding_, OBJ_ENCODING_QUICKLIST);
       return QlMAllocSize((quicklist*)inner_obj_);
     case OBJ_SET:
@@ -253,6 +265,8 @@ size_t RobjWrapper::Size() const {
       DCHECK_EQ(OBJ_ENCODING_RAW, encoding_);
       return sz_;
     case OBJ_LIST:
+      if (encoding_ == kEncodingRingList)
+        return ((RingList*)inner_obj_)->Size();
       return quicklistCount((quicklist*)inner_obj_);
     case OBJ_ZSET: {
       switch (encoding_) {
@@ -308,6 +322,10 @@ void RobjWrapper::Free(MemoryResource* mr) {
       mr->deallocate(inner_obj_, 0, 8);  // we do not keep the allocated size.
       break;
     case OBJ_LIST:
+      if (encoding_ == kEncodingRingList) {
+        CompactObj::DeleteMR<RingList>(inner_obj_);
+        break;
+      }
       CHECK_EQ(encoding_, OBJ_ENCODING_QUICKLIST);
       quicklistRelease((quicklist*)inner_obj_);
       break;
@@ -525,6 +543,8 @@ using namespace std;
 auto CompactObj::GetStats() -> Stats {
   Stats res;
   res.small_string_bytes = tl.small_str_bytes;
+  res.huff_encode_total = tl.huff_encode_total;
+  res.huff_encode_success = tl.huff_encode_success;
 
   return res;
 }
@@ -534,6 +554,30 @@ void CompactObj::InitThreadLocal(MemoryResource* mr) {
   tl.tmp_buf = base::PODArray<uint8_t>{mr};
 }
 
+bool CompactObj::InitHuffmanThreadLocal(std::string_view hufftable) {
+  tl.huff_table.clear();
+  if (hufftable.empty()) {
+    tl.huff_encoder.Reset();
+    tl.huff_decoder.Reset();
+    return true;
+  }
+
+  string err_msg;
+  if (!tl.huff_encoder.Load(hufftable, &err_msg) || !tl.huff_decoder.Load(hufftable, &err_msg)) {
+    LOG(ERROR) << "Failed to load huffman table: " << err_msg;
+    tl.huff_encoder.Reset();
+    tl.huff_decoder.Reset();
+    return false;
+  }
+
+  tl.huff_table = hufftable;
+  return true;
+}
+
+string_view CompactObj::GetHuffmanTable() {
+  return tl.huff_table;
+}
+
 CompactObj::~CompactObj() {
   if (HasAllocated()) {
     Free();
@@ -557,6 +601,8 @@ size_t CompactObj::Size() const {
   size_t raw_size = 0;
 
   if (IsInline()) {
+    if ((mask_ & kEncMask) == kHuffmanEnc)
+      return uint8_t(u_.inline_str[0]);
     raw_size = taglen_;
   } else {
     switch (taglen_) {
@@ -587,6 +633,12 @@ uint64_t CompactObj::HashCode() const {
 
   uint8_t encoded = (mask_ & kEncMask);
   if (IsInline()) {
+    if (encoded == kHuffmanEnc) {
+      char buf[kMaxHuffLen];
+      DecodeHuffman(buf);
+      return XXH3_64bits_withSeed(buf, Size(), kHashSeed);
+    }
+
     if (encoded) {
       char buf[kInlineLen * 2];
       size_t decoded_len = DecodedLen(taglen_);
@@ -763,6 +815,18 @@ void CompactObj::SetString(std::string_view str) {
 
   DCHECK_GT(str.size(), kInlineLen);
 
+  if (tl.huff_encoder.valid() && str.size() <= kMaxHuffLen) {
+    ++tl.huff_encode_total;
+    size_t encoded_len = (tl.huff_encoder.EncodedBits(str) + 7) / 8;
+    if (encoded_len < kInlineLen) {
+      ++tl.huff_encode_success;
+      SetMeta(encoded_len + 1, mask | kHuffmanEnc);
+      u_.inline_str[0] = str.size();
+      tl.huff_encoder.Encode(str, reinterpret_cast<uint8_t*>(u_.inline_str + 1));
+      return;
+    }
+  }
+
   string_view encoded = str;
   bool is_ascii = kUseAsciiEncoding && detail::validate_ascii_fast(str.data(), str.size());
 
@@ -814,6 +878,12 @@ string_view CompactObj::GetSlice(string* scratch) const {
   uint8_t is_encoded = mask_ & kEncMask;
 
   if (IsInline()) {
+    if (is_encoded == kHuffmanEnc) {
+      scratch->resize(Size());
+      DecodeHuffman(scratch->data());
+      return *scratch;
+    }
+
     if (is_encoded) {
       size_t decoded_len = taglen_ + 2;
 
@@ -920,7 +990,9 @@ void CompactObj::GetString(char* dest) const {
   uint8_t is_encoded = mask_ & kEncMask;
 
   if (IsInline()) {
-    if (is_encoded) {
+    if (is_encoded == kHuffmanEnc) {
+      DecodeHuffman(dest);
+    } else if (is_encoded) {
       size_t decoded_len = taglen_ + 2;
 
       // must be this because we either shortened 17 or 18.
@@ -1100,6 +1172,21 @@ bool CompactObj::EqualNonInline(std::string_view sv) const {
 }
 
 bool CompactObj::CmpEncoded(string_view sv) const {
+  if ((mask_ & kEncMask) == kHuffmanEnc) {
+    DCHECK(IsInline());
+    if (sv.size() != Size())
+      return false;
+
+    // Huffman encoding is deterministic, so we compare the codes without decoding.
+    size_t huff_len = (tl.huff_encoder.EncodedBits(sv) + 7) / 8;
+    if (huff_len + 1 != taglen_)
+      return false;
+
+    uint8_t buf[kInlineLen];
+    tl.huff_encoder.Encode(sv, buf);
+    return memcmp(buf, u_.inline_str + 1, huff_len) == 0;
+  }
+
   size_t encode_len = binpacked_len(sv.size());
 
   if (IsInline()) {
@@ -1174,6 +1261,21 @@ bool CompactObj::CmpEncoded(string_view sv) const {
   return false;
 }
 
+bool CompactObj::DecodeHuffman(char* dest) const {
+  DCHECK_EQ(mask_ & kEncMask, kHuffmanEnc);
+
+  if (tl.huff_decoder.valid() &&
+      tl.huff_decoder.Decode(to_byte(u_.inline_str + 1), taglen_ - 1, Size(), dest)) {
+    return true;
+  }
+
+  // The table of a thread is only installed while it has no encoded strings, so this means
+  // the string is corrupted.
+  LOG(DFATAL) << "Could not decode huffman encoded string of size " << Size();
+  memset(dest, 0, Size());
+  return false;
+}
+
 size_t CompactObj::DecodedLen(size_t sz) const {
   return ascii_len(sz) - ((mask_ & ASCII1_ENC_BIT) ? 1 : 0);
 }
@@ -19,6 +19,9 @@ constexpr unsigned kEncodingIntSet = 0;
 constexpr unsigned kEncodingStrMap = 1;   // for set/map encodings of strings
 constexpr unsigned kEncodingStrMap2 = 2;  // for set/map encodings of strings using DenseSet
 constexpr unsigned kEncodingListPack = 3;
+// For small lists, see RingList. Must match OBJ_ENCODING_RINGLIST so that DEBUG OBJECT
+// does not report it as another list encoding.
+constexpr unsigned kEncodingRingList = 12;
 constexpr unsigned kEncodingJsonCons = 0;
 constexpr unsigned kEncodingJsonFlat = 1;
 
@@ -135,6 +138,11 @@ class CompactObj {
 
   static constexpr uint8_t kEncMask = ASCII1_ENC_BIT | ASCII2_ENC_BIT;
 
+  // Both ascii bits are never set together by ascii encoding, so we use this combination to mark
+  // inline strings encoded with the thread-local huffman table. The first inline byte holds
+  // the decoded length, and the rest holds the code.
+  static constexpr uint8_t kHuffmanEnc = kEncMask;
+
  public:
   using PrefixArray = std::vector<std::string_view>;
   using MemoryResource = detail::RobjWrapper::MemoryResource;
@@ -340,13 +348,28 @@ class CompactObj {
     return kInlineLen;
   }
 
+  // Longest string that may be huffman encoded inline. Huffman codes are at least one bit long,
+  // and one inline byte is reserved for the length.
+  static constexpr unsigned MaxHuffLen() {
+    return (kInlineLen - 1) * 8;
+  }
+
   struct Stats {
     size_t small_string_bytes = 0;
+    uint64_t huff_encode_total = 0, huff_encode_success = 0;
   };
 
   static Stats GetStats();
 
   static void InitThreadLocal(MemoryResource* mr);
+
+  // Loads the huffman table (as exported by HuffmanEncoder) for encoding short strings.
+  // Must be called on every thread that accesses objects before any string is encoded with it.
+  // An empty table disables huffman encoding.
+  static bool InitHuffmanThreadLocal(std::string_view hufftable);
+
+  // Returns the thread-local huffman table or an empty string if it was not set.
+  static std::string_view GetHuffmanTable();
   static MemoryResource* memory_resource();  // thread-local.
 
   template <typename T>
@@ -385,6 +408,10 @@ class CompactObj {
 
   bool CmpEncoded(std::string_view sv) const;
 
+  // Requires: huffman encoded. dest must have at least Size() bytes available.
+  // Returns false and zero-fills dest if the thread-local table can not decode the string.
+  bool DecodeHuffman(char* dest) const;
+
   void SetMeta(uint8_t taglen, uint8_t mask = 0) {
     if (HasAllocated()) {
       Free();
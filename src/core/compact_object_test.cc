@@ -14,6 +14,7 @@
 #include "base/logging.h"
 #include "core/detail/bitpacking.h"
 #include "core/flat_set.h"
+#include "core/huff_coder.h"
 #include "core/mi_memory_resource.h"
 
 extern "C" {
@@ -320,6 +321,70 @@ TEST_F(CompactObjectTest, AsciiUtil) {
   ASSERT_EQ(data3, act_str);
 }
 
+TEST_F(CompactObjectTest, HuffCoder) {
+  unsigned hist[256] = {0};
+  string_view sample = "0123456789abcdef:";
+  for (unsigned i = 0; i < 1000; ++i) {
+    for (char c : sample)
+      hist[uint8_t(c)] += 100;
+  }
+
+  HuffmanEncoder encoder;
+  string err_msg;
+  ASSERT_TRUE(encoder.Build(hist, HuffmanEncoder::kMaxCodeBits, &err_msg)) << err_msg;
+  string table = encoder.Export();
+
+  HuffmanDecoder decoder;
+  ASSERT_TRUE(decoder.Load(table, &err_msg)) << err_msg;
+
+  for (string_view str : {"user:0a1b2c3d4e5f6789", "a", "\xff\x01 out of sample"}) {
+    vector<uint8_t> buf((encoder.EncodedBits(str) + 7) / 8);
+    size_t len = encoder.Encode(str, buf.data());
+    ASSERT_EQ(buf.size(), len);
+    string decoded(str.size(), ' ');
+    ASSERT_TRUE(decoder.Decode(buf.data(), len, str.size(), decoded.data()));
+    EXPECT_EQ(str, decoded);
+  }
+
+  // Hex ids are encoded with less than 5 bits per character.
+  EXPECT_LT(encoder.EncodedBits("0123456789abcdef0123"), 20 * 5);
+  EXPECT_FALSE(decoder.Load("bad table", &err_msg));
+}
+
+TEST_F(CompactObjectTest, InlineHuffmanEncoded) {
+  unsigned hist[256] = {0};
+  for (char c : string_view{"0123456789abcdef:"})
+    hist[uint8_t(c)] = 1000;
+
+  HuffmanEncoder encoder;
+  string err_msg;
+  ASSERT_TRUE(encoder.Build(hist, HuffmanEncoder::kMaxCodeBits, &err_msg));
+  ASSERT_TRUE(CompactObj::InitHuffmanThreadLocal(encoder.Export()));
+
+  string key = "id:0123456789abcdef0123";  // 23 characters do not fit inline otherwise.
+  cobj_.SetString(key);
+  EXPECT_TRUE(cobj_.IsInline());
+  EXPECT_EQ(key.size(), cobj_.Size());
+  EXPECT_EQ(key, cobj_.ToString());
+  EXPECT_EQ(cobj_.HashCode(), CompactObj::HashCode(key));
+  EXPECT_EQ(cobj_, key);
+  EXPECT_NE(cobj_, "id:0123456789abcdef0124");
+  EXPECT_NE(cobj_, "id:0123456789abcdef012");
+
+  CompactObj other(key);
+  EXPECT_EQ(cobj_, other);
+
+  // Strings that do not compress well fall back to other encodings.
+  string value(40, 'x');
+  cobj_.SetString(value);
+  EXPECT_FALSE(cobj_.IsInline());
+  EXPECT_EQ(value, cobj_.ToString());
+
+  ASSERT_TRUE(CompactObj::InitHuffmanThreadLocal(""));
+  cobj_.Reset();
+  other.Reset();
+}
+
 TEST_F(CompactObjectTest, IntSet) {
   intset* is = intsetNew();
   cobj_.InitRobj(OBJ_SET, kEncodingIntSet, is);
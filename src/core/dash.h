@@ -736,13 +736,17 @@ void DashTable<_Key, _Value, Policy>::Reserve(size_t size) {
     return;
 
   size_t sg_floor = (size - 1) / SegmentType::capacity();
-  if (sg_floor < segment_.size()) {
-    return;
-  }
-  assert(sg_floor > 1u);
+  assert(sg_floor > 0u);
   unsigned new_depth = 1 + (63 ^ __builtin_clzll(sg_floor));
 
-  IncreaseDepth(new_depth);
+  if (new_depth > global_depth_)
+    IncreaseDepth(new_depth);
+
+  // Allocate the segments upfront, so that filling the table up to size does not split them.
+  for (size_t i = 0; i < segment_.size(); ++i) {
+    while (segment_[i]->local_depth() < new_depth)
+      Split(i);
+  }
 }
 
 template <typename _Key, typename _Value, typename Policy>
@@ -501,7 +501,15 @@ TEST_F(DashTest, Reserve) {
   for (unsigned i = 0; i <= bc * 2; ++i) {
     dt_.Reserve(i);
     ASSERT_GE((1 << dt_.depth()) * Dash64::kSegCapacity, i);
+    ASSERT_GE(dt_.capacity(), i);
   }
+
+  // Filling the reserved table does not allocate segments.
+  size_t segments = dt_.unique_segments();
+  for (unsigned i = 0; i < segments * Dash64::kSegCapacity / 4; ++i) {
+    dt_.Insert(i, i);
+  }
+  EXPECT_EQ(segments, dt_.unique_segments());
 }
 
 TEST_F(DashTest, Insert) {
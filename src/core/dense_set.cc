@@ -6,6 +6,7 @@
 
 #include <absl/numeric/bits.h>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <stack>
@@ -73,7 +74,7 @@ void DenseSet::IteratorBase::Advance() {
   DCHECK(!curr_entry_->IsEmpty());
 }
 
-DenseSet::DenseSet(MemoryResource* mr) : entries_(mr) {
+DenseSet::DenseSet(MemoryResource* mr) : entries_(mr), expiry_heap_(mr) {
 }
 
 DenseSet::~DenseSet() {
@@ -183,6 +184,7 @@ void DenseSet::ClearInternal() {
   }
 
   entries_.clear();
+  expiry_heap_.clear();
   num_used_buckets_ = 0;
   num_links_ = 0;
   size_ = 0;
@@ -335,6 +337,10 @@ void DenseSet::Grow(size_t prev_size) {
       }
     }
   }
+
+  // Home buckets of all entries changed
+  if (!expiry_heap_.empty())
+    RebuildExpiryIndex();
 }
 
 auto DenseSet::AddOrFindDense(void* ptr, bool has_ttl) -> DensePtr* {
@@ -348,6 +354,8 @@ auto DenseSet::AddOrFindDense(void* ptr, bool has_ttl) -> DensePtr* {
     obj_malloc_used_ += PushFront(e, ptr, has_ttl);
     ++size_;
     ++num_used_buckets_;
+    if (has_ttl)
+      IndexExpiry(ptr, bucket_id);
 
     return nullptr;
   }
@@ -385,6 +393,8 @@ void DenseSet::AddUnique(void* obj, bool has_ttl, uint64_t hashcode) {
       }
       ++num_used_buckets_;
       ++size_;
+      if (has_ttl)
+        IndexExpiry(obj, bucket_id);
       return;
     }
 
@@ -433,6 +443,8 @@ void DenseSet::AddUnique(void* obj, bool has_ttl, uint64_t hashcode) {
   DCHECK(!entries_[bucket_id].IsDisplaced());
 
   ++size_;
+  if (has_ttl)
+    IndexExpiry(obj, BucketId(hashcode));
 }
 
 auto DenseSet::Find2(const void* ptr, uint32_t bid, uint32_t cookie)
@@ -559,6 +571,8 @@ void* DenseSet::AddOrReplaceObj(void* obj, bool has_ttl) {
 
   ptr->SetObject(obj);
   ptr->SetTtl(has_ttl);
+  if (has_ttl)
+    IndexExpiry(obj, BucketId(obj, 0));
 
   return res;
 }
@@ -647,6 +661,61 @@ uint32_t DenseSet::Scan(uint32_t cursor, const ItemCb& cb) const {
   return entries_idx << (32 - capacity_log_);
 }
 
+void DenseSet::IndexExpiry(const void* obj, uint32_t bid) {
+  // Stale records pile up when ttls of the same entries are updated over and over
+  if (expiry_heap_.size() > 2 * size_ + 16) {
+    RebuildExpiryIndex();
+    return;
+  }
+
+  expiry_heap_.emplace_back(ObjExpireTime(obj), bid);
+  push_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<ExpiryRecord>{});
+}
+
+void DenseSet::RebuildExpiryIndex() {
+  expiry_heap_.clear();
+  for (uint32_t bid = 0; bid < entries_.size(); ++bid) {
+    for (DensePtr* curr = &entries_[bid]; curr && !curr->IsEmpty(); curr = curr->Next()) {
+      if (curr->HasTtl()) {
+        const void* obj = curr->GetObject();
+        expiry_heap_.emplace_back(ObjExpireTime(obj), BucketId(obj, 0));
+      }
+    }
+  }
+  make_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<ExpiryRecord>{});
+}
+
+void DenseSet::ExpireBucket(uint32_t bid) {
+  DensePtr* curr = &entries_[bid];
+  ExpireIfNeeded(nullptr, curr);
+
+  // Same as IteratorBase::Advance, deletion may turn the current link into a plain entry
+  while (curr->IsLink()) {
+    if (ExpireIfNeeded(curr, &curr->AsLink()->next) && !curr->IsLink())
+      break;
+    curr = &curr->AsLink()->next;
+  }
+
+  // Displaced entries are never chained
+  if (bid > 0)
+    ExpireIfNeeded(nullptr, &entries_[bid - 1]);
+  if (bid + 1 < entries_.size())
+    ExpireIfNeeded(nullptr, &entries_[bid + 1]);
+}
+
+unsigned DenseSet::ExpireDue(unsigned steps) {
+  unsigned visited = 0;
+  while (visited < steps && !expiry_heap_.empty() && expiry_heap_.front().first <= time_now_) {
+    uint32_t bid = expiry_heap_.front().second;
+    pop_heap(expiry_heap_.begin(), expiry_heap_.end(), greater<ExpiryRecord>{});
+    expiry_heap_.pop_back();
+
+    ExpireBucket(bid);
+    ++visited;
+  }
+  return visited;
+}
+
 auto DenseSet::NewLink(void* data, DensePtr next) -> DenseLinkKey* {
   LinkAllocator la(mr());
   DenseLinkKey* lk = la.allocate(1);
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <functional>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "base/pmr/memory_resource.h"
@@ -236,7 +237,8 @@ class DenseSet {
   }
 
   size_t SetMallocUsed() const {
-    return entries_.capacity() * sizeof(DensePtr) + num_links_ * sizeof(DenseLinkKey);
+    return entries_.capacity() * sizeof(DensePtr) + num_links_ * sizeof(DenseLinkKey) +
+           expiry_heap_.capacity() * sizeof(ExpiryRecord);
   }
 
   using ItemCb = std::function<void(const void*)>;
@@ -244,6 +246,16 @@ class DenseSet {
   uint32_t Scan(uint32_t cursor, const ItemCb& cb) const;
   void Reserve(size_t sz);
 
+  // Returns the earliest expiry time of the entries with ttl or UINT32_MAX if there are none.
+  // It is a lower bound: the entry might have been deleted or its ttl updated since.
+  uint32_t NextExpiry() const {
+    return expiry_heap_.empty() ? UINT32_MAX : expiry_heap_.front().first;
+  }
+
+  // Deletes expired entries by visiting the buckets of entries due by time_now(), in order of
+  // expiry and up to `steps` of them. Returns the number of visited buckets.
+  unsigned ExpireDue(unsigned steps);
+
   // set an abstract time that allows expiry.
   void set_time(uint32_t val) {
     time_now_ = val;
@@ -385,12 +397,27 @@ class DenseSet {
 
   bool ExpireIfNeededInternal(DensePtr* prev, DensePtr* node) const;
 
+  // Records the expiry time of obj, that was added with ttl to its home bucket bid.
+  void IndexExpiry(const void* obj, uint32_t bid);
+
+  // Rebuilds expiry_heap_ from all entries with ttl.
+  void RebuildExpiryIndex();
+
+  // Expires the entries of the home bucket bid, including those displaced to its neighbours.
+  void ExpireBucket(uint32_t bid);
+
   // Deletes the object pointed by ptr and removes it from the set.
   // If ptr is a link then it will be deleted internally.
   void Delete(DensePtr* prev, DensePtr* ptr);
 
   std::vector<DensePtr, DensePtrAllocator> entries_;
 
+  // Min-heap of (expiry time, home bucket) of the entries added with ttl, so that expired entries
+  // are found without scanning the table. Stale records of deleted or updated entries are
+  // dropped when they become due or when the heap is rebuilt.
+  using ExpiryRecord = std::pair<uint32_t, uint32_t>;
+  std::vector<ExpiryRecord, PMR_NS::polymorphic_allocator<ExpiryRecord>> expiry_heap_;
+
   mutable size_t obj_malloc_used_ = 0;
   mutable uint32_t size_ = 0;              // number of elements in the set.
   mutable uint32_t num_links_ = 0;         // number of links in the set.
@@ -0,0 +1,220 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/huff_coder.h"
+
+#include <absl/strings/str_cat.h>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <queue>
+
+#include "base/logging.h"
+
+namespace dfly {
+using namespace std;
+
+namespace {
+
+constexpr unsigned kNumSymbols = 256;
+
+// Computes optimal (not length limited) code lengths. Returns the maximal length.
+unsigned ComputeLengths(const uint64_t freq[kNumSymbols], uint8_t lens[kNumSymbols]) {
+  struct Node {
+    uint64_t freq;
+    int left;   // -1 for leaves.
+    int right;  // symbol for leaves.
+  };
+
+  vector<Node> nodes;
+  nodes.reserve(kNumSymbols * 2);
+
+  using Item = pair<uint64_t, int>;
+  priority_queue<Item, vector<Item>, greater<Item>> pq;
+  for (unsigned i = 0; i < kNumSymbols; ++i) {
+    nodes.push_back(Node{freq[i], -1, int(i)});
+    pq.emplace(freq[i], i);
+  }
+
+  while (pq.size() > 1) {
+    auto [f1, n1] = pq.top();
+    pq.pop();
+    auto [f2, n2] = pq.top();
+    pq.pop();
+    nodes.push_back(Node{f1 + f2, n1, n2});
+    pq.emplace(f1 + f2, int(nodes.size() - 1));
+  }
+
+  unsigned max_len = 0;
+  vector<pair<int, unsigned>> stack{{pq.top().second, 0}};
+  while (!stack.empty()) {
+    auto [index, depth] = stack.back();
+    stack.pop_back();
+    const Node& node = nodes[index];
+    if (node.left < 0) {
+      lens[node.right] = depth;
+      max_len = max(max_len, depth);
+    } else {
+      stack.emplace_back(node.left, depth + 1);
+      stack.emplace_back(node.right, depth + 1);
+    }
+  }
+  return max_len;
+}
+
+}  // namespace
+
+bool HuffmanEncoder::Build(const unsigned hist[256], unsigned max_bits, string* error_msg) {
+  if (max_bits < 8 || max_bits > kMaxCodeBits) {
+    *error_msg = absl::StrCat("max_bits must be in range [8, ", kMaxCodeBits, "]");
+    return false;
+  }
+
+  // Every symbol gets a non-zero frequency so that strings outside of the sample
+  // remain encodable.
+  uint64_t freq[kNumSymbols];
+  for (unsigned i = 0; i < kNumSymbols; ++i)
+    freq[i] = uint64_t(hist[i]) + 1;
+
+  // Flatten the distribution until the code fits into max_bits. Converges to a uniform
+  // distribution, i.e. 8 bit codes, in the worst case.
+  uint8_t lens[kNumSymbols];
+  while (ComputeLengths(freq, lens) > max_bits) {
+    for (unsigned i = 0; i < kNumSymbols; ++i)
+      freq[i] = (freq[i] + 1) / 2;
+  }
+
+  return InitFromLengths(lens, error_msg);
+}
+
+bool HuffmanEncoder::Load(string_view binary_data, string* error_msg) {
+  if (binary_data.size() != kNumSymbols) {
+    *error_msg = "invalid huffman table size";
+    return false;
+  }
+  return InitFromLengths(reinterpret_cast<const uint8_t*>(binary_data.data()), error_msg);
+}
+
+string HuffmanEncoder::Export() const {
+  DCHECK(valid());
+  return string(reinterpret_cast<const char*>(nbits_), kNumSymbols);
+}
+
+bool HuffmanEncoder::InitFromLengths(const uint8_t lens[256], string* error_msg) {
+  // Kraft sum of a complete prefix code is exactly 1.
+  uint32_t kraft = 0;
+  unsigned max_len = 0;
+  for (unsigned i = 0; i < kNumSymbols; ++i) {
+    if (lens[i] == 0 || lens[i] > kMaxCodeBits) {
+      *error_msg = absl::StrCat("invalid code length for symbol ", i);
+      return false;
+    }
+    kraft += 1u << (kMaxCodeBits - lens[i]);
+    max_len = max<unsigned>(max_len, lens[i]);
+  }
+
+  if (kraft != (1u << kMaxCodeBits)) {
+    *error_msg = "huffman table is not a complete prefix code";
+    return false;
+  }
+
+  // Canonical code: symbols are ordered by (code length, symbol value).
+  array<uint16_t, kNumSymbols> order;
+  iota(order.begin(), order.end(), 0);
+  stable_sort(order.begin(), order.end(),
+              [&](uint16_t a, uint16_t b) { return lens[a] < lens[b]; });
+
+  unsigned code = 0;
+  unsigned prev_len = lens[order[0]];
+  for (uint16_t sym : order) {
+    code <<= (lens[sym] - prev_len);
+    prev_len = lens[sym];
+    codes_[sym] = code;
+    nbits_[sym] = lens[sym];
+    ++code;
+  }
+
+  max_bits_ = max_len;
+  return true;
+}
+
+size_t HuffmanEncoder::EncodedBits(string_view src) const {
+  DCHECK(valid());
+  size_t res = 0;
+  for (uint8_t c : src)
+    res += nbits_[c];
+  return res;
+}
+
+size_t HuffmanEncoder::Encode(string_view src, uint8_t* dest) const {
+  DCHECK(valid());
+
+  // Only the lowest bitcnt bits of bitbuf are pending, the rest is shifted out.
+  uint64_t bitbuf = 0;
+  unsigned bitcnt = 0;
+  size_t pos = 0;
+  for (uint8_t c : src) {
+    bitbuf = (bitbuf << nbits_[c]) | codes_[c];
+    bitcnt += nbits_[c];
+    while (bitcnt >= 8) {
+      bitcnt -= 8;
+      dest[pos++] = uint8_t(bitbuf >> bitcnt);
+    }
+  }
+
+  if (bitcnt > 0)
+    dest[pos++] = uint8_t(bitbuf << (8 - bitcnt));
+
+  return pos;
+}
+
+bool HuffmanDecoder::Load(string_view binary_data, string* error_msg) {
+  HuffmanEncoder enc;
+  if (!enc.Load(binary_data, error_msg))
+    return false;
+
+  max_bits_ = enc.max_bits_;
+  table_.assign(1u << max_bits_, Entry{0, 0});
+
+  for (unsigned sym = 0; sym < kNumSymbols; ++sym) {
+    unsigned len = enc.nbits_[sym];
+    unsigned shift = max_bits_ - len;
+    unsigned start = unsigned(enc.codes_[sym]) << shift;
+    for (unsigned j = 0; j < (1u << shift); ++j)
+      table_[start + j] = Entry{uint8_t(sym), uint8_t(len)};
+  }
+
+  return true;
+}
+
+bool HuffmanDecoder::Decode(const uint8_t* src, size_t src_len, size_t decoded_len,
+                            char* dest) const {
+  DCHECK(valid());
+
+  // bitbuf holds bitcnt pending bits aligned to its most significant bit.
+  uint64_t bitbuf = 0;
+  unsigned bitcnt = 0;
+  size_t pos = 0;
+  size_t consumed_bits = 0;
+
+  for (size_t i = 0; i < decoded_len; ++i) {
+    while (bitcnt <= 56) {
+      uint64_t b = pos < src_len ? src[pos] : 0;
+      ++pos;
+      bitbuf |= b << (56 - bitcnt);
+      bitcnt += 8;
+    }
+
+    const Entry& e = table_[bitbuf >> (64 - max_bits_)];
+    dest[i] = e.symbol;
+    bitbuf <<= e.nbits;
+    bitcnt -= e.nbits;
+    consumed_bits += e.nbits;
+  }
+
+  return consumed_bits <= src_len * 8;
+}
+
+}  // namespace dfly
@@ -0,0 +1,89 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dfly {
+
+// Static, canonical Huffman code over bytes. Every byte value gets a code, so any string
+// can be encoded with a table that was trained on a sample. Codes are written MSB first and
+// the output is zero padded to a whole byte, which makes the encoding deterministic:
+// two strings are equal iff their encodings are equal.
+//
+// The table is serialized as 256 code lengths, so it can be persisted in snapshots.
+class HuffmanEncoder {
+ public:
+  static constexpr unsigned kMaxCodeBits = 12;
+
+  // Builds a code from the histogram of byte frequencies. Code lengths are limited by max_bits.
+  bool Build(const unsigned hist[256], unsigned max_bits, std::string* error_msg);
+
+  // Loads the table produced by Export().
+  bool Load(std::string_view binary_data, std::string* error_msg);
+
+  std::string Export() const;
+
+  // Returns the number of bits required to encode src.
+  size_t EncodedBits(std::string_view src) const;
+
+  // Encodes src into dest. dest must have at least (EncodedBits(src) + 7) / 8 bytes.
+  // Returns the number of bytes written.
+  size_t Encode(std::string_view src, uint8_t* dest) const;
+
+  bool valid() const {
+    return max_bits_ > 0;
+  }
+
+  unsigned max_bits() const {
+    return max_bits_;
+  }
+
+  void Reset() {
+    max_bits_ = 0;
+  }
+
+ private:
+  friend class HuffmanDecoder;
+
+  bool InitFromLengths(const uint8_t lens[256], std::string* error_msg);
+
+  uint16_t codes_[256];
+  uint8_t nbits_[256];
+  unsigned max_bits_ = 0;
+};
+
+class HuffmanDecoder {
+ public:
+  bool Load(std::string_view binary_data, std::string* error_msg);
+
+  // Decodes exactly decoded_len symbols from src into dest.
+  // Returns false if src is malformed or too short.
+  bool Decode(const uint8_t* src, size_t src_len, size_t decoded_len, char* dest) const;
+
+  bool valid() const {
+    return max_bits_ > 0;
+  }
+
+  void Reset() {
+    max_bits_ = 0;
+    table_.clear();
+  }
+
+ private:
+  struct Entry {
+    uint8_t symbol;
+    uint8_t nbits;  // 0 for an unused slot.
+  };
+
+  // Direct lookup table indexed by the next max_bits_ bits of the stream.
+  std::vector<Entry> table_;
+  unsigned max_bits_ = 0;
+};
+
+}  // namespace dfly
@@ -0,0 +1,163 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+#include "core/huge_page_resource.h"
+
+#include <linux/mempolicy.h>
+#include <linux/mman.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "base/logging.h"
+
+namespace dfly {
+
+using namespace std;
+
+namespace {
+
+// mimalloc arenas must start at and span multiples of its segment size.
+constexpr size_t kArenaAlign = 1ULL << 26;
+
+size_t AlignUp(size_t val, size_t align) {
+  return (val + align - 1) & ~(align - 1);
+}
+
+// Maps size bytes of huge pages at an address aligned to align. Returns nullptr on failure.
+void* MapHugePages(size_t size, size_t page_size, size_t align) {
+  // Reserve an address range large enough to contain an aligned region, replace the aligned
+  // part with the huge page mapping and release the rest.
+  size_t reserve_size = size + align;
+  void* reserve = mmap(nullptr, reserve_size, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reserve == MAP_FAILED) {
+    LOG(WARNING) << "Could not reserve " << reserve_size << " bytes: " << strerror(errno);
+    return nullptr;
+  }
+
+  char* start = reinterpret_cast<char*>(AlignUp(reinterpret_cast<uintptr_t>(reserve), align));
+  int page_flag = page_size == (1ULL << 30) ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+  void* ptr = mmap(start, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB | page_flag, -1, 0);
+
+  char* reserve_end = static_cast<char*>(reserve) + reserve_size;
+  if (ptr == MAP_FAILED) {
+    LOG(WARNING) << "Could not map " << size << " bytes of huge pages: " << strerror(errno)
+                 << ", check /proc/sys/vm/nr_hugepages";
+    munmap(reserve, reserve_size);
+    return nullptr;
+  }
+
+  if (start > reserve)
+    munmap(reserve, start - static_cast<char*>(reserve));
+  if (start + size < reserve_end)
+    munmap(start + size, reserve_end - (start + size));
+  return ptr;
+}
+
+// Prefers the NUMA node of the calling thread for the pages of the region and faults them in.
+// The preferred policy falls back to other nodes instead of failing when the node runs out of
+// huge pages.
+int PlaceOnLocalNode(void* ptr, size_t size) {
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+    return -1;
+
+  unsigned long nodemask = node < 64 ? 1UL << node : 0;
+  if (nodemask &&
+      syscall(SYS_mbind, ptr, size, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8, 0) != 0) {
+    LOG(WARNING) << "Could not bind huge pages to node " << node << ": " << strerror(errno);
+  }
+
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(ptr, size, MADV_POPULATE_WRITE) != 0)
+    VLOG(1) << "Could not populate huge pages: " << strerror(errno);
+#endif
+  return node;
+}
+
+}  // namespace
+
+HugePageMemoryResource::Stats& HugePageMemoryResource::Stats::operator+=(const Stats& o) {
+  reserved += o.reserved;
+  used += o.used;
+  fallback += o.fallback;
+  return *this;
+}
+
+HugePageMemoryResource::HugePageMemoryResource(MiMemoryResource* fallback, size_t region_size,
+                                               size_t page_size)
+    : fallback_(fallback) {
+  if (region_size == 0)
+    return;
+
+  CHECK(page_size == (1ULL << 21) || page_size == (1ULL << 30)) << page_size;
+  size_t align = max(page_size, kArenaAlign);
+  region_size = AlignUp(region_size, align);
+
+  region_ = MapHugePages(region_size, page_size, align);
+  if (!region_)
+    return;
+
+  int node = PlaceOnLocalNode(region_, region_size);
+
+  mi_arena_id_t arena_id;
+  if (!mi_manage_os_memory_ex(region_, region_size, true /* committed */, true /* large */,
+                              true /* zero */, node, true /* exclusive */, &arena_id)) {
+    LOG(WARNING) << "Could not register huge page region with the allocator";
+    munmap(region_, region_size);
+    region_ = nullptr;
+    return;
+  }
+
+  heap_ = mi_heap_new_in_arena(arena_id);
+  if (!heap_) {
+    LOG(WARNING) << "Could not create a heap in the huge page region";
+    return;
+  }
+
+  stats_.reserved = region_size;
+  VLOG(1) << "Mapped " << region_size << " bytes of huge pages on node " << node;
+}
+
+HugePageMemoryResource::~HugePageMemoryResource() {
+  DCHECK_EQ(stats_.used, 0u);
+
+  // mimalloc arenas can not be unregistered, so the region stays mapped until the process exits.
+  if (heap_)
+    mi_heap_delete(heap_);
+}
+
+void* HugePageMemoryResource::do_allocate(size_t size, size_t align) {
+  if (heap_) {
+    void* res = mi_heap_malloc_aligned(heap_, size, align);
+    if (res) {
+      DCHECK(InRegion(res));
+      stats_.used += mi_usable_size(res);
+      return res;
+    }
+  }
+
+  void* res = fallback_->allocate(size, align);
+  stats_.fallback += mi_usable_size(res);
+  return res;
+}
+
+void HugePageMemoryResource::do_deallocate(void* ptr, size_t size, size_t align) {
+  size_t usable = mi_usable_size(ptr);
+  if (InRegion(ptr)) {
+    DCHECK_GE(stats_.used, usable);
+    stats_.used -= usable;
+    mi_free_size_aligned(ptr, size, align);
+    return;
+  }
+
+  DCHECK_GE(stats_.fallback, usable);
+  stats_.fallback -= usable;
+  fallback_->deallocate(ptr, size, align);
+}
+
+}  // namespace dfly
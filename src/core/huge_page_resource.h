@@ -0,0 +1,65 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <mimalloc.h>
+
+#include "base/pmr/memory_resource.h"
+#include "core/mi_memory_resource.h"
+
+namespace dfly {
+
+// Per thread memory resource that serves allocations from a region of huge pages, placed on
+// the NUMA node of the creating thread. Allocations that do not fit into the region are
+// served by the fallback resource. Used for hash table segments, whose random access pattern
+// misses the TLB constantly when they are spread over regular 4KB pages.
+class HugePageMemoryResource : public PMR_NS::memory_resource {
+ public:
+  struct Stats {
+    size_t reserved = 0;  // size of the huge page region
+    size_t used = 0;      // bytes allocated from the region
+    size_t fallback = 0;  // bytes allocated from the fallback resource
+
+    Stats& operator+=(const Stats& o);
+  };
+
+  // Maps region_size bytes of huge pages of page_size (2MB or 1GB). If region_size is 0 or the
+  // region can not be mapped, all allocations are served by fallback.
+  HugePageMemoryResource(MiMemoryResource* fallback, size_t region_size, size_t page_size);
+  ~HugePageMemoryResource();
+
+  bool HasRegion() const {
+    return heap_ != nullptr;
+  }
+
+  // Bytes allocated from the huge page region.
+  size_t used() const {
+    return stats_.used;
+  }
+
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  void* do_allocate(std::size_t size, std::size_t align) final;
+
+  void do_deallocate(void* ptr, std::size_t size, std::size_t align) final;
+
+  bool do_is_equal(const PMR_NS::memory_resource& o) const noexcept {
+    return this == &o;
+  }
+
+  bool InRegion(const void* ptr) const {
+    return ptr >= region_ && ptr < static_cast<const char*>(region_) + stats_.reserved;
+  }
+
+  MiMemoryResource* fallback_;
+  mi_heap_t* heap_ = nullptr;
+  void* region_ = nullptr;
+  Stats stats_;
+};
+
+}  // namespace dfly
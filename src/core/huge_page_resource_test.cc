@@ -0,0 +1,52 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/huge_page_resource.h"
+
+#include "base/gtest.h"
+#include "base/logging.h"
+
+namespace dfly {
+
+using namespace std;
+
+class HugePageResourceTest : public ::testing::Test {
+ protected:
+  HugePageResourceTest() : fallback_(mi_heap_get_backing()) {
+  }
+
+  // Checks that allocations are served and accounted by the fallback resource.
+  void CheckFallback(HugePageMemoryResource* mr) {
+    EXPECT_FALSE(mr->HasRegion());
+    EXPECT_EQ(0u, mr->stats().reserved);
+
+    void* ptr = mr->allocate(4096, 8);
+    ASSERT_NE(nullptr, ptr);
+    memset(ptr, 0, 4096);
+
+    EXPECT_EQ(0u, mr->used());
+    EXPECT_GE(mr->stats().fallback, 4096u);
+    EXPECT_EQ(mr->stats().fallback, fallback_.used());
+
+    mr->deallocate(ptr, 4096, 8);
+    EXPECT_EQ(0u, mr->stats().fallback);
+    EXPECT_EQ(0u, fallback_.used());
+  }
+
+  MiMemoryResource fallback_;
+};
+
+TEST_F(HugePageResourceTest, Disabled) {
+  HugePageMemoryResource mr(&fallback_, 0, 1ULL << 21);
+  CheckFallback(&mr);
+}
+
+TEST_F(HugePageResourceTest, HugePagesUnavailable) {
+  // No host reserves a terabyte of huge pages, so the mapping fails and the resource falls back
+  // to the regular heap.
+  HugePageMemoryResource mr(&fallback_, 1ULL << 40, 1ULL << 30);
+  CheckFallback(&mr);
+}
+
+}  // namespace dfly
@@ -0,0 +1,130 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/intset_ops.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "base/logging.h"
+
+namespace dfly::intset_ops {
+
+using namespace std;
+
+namespace {
+
+template <typename T> void DecodeArr(const int8_t* contents, uint32_t len, int64_t* dest) {
+  const T* src = reinterpret_cast<const T*>(contents);
+  for (uint32_t i = 0; i < len; ++i)
+    dest[i] = src[i];
+}
+
+// When one side is much smaller, probing with binary search beats the linear merge.
+constexpr size_t kGallopRatio = 32;
+
+}  // namespace
+
+void Decode(const intset* is, IntVec* dest) {
+  uint32_t len = intsetLen(is);
+  dest->resize(len);
+
+  // intset stores its elements in little endian with the width defined by the encoding.
+  switch (is->encoding) {
+    case sizeof(int16_t):
+      DecodeArr<int16_t>(is->contents, len, dest->data());
+      break;
+    case sizeof(int32_t):
+      DecodeArr<int32_t>(is->contents, len, dest->data());
+      break;
+    case sizeof(int64_t):
+      DecodeArr<int64_t>(is->contents, len, dest->data());
+      break;
+    default:
+      LOG(DFATAL) << "Unknown intset encoding " << is->encoding;
+      dest->clear();
+  }
+}
+
+void Intersect(IntSpan a, IntSpan b, IntVec* dest) {
+  if (a.size() > b.size())
+    swap(a, b);
+
+  dest->resize(a.size());
+  int64_t* out = dest->data();
+  size_t k = 0;
+
+  if (a.size() * kGallopRatio < b.size()) {
+    const int64_t* next = b.begin();
+    for (int64_t val : a) {
+      next = lower_bound(next, b.end(), val);
+      if (next == b.end())
+        break;
+      out[k] = val;
+      k += (*next == val);
+    }
+  } else {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+      int64_t x = a[i], y = b[j];
+      out[k] = x;
+      k += (x == y);
+      i += (x <= y);
+      j += (y <= x);
+    }
+  }
+
+  dest->resize(k);
+}
+
+void Union(IntSpan a, IntSpan b, IntVec* dest) {
+  dest->resize(a.size() + b.size());
+  int64_t* out = dest->data();
+  size_t i = 0, j = 0, k = 0;
+
+  while (i < a.size() && j < b.size()) {
+    int64_t x = a[i], y = b[j];
+    out[k++] = x < y ? x : y;
+    i += (x <= y);
+    j += (y <= x);
+  }
+
+  out = copy(a.begin() + i, a.end(), out + k);
+  out = copy(b.begin() + j, b.end(), out);
+  dest->resize(out - dest->data());
+}
+
+void Diff(IntSpan a, IntSpan b, IntVec* dest) {
+  dest->resize(a.size());
+  int64_t* out = dest->data();
+  size_t i = 0, j = 0, k = 0;
+
+  while (i < a.size() && j < b.size()) {
+    int64_t x = a[i], y = b[j];
+    out[k] = x;
+    k += (x < y);
+    i += (x <= y);
+    j += (y <= x);
+  }
+
+  out = copy(a.begin() + i, a.end(), out + k);
+  dest->resize(out - dest->data());
+}
+
+void Contains(IntSpan sorted, IntSpan probes, uint8_t* found) {
+  // Sort the probes by value so that we need a single pass over the set.
+  vector<uint32_t> order(probes.size());
+  iota(order.begin(), order.end(), 0);
+  sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) { return probes[l] < probes[r]; });
+
+  size_t j = 0;
+  for (uint32_t index : order) {
+    int64_t val = probes[index];
+    while (j < sorted.size() && sorted[j] < val)
+      ++j;
+    found[index] = j < sorted.size() && sorted[j] == val;
+  }
+}
+
+}  // namespace dfly::intset_ops
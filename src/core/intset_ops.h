@@ -0,0 +1,39 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <absl/types/span.h>
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include "redis/intset.h"
+}
+
+namespace dfly {
+
+// Set algebra kernels for integer sets. Intsets keep their elements sorted and unique, so all
+// operations are linear merges done in integer form. The merges are branchless, which lets
+// the compiler vectorize them and avoids branch mispredictions on random data.
+namespace intset_ops {
+
+using IntVec = std::vector<int64_t>;
+using IntSpan = absl::Span<const int64_t>;
+
+// Decodes the elements of the intset into dest in ascending order.
+void Decode(const intset* is, IntVec* dest);
+
+// Inputs must be sorted and unique. dest must not alias the inputs.
+void Intersect(IntSpan a, IntSpan b, IntVec* dest);
+void Union(IntSpan a, IntSpan b, IntVec* dest);
+void Diff(IntSpan a, IntSpan b, IntVec* dest);  // a \ b
+
+// Sets found[i] to 1 if probes[i] is in the sorted set, 0 otherwise.
+// Probes do not need to be sorted or unique.
+void Contains(IntSpan sorted, IntSpan probes, uint8_t* found);
+
+}  // namespace intset_ops
+}  // namespace dfly
@@ -0,0 +1,82 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/intset_ops.h"
+
+#include <gmock/gmock.h>
+#include <mimalloc.h>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+
+extern "C" {
+#include "redis/zmalloc.h"
+}
+
+namespace dfly {
+
+using namespace std;
+using namespace intset_ops;
+
+class IntsetOpsTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    init_zmalloc_threadlocal(mi_heap_get_backing());
+  }
+};
+
+TEST_F(IntsetOpsTest, Decode) {
+  intset* is = intsetNew();
+  uint8_t success;
+  for (int64_t val : {5, -3, 100}) {
+    is = intsetAdd(is, val, &success);
+  }
+
+  IntVec vec;
+  Decode(is, &vec);
+  EXPECT_EQ(vec, (IntVec{-3, 5, 100}));
+
+  // Upgrades the encoding to 64 bit.
+  is = intsetAdd(is, INT64_MAX, &success);
+  Decode(is, &vec);
+  EXPECT_EQ(vec, (IntVec{-3, 5, 100, INT64_MAX}));
+  zfree(is);
+}
+
+TEST_F(IntsetOpsTest, Algebra) {
+  IntVec a{1, 3, 5, 7, 9}, b{2, 3, 4, 5, 100}, dest;
+
+  Intersect(a, b, &dest);
+  EXPECT_EQ(dest, (IntVec{3, 5}));
+
+  Union(a, b, &dest);
+  EXPECT_EQ(dest, (IntVec{1, 2, 3, 4, 5, 7, 9, 100}));
+
+  Diff(a, b, &dest);
+  EXPECT_EQ(dest, (IntVec{1, 7, 9}));
+
+  Diff(b, a, &dest);
+  EXPECT_EQ(dest, (IntVec{2, 4, 100}));
+
+  Intersect(a, {}, &dest);
+  EXPECT_TRUE(dest.empty());
+
+  // Exercises the galloping path.
+  IntVec big;
+  for (int64_t i = 0; i < 1000; i += 2)
+    big.push_back(i);
+  Intersect(IntVec{-1, 4, 5, 998, 1000}, big, &dest);
+  EXPECT_EQ(dest, (IntVec{4, 998}));
+}
+
+TEST_F(IntsetOpsTest, Contains) {
+  IntVec set{2, 3, 4, 5, 100};
+  IntVec probes{5, 3, 3, 101, -2};
+  uint8_t found[5];
+
+  Contains(set, probes, found);
+  EXPECT_THAT(found, ::testing::ElementsAre(1, 1, 1, 0, 0));
+}
+
+}  // namespace dfly
@@ -0,0 +1,238 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/ring_list.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include "redis/zmalloc.h"
+}
+
+#include "base/logging.h"
+
+namespace dfly {
+using namespace std;
+
+RingList::~RingList() {
+  zfree(offsets_);
+  zfree(data_);
+}
+
+void RingList::PushFront(string_view str) {
+  Insert(0, str);
+}
+
+void RingList::PushBack(string_view str) {
+  Insert(size_, str);
+}
+
+string RingList::PopFront() {
+  DCHECK_GT(size_, 0u);
+  string res{At(0)};
+  EraseFront(1);
+  return res;
+}
+
+string RingList::PopBack() {
+  DCHECK_GT(size_, 0u);
+  string res{At(size_ - 1)};
+  EraseBack(1);
+  return res;
+}
+
+void RingList::Set(size_t index, string_view str) {
+  DCHECK_LT(index, size_);
+  size_t cur_len = At(index).size();
+
+  // Resize the element by opening or closing a gap right after it.
+  if (str.size() > cur_len)
+    OpenGap(index + 1, str.size() - cur_len);
+  else if (str.size() < cur_len)
+    CloseGap(index + 1, cur_len - str.size());
+
+  if (!str.empty())
+    memcpy(data_ + Offset(index), str.data(), str.size());
+}
+
+void RingList::Insert(size_t index, string_view str) {
+  DCHECK_LE(index, size_);
+  if (size_ == capacity_)
+    Reserve(capacity_ ? capacity_ * 2 : kMinCapacity);
+
+  uint32_t offset = OpenGap(index, str.size());
+  if (!str.empty())
+    memcpy(data_ + offset, str.data(), str.size());
+  InsertSlot(index, offset);
+}
+
+void RingList::Erase(size_t index) {
+  DCHECK_LT(index, size_);
+  CloseGap(index + 1, At(index).size());
+  EraseSlot(index);
+  ShrinkIfNeeded();
+}
+
+void RingList::EraseFront(size_t count) {
+  DCHECK_LE(count, size_);
+  begin_ = Offset(count);
+  head_ = Pos(count);
+  size_ -= count;
+  ShrinkIfNeeded();
+}
+
+void RingList::EraseBack(size_t count) {
+  DCHECK_LE(count, size_);
+  end_ = Offset(size_ - count);
+  size_ -= count;
+  ShrinkIfNeeded();
+}
+
+size_t RingList::MallocUsed() const {
+  size_t res = offsets_ ? zmalloc_size(offsets_) : 0;
+  if (data_)
+    res += zmalloc_size(data_);
+  return res;
+}
+
+uint32_t RingList::OpenGap(size_t index, size_t len) {
+  if (len == 0)
+    return Offset(index);
+
+  if (2 * index < size_) {
+    // Move the bytes of the preceding elements to the left.
+    ReserveData(len, 0);
+    uint32_t pos = Offset(index);
+    memmove(data_ + begin_ - len, data_ + begin_, pos - begin_);
+    begin_ -= len;
+    for (size_t i = 0; i < index; ++i)
+      offsets_[Pos(i)] -= len;
+    return pos - len;
+  }
+
+  // Move the bytes of the element at index and the following ones to the right.
+  ReserveData(0, len);
+  uint32_t pos = Offset(index);
+  memmove(data_ + pos + len, data_ + pos, end_ - pos);
+  end_ += len;
+  for (size_t i = index; i < size_; ++i)
+    offsets_[Pos(i)] += len;
+  return pos;
+}
+
+void RingList::CloseGap(size_t index, size_t len) {
+  uint32_t pos = Offset(index);
+  DCHECK_GE(pos, begin_ + len);
+
+  if (2 * index < size_) {
+    // Move the bytes before the gap to the right.
+    memmove(data_ + begin_ + len, data_ + begin_, pos - len - begin_);
+    begin_ += len;
+    for (size_t i = 0; i < index; ++i)
+      offsets_[Pos(i)] += len;
+  } else {
+    // Move the bytes from index to the left.
+    memmove(data_ + pos - len, data_ + pos, end_ - pos);
+    end_ -= len;
+    for (size_t i = index; i < size_; ++i)
+      offsets_[Pos(i)] -= len;
+  }
+}
+
+void RingList::InsertSlot(size_t index, uint32_t offset) {
+  DCHECK_LT(size_, capacity_);
+
+  if (2 * index < size_) {
+    // Shift the slots before index one position to the left.
+    head_ = (head_ + capacity_ - 1) & (capacity_ - 1);
+    for (size_t i = 0; i < index; ++i)
+      offsets_[Pos(i)] = offsets_[Pos(i + 1)];
+  } else {
+    // Shift the slots from index one position to the right.
+    for (size_t i = size_; i > index; --i)
+      offsets_[Pos(i)] = offsets_[Pos(i - 1)];
+  }
+
+  offsets_[Pos(index)] = offset;
+  ++size_;
+}
+
+void RingList::EraseSlot(size_t index) {
+  if (2 * index < size_) {
+    for (size_t i = index; i > 0; --i)
+      offsets_[Pos(i)] = offsets_[Pos(i - 1)];
+    head_ = Pos(1);
+  } else {
+    for (size_t i = index; i + 1 < size_; ++i)
+      offsets_[Pos(i)] = offsets_[Pos(i + 1)];
+  }
+  --size_;
+}
+
+void RingList::Reserve(uint32_t new_cap) {
+  DCHECK_GE(new_cap, size_);
+  DCHECK_EQ(new_cap & (new_cap - 1), 0u);
+
+  // Unwrap the ring so that the new buffer starts at head.
+  uint32_t* new_offsets = (uint32_t*)zmalloc(new_cap * sizeof(uint32_t));
+  for (size_t i = 0; i < size_; ++i)
+    new_offsets[i] = offsets_[Pos(i)];
+
+  zfree(offsets_);
+  offsets_ = new_offsets;
+  capacity_ = new_cap;
+  head_ = 0;
+}
+
+void RingList::ReserveData(size_t front, size_t back) {
+  if (begin_ >= front && data_cap_ - end_ >= back)
+    return;
+
+  // Double the arena and split the remaining free room evenly between both sides, so that
+  // pushing at either end stays amortized O(1).
+  size_t used = end_ - begin_;
+  size_t new_cap = max<size_t>(2 * (used + front + back), kMinDataCapacity);
+  Relocate(new_cap, front + (new_cap - used - front - back) / 2);
+}
+
+void RingList::Relocate(size_t new_cap, size_t new_begin) {
+  size_t used = end_ - begin_;
+  DCHECK_LE(new_begin + used, new_cap);
+  CHECK_LE(new_cap, UINT32_MAX);
+
+  char* new_data = (char*)zmalloc(new_cap);
+  if (used)
+    memcpy(new_data + new_begin, data_ + begin_, used);
+
+  // Unsigned wrap-around makes this correct for shifts in both directions.
+  uint32_t delta = uint32_t(new_begin) - begin_;
+  for (size_t i = 0; i < size_; ++i)
+    offsets_[Pos(i)] += delta;
+
+  zfree(data_);
+  data_ = new_data;
+  data_cap_ = new_cap;
+  begin_ = new_begin;
+  end_ = new_begin + used;
+}
+
+void RingList::ShrinkIfNeeded() {
+  // Hysteresis: shrink to half when only a quarter is used, so that alternating push/pop
+  // around the boundary does not reallocate.
+  // Bulk erases may shrink by more than one step.
+  uint32_t new_cap = capacity_;
+  while (new_cap > kMinCapacity && size_ <= new_cap / 4)
+    new_cap /= 2;
+  if (new_cap != capacity_)
+    Reserve(new_cap);
+
+  size_t used = end_ - begin_;
+  if (data_cap_ > kMinDataCapacity && used <= data_cap_ / 4) {
+    size_t new_cap = max<size_t>(2 * used, kMinDataCapacity);
+    Relocate(new_cap, (new_cap - used) / 2);
+  }
+}
+
+}  // namespace dfly
@@ -0,0 +1,110 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace dfly {
+
+// Compact encoding for small lists. The element bytes are stored back to back, in list order,
+// inside a single arena with free room on both sides. A circular buffer of 32-bit offsets
+// into the arena makes elements directly addressable by index, so the per element overhead
+// is 4 bytes and there are no per element allocations.
+// Pushing and popping at both ends is amortized O(1). Inserting, erasing or resizing an element
+// in the middle moves the bytes and offsets of the shorter side.
+// All memory is allocated with zmalloc.
+class RingList {
+ public:
+  RingList() = default;
+  ~RingList();
+
+  RingList(const RingList&) = delete;
+  RingList& operator=(const RingList&) = delete;
+
+  size_t Size() const {
+    return size_;
+  }
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+  void PushFront(std::string_view str);
+  void PushBack(std::string_view str);
+
+  // The list must not be empty.
+  std::string PopFront();
+  std::string PopBack();
+
+  // index must be in range [0, Size()). The view is invalidated by any mutation.
+  std::string_view At(size_t index) const {
+    uint32_t start = Offset(index);
+    return {data_ + start, Offset(index + 1) - start};
+  }
+
+  void Set(size_t index, std::string_view str);
+
+  // Inserts str before the element at index. index == Size() appends.
+  void Insert(size_t index, std::string_view str);
+  void Erase(size_t index);
+
+  // Erases count elements from the front/back. count must not exceed Size().
+  void EraseFront(size_t count);
+  void EraseBack(size_t count);
+
+  size_t MallocUsed() const;
+
+ private:
+  static constexpr uint32_t kMinCapacity = 4;
+  static constexpr uint32_t kMinDataCapacity = 32;
+
+  // Physical position of the logical index. capacity_ is a power of 2.
+  uint32_t Pos(size_t index) const {
+    return (head_ + index) & (capacity_ - 1);
+  }
+
+  // Arena offset where the element at index starts. Offset(Size()) is the end of the data.
+  uint32_t Offset(size_t index) const {
+    return index < size_ ? offsets_[Pos(index)] : end_;
+  }
+
+  // Opens a gap of len bytes in the arena right before the element at index, shifting either
+  // the preceding or the following bytes, and returns the arena offset of the gap.
+  // The offsets are adjusted, but no slot is added for the gap.
+  uint32_t OpenGap(size_t index, size_t len);
+
+  // Closes the len bytes of the arena right before the element at index, the counterpart of
+  // OpenGap. Offset(index) may be the end of the data.
+  void CloseGap(size_t index, size_t len);
+
+  // Adds the offset of a new element at index, shifting the slots of the shorter side.
+  void InsertSlot(size_t index, uint32_t offset);
+  void EraseSlot(size_t index);
+
+  void Reserve(uint32_t new_cap);
+
+  // Makes sure there are at least front/back free bytes before/after the data.
+  void ReserveData(size_t front, size_t back);
+
+  // Moves the data into a new arena of new_cap bytes, starting at new_begin.
+  void Relocate(size_t new_cap, size_t new_begin);
+  void ShrinkIfNeeded();
+
+  uint32_t* offsets_ = nullptr;
+  uint32_t capacity_ = 0;
+  uint32_t head_ = 0;
+  uint32_t size_ = 0;
+
+  // The elements occupy [begin_, end_) of the arena.
+  char* data_ = nullptr;
+  uint32_t data_cap_ = 0;
+  uint32_t begin_ = 0;
+  uint32_t end_ = 0;
+};
+
+}  // namespace dfly
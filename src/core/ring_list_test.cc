@@ -0,0 +1,158 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "core/ring_list.h"
+
+#include <absl/strings/str_cat.h>
+#include <gmock/gmock.h>
+#include <mimalloc.h>
+
+#include <deque>
+#include <random>
+
+#include "base/gtest.h"
+#include "base/logging.h"
+
+extern "C" {
+#include "redis/zmalloc.h"
+}
+
+namespace dfly {
+
+using namespace std;
+
+class RingListTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    init_zmalloc_threadlocal(mi_heap_get_backing());
+  }
+
+  static vector<string> ToVec(const RingList& rl) {
+    vector<string> res;
+    for (size_t i = 0; i < rl.Size(); ++i)
+      res.emplace_back(rl.At(i));
+    return res;
+  }
+};
+
+TEST_F(RingListTest, PushPop) {
+  RingList rl;
+  EXPECT_TRUE(rl.Empty());
+
+  rl.PushBack("b");
+  rl.PushFront("a");
+  rl.PushBack("c");
+  EXPECT_THAT(ToVec(rl), testing::ElementsAre("a", "b", "c"));
+
+  EXPECT_EQ("a", rl.PopFront());
+  EXPECT_EQ("c", rl.PopBack());
+  EXPECT_EQ("b", rl.At(0));
+  EXPECT_EQ("b", rl.PopBack());
+  EXPECT_TRUE(rl.Empty());
+
+  // Churn around the wrap point of the buffer.
+  for (unsigned i = 0; i < 100; ++i) {
+    rl.PushBack(absl::StrCat(i));
+    rl.PushBack(absl::StrCat(i + 1));
+    EXPECT_EQ(absl::StrCat(i), rl.PopFront());
+    EXPECT_EQ(absl::StrCat(i + 1), rl.PopFront());
+  }
+  EXPECT_TRUE(rl.Empty());
+}
+
+TEST_F(RingListTest, InsertErase) {
+  RingList rl;
+  for (string_view s : {"a", "c", "e"})
+    rl.PushBack(s);
+
+  rl.Insert(1, "b");
+  rl.Insert(3, "d");
+  rl.Insert(5, "f");
+  rl.Insert(0, "_");
+  EXPECT_THAT(ToVec(rl), testing::ElementsAre("_", "a", "b", "c", "d", "e", "f"));
+
+  rl.Erase(0);
+  rl.Erase(5);
+  rl.Erase(2);
+  EXPECT_THAT(ToVec(rl), testing::ElementsAre("a", "b", "d", "e"));
+
+  rl.Set(1, "a much longer value than before");
+  EXPECT_EQ("a much longer value than before", rl.At(1));
+
+  rl.EraseFront(1);
+  rl.EraseBack(2);
+  EXPECT_THAT(ToVec(rl), testing::ElementsAre("a much longer value than before"));
+}
+
+TEST_F(RingListTest, Random) {
+  RingList rl;
+  deque<string> expected;
+  mt19937 rand(0);
+
+  for (unsigned i = 0; i < 10000; ++i) {
+    string val = absl::StrCat(i);
+    unsigned op = rand() % 6;
+    size_t index = expected.empty() ? 0 : rand() % expected.size();
+
+    switch (op) {
+      case 0:
+        rl.PushFront(val);
+        expected.push_front(val);
+        break;
+      case 1:
+        rl.PushBack(val);
+        expected.push_back(val);
+        break;
+      case 2:
+        if (!expected.empty()) {
+          ASSERT_EQ(expected.front(), rl.PopFront());
+          expected.pop_front();
+        }
+        break;
+      case 3:
+        if (!expected.empty()) {
+          ASSERT_EQ(expected.back(), rl.PopBack());
+          expected.pop_back();
+        }
+        break;
+      case 4:
+        rl.Insert(index, val);
+        expected.insert(expected.begin() + index, val);
+        break;
+      case 5:
+        if (!expected.empty()) {
+          rl.Erase(index);
+          expected.erase(expected.begin() + index);
+        }
+        break;
+    }
+
+    ASSERT_EQ(expected.size(), rl.Size());
+  }
+
+  for (size_t i = 0; i < expected.size(); ++i)
+    ASSERT_EQ(expected[i], rl.At(i));
+  EXPECT_GT(rl.MallocUsed(), expected.size() * sizeof(uint32_t));
+}
+
+TEST_F(RingListTest, Compact) {
+  RingList rl;
+  for (unsigned i = 0; i < 1000; ++i)
+    rl.PushBack("ab");
+
+  // 2 bytes of data and a 4 byte offset per element, plus the free room of both buffers.
+  EXPECT_LT(rl.MallocUsed(), 1000 * 12);
+
+  rl.Set(500, "");
+  rl.Insert(10, "");
+  EXPECT_EQ("", rl.At(10));
+  EXPECT_EQ("", rl.At(501));
+  EXPECT_EQ("ab", rl.At(502));
+
+  rl.EraseBack(900);
+  EXPECT_EQ(101u, rl.Size());
+  EXPECT_LT(rl.MallocUsed(), 2000u);
+}
+
+}  // namespace dfly
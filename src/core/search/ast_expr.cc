@@ -19,6 +19,15 @@ namespace dfly::search {
 AstTermNode::AstTermNode(string term) : term{term} {
 }
 
+AstAffixNode::AstAffixNode(string affix, Kind kind) : affix{std::move(affix)}, kind{kind} {
+}
+
+AstFuzzyNode::AstFuzzyNode(string_view pattern) {
+  distance = pattern.find_first_not_of('%');
+  DCHECK(distance > 0 && pattern.size() > 2 * distance);
+  term = pattern.substr(distance, pattern.size() - 2 * distance);
+}
+
 AstRangeNode::AstRangeNode(double lo, bool lo_excl, double hi, bool hi_excl)
     : lo{lo_excl ? nextafter(lo, hi) : lo}, hi{hi_excl ? nextafter(hi, lo) : hi} {
 }
@@ -29,6 +29,25 @@ struct AstTermNode {
   std::string term;
 };
 
+// Matches terms in text fields by a prefix (foo*), suffix (*foo) or infix (*foo*)
+struct AstAffixNode {
+  enum Kind { PREFIX, SUFFIX, INFIX };
+
+  AstAffixNode(std::string affix, Kind kind);
+
+  std::string affix;
+  Kind kind;
+};
+
+// Matches terms in text fields within a Levenshtein distance, given by the number of
+// enclosing percent signs (%foo% or %%foo%%)
+struct AstFuzzyNode {
+  explicit AstFuzzyNode(std::string_view pattern);
+
+  std::string term;
+  unsigned distance;
+};
+
 // Matches numeric range
 struct AstRangeNode {
   AstRangeNode(double lo, bool lo_excl, double hi, bool hi_excl);
@@ -97,8 +116,9 @@ struct AstSortNode {
 };
 
 using NodeVariants =
-    std::variant<std::monostate, AstStarNode, AstTermNode, AstRangeNode, AstNegateNode,
-                 AstLogicalNode, AstFieldNode, AstTagsNode, AstKnnNode, AstSortNode>;
+    std::variant<std::monostate, AstStarNode, AstTermNode, AstAffixNode, AstFuzzyNode,
+                 AstRangeNode, AstNegateNode, AstLogicalNode, AstFieldNode, AstTagsNode,
+                 AstKnnNode, AstSortNode>;
 
 struct AstNode : public NodeVariants {
   using variant::variant;
@@ -6,6 +6,7 @@
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/inlined_vector.h>
+#include <absl/functional/function_ref.h>
 
 #include <cstdint>
 #include <memory>
@@ -89,7 +90,13 @@ struct BaseIndex {
 // Base class for type-specific sorting indices.
 struct BaseSortIndex : BaseIndex {
   virtual SortableValue Lookup(DocId doc) const = 0;
-  virtual std::vector<ResultScore> Sort(std::vector<DocId>* ids, size_t limit, bool desc) const = 0;
+  // Calls its argument for every document of a result set.
+  using DocStream = absl::FunctionRef<void(absl::FunctionRef<void(DocId)>)>;
+
+  // Select the first limit documents of the stream in sort order into ids and return their
+  // values. Only the selected documents are kept while streaming.
+  virtual std::vector<ResultScore> Sort(DocStream docs, size_t limit, bool desc,
+                                        std::vector<DocId>* ids) const = 0;
 };
 
 }  // namespace dfly::search
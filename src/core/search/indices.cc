@@ -6,6 +6,7 @@
 
 #include <absl/container/flat_hash_set.h>
 #include <absl/strings/ascii.h>
+#include <absl/strings/match.h>
 #include <absl/strings/numbers.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/str_split.h>
@@ -21,6 +22,8 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <numeric>
 
 #include "base/logging.h"
 
@@ -63,6 +66,16 @@ absl::flat_hash_set<string> NormalizeTags(string_view taglist, bool case_sensiti
   return tags;
 }
 
+// Smallest string that is greater than all strings with the given prefix, empty if there is none.
+string PrefixSuccessor(string_view prefix) {
+  string out{prefix};
+  while (!out.empty() && static_cast<unsigned char>(out.back()) == 0xff)
+    out.pop_back();
+  if (!out.empty())
+    out.back()++;
+  return out;
+}
+
 };  // namespace
 
 NumericIndex::NumericIndex(PMR_NS::memory_resource* mr) : entries_{mr} {
@@ -98,8 +111,9 @@ vector<DocId> NumericIndex::Range(double l, double r) const {
 }
 
 template <typename C>
-BaseStringIndex<C>::BaseStringIndex(PMR_NS::memory_resource* mr, bool case_sensitive)
-    : case_sensitive_{case_sensitive}, entries_{mr} {
+BaseStringIndex<C>::BaseStringIndex(PMR_NS::memory_resource* mr, bool case_sensitive,
+                                    bool ordered_terms)
+    : case_sensitive_{case_sensitive}, entries_{mr}, ordered_terms_{ordered_terms}, terms_{mr} {
 }
 
 template <typename C>
@@ -116,10 +130,114 @@ const typename BaseStringIndex<C>::Container* BaseStringIndex<C>::Matching(strin
   return (it != entries_.end()) ? &it->second : nullptr;
 }
 
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingPrefix(
+    string_view prefix, size_t limit) const {
+  string tmp = case_sensitive_ ? string{prefix} : ToLower(prefix);
+
+  DCHECK(ordered_terms_);
+  vector<const Container*> out;
+  for (auto it = terms_.lower_bound(string_view{tmp}); it != terms_.end() && out.size() < limit;
+       ++it) {
+    if (!absl::StartsWith(*it, tmp))
+      break;
+    out.push_back(&entries_.find(string_view{*it})->second);
+  }
+  return out;
+}
+
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingInfix(
+    string_view infix, bool suffix_only, size_t limit) const {
+  string tmp = case_sensitive_ ? string{infix} : ToLower(infix);
+
+  // The terms are ordered by their prefix only, so all of them have to be checked.
+  vector<const Container*> out;
+  for (auto it = entries_.begin(); it != entries_.end() && out.size() < limit; ++it) {
+    string_view term{it->first};
+    if (suffix_only ? absl::EndsWith(term, tmp) : absl::StrContains(term, tmp))
+      out.push_back(&it->second);
+  }
+  return out;
+}
+
+template <typename C>
+vector<const typename BaseStringIndex<C>::Container*> BaseStringIndex<C>::MatchingFuzzy(
+    string_view word, unsigned distance, size_t limit) const {
+  string tmp = case_sensitive_ ? string{word} : ToLower(word);
+  word = tmp;
+
+  // Rows of the edit distance matrix between word and the prefixes of the current term. The
+  // rows of a common prefix are shared by consecutive terms, like in a traversal of a trie.
+  const size_t width = word.size() + 1;
+  vector<unsigned> rows(width);
+  iota(rows.begin(), rows.end(), 0u);
+
+  DCHECK(ordered_terms_);
+  vector<const Container*> out;
+  string_view prev;
+  auto it = terms_.begin();
+  while (it != terms_.end() && out.size() < limit) {
+    string_view term{*it};
+    size_t common =
+        mismatch(prev.begin(), prev.end(), term.begin(), term.end()).first - prev.begin();
+    common = min(common, rows.size() / width - 1);
+    rows.resize((common + 1) * width);
+    prev = term;
+
+    bool pruned = false;
+    for (size_t i = common; i < term.size(); i++) {
+      rows.resize((i + 2) * width);
+      const unsigned* above = &rows[i * width];
+      unsigned* row = &rows[(i + 1) * width];
+
+      row[0] = i + 1;
+      unsigned row_min = row[0];
+      for (size_t j = 1; j < width; j++) {
+        unsigned subst = above[j - 1] + (term[i] != word[j - 1]);
+        row[j] = min({above[j] + 1, row[j - 1] + 1, subst});
+        row_min = min(row_min, row[j]);
+      }
+
+      // Extending the prefix can not decrease the distance, so skip all terms that start with it.
+      if (row_min > distance) {
+        string next = PrefixSuccessor(term.substr(0, i + 1));
+        it = next.empty() ? terms_.end() : terms_.lower_bound(string_view{next});
+        pruned = true;
+        break;
+      }
+    }
+
+    if (pruned)
+      continue;
+
+    if (rows[term.size() * width + width - 1] <= distance)
+      out.push_back(&entries_.find(term)->second);
+    ++it;
+  }
+  return out;
+}
+
 template <typename C>
 typename BaseStringIndex<C>::Container* BaseStringIndex<C>::GetOrCreate(string_view word) {
   auto* mr = entries_.get_allocator().resource();
-  return &entries_.try_emplace(PMR_NS::string{word, mr}, mr, 1000 /* block size */).first->second;
+  auto [it, inserted] = entries_.try_emplace(PMR_NS::string{word, mr}, mr, 1000 /* block size */);
+  if (inserted && ordered_terms_)
+    terms_.emplace(word);
+  return &it->second;
+}
+
+template <typename C> void BaseStringIndex<C>::RemoveMatch(string_view word, DocId id) {
+  auto it = entries_.find(word);
+  if (it == entries_.end())
+    return;
+
+  it->second.Remove(id);
+  if (it->second.Size() == 0) {
+    entries_.erase(it);
+    if (ordered_terms_)
+      terms_.erase(word);
+  }
 }
 
 template <typename C>
@@ -138,24 +256,93 @@ void BaseStringIndex<C>::Remove(DocId id, DocumentAccessor* doc, string_view fie
   for (string_view str : doc->GetStrings(field))
     tokens.merge(Tokenize(str));
 
-  for (const auto& token : tokens) {
-    auto it = entries_.find(token);
-    if (it == entries_.end())
-      continue;
-
-    it->second.Remove(id);
-    if (it->second.Size() == 0)
-      entries_.erase(it);
-  }
+  for (string_view token : tokens)
+    RemoveMatch(token, id);
 }
 
 template struct BaseStringIndex<CompressedSortedSet>;
 template struct BaseStringIndex<SortedVector>;
 
+// BM25 parameters: term frequency saturation and document length normalization.
+constexpr double kBm25K1 = 1.2;
+constexpr double kBm25B = 0.75;
+
+TextIndex::TextIndex(PMR_NS::memory_resource* mr)
+    : BaseStringIndex(mr, false, true), doc_lengths_{mr}, repeated_terms_{mr} {
+}
+
+vector<pair<string, uint32_t>> TextIndex::CountTerms(DocumentAccessor* doc,
+                                                     string_view field) const {
+  absl::flat_hash_map<string, uint32_t> counts;
+  for (string_view str : doc->GetStrings(field)) {
+    for (string_view word : una::views::word_only::utf8(str))
+      counts[una::cases::to_lowercase_utf8(word)]++;
+  }
+  return {counts.begin(), counts.end()};
+}
+
+void TextIndex::Add(DocId id, DocumentAccessor* doc, string_view field) {
+  uint32_t length = 0;
+  for (const auto& [term, count] : CountTerms(doc, field)) {
+    GetOrCreate(term)->Insert(id);
+    length += count;
+    if (count > 1)
+      repeated_terms_[{id, TermHash(term)}] = count;
+  }
+
+  if (length == 0)
+    return;
+
+  if (doc_lengths_.size() <= id)
+    doc_lengths_.resize(id + 1);
+  doc_lengths_[id] = length;
+  total_length_ += length;
+  num_docs_++;
+}
+
+void TextIndex::Remove(DocId id, DocumentAccessor* doc, string_view field) {
+  for (const auto& [term, count] : CountTerms(doc, field)) {
+    RemoveMatch(term, id);
+    if (count > 1)
+      repeated_terms_.erase(pair{id, TermHash(term)});
+  }
+
+  if (id < doc_lengths_.size() && doc_lengths_[id] > 0) {
+    total_length_ -= doc_lengths_[id];
+    doc_lengths_[id] = 0;
+    num_docs_--;
+  }
+}
+
 absl::flat_hash_set<std::string> TextIndex::Tokenize(std::string_view value) const {
   return TokenizeWords(value);
 }
 
+uint64_t TextIndex::TermHash(string_view term) {
+  // Must fold the case like CountTerms does, or non-ASCII terms never find their frequencies.
+  return absl::Hash<string>{}(una::cases::to_lowercase_utf8(absl::StripAsciiWhitespace(term)));
+}
+
+double TextIndex::Idf(size_t doc_freq) const {
+  double n = min(doc_freq, num_docs_);
+  return log(1.0 + (num_docs_ - n + 0.5) / (n + 0.5));
+}
+
+double TextIndex::Score(DocId doc, uint64_t term_hash, double idf) const {
+  double tf = 1;
+  if (auto it = repeated_terms_.find(pair{doc, term_hash}); it != repeated_terms_.end())
+    tf = it->second;
+
+  DCHECK_LT(doc, doc_lengths_.size());
+  double avg_length = double(total_length_) / max<size_t>(num_docs_, 1);
+  double norm = 1 - kBm25B + kBm25B * doc_lengths_[doc] / avg_length;
+  return idf * tf * (kBm25K1 + 1) / (tf + kBm25K1 * norm);
+}
+
+double TextIndex::MaxScore(double idf) {
+  return idf * (kBm25K1 + 1);
+}
+
 absl::flat_hash_set<std::string> TagIndex::Tokenize(std::string_view value) const {
   return NormalizeTags(value, case_sensitive_, separator_);
 }
@@ -40,7 +40,9 @@ struct NumericIndex : public BaseIndex {
 template <typename C> struct BaseStringIndex : public BaseIndex {
   using Container = BlockList<C>;
 
-  BaseStringIndex(PMR_NS::memory_resource* mr, bool case_sensitive);
+  // ordered_terms keeps the terms in order as well, which the Matching* queries for patterns
+  // require.
+  BaseStringIndex(PMR_NS::memory_resource* mr, bool case_sensitive, bool ordered_terms = false);
 
   void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
   void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
@@ -51,9 +53,24 @@ template <typename C> struct BaseStringIndex : public BaseIndex {
   // Pointer is valid as long as index is not mutated. Nullptr if not found
   const Container* Matching(std::string_view str) const;
 
+  // Matches of all terms with the given prefix, at most limit of them. Pointers are valid as long
+  // as index is not mutated. Pattern queries need ordered_terms.
+  std::vector<const Container*> MatchingPrefix(std::string_view prefix, size_t limit) const;
+
+  // Matches of all terms containing infix, or ending with it if suffix_only is set.
+  std::vector<const Container*> MatchingInfix(std::string_view infix, bool suffix_only,
+                                              size_t limit) const;
+
+  // Matches of all terms within Levenshtein distance of word.
+  std::vector<const Container*> MatchingFuzzy(std::string_view word, unsigned distance,
+                                              size_t limit) const;
+
  protected:
   Container* GetOrCreate(std::string_view word);
 
+  // Removes id from the matches of word, and the word once it has none.
+  void RemoveMatch(std::string_view word, DocId id);
+
   struct PmrEqual {
     using is_transparent = void;
     bool operator()(const PMR_NS::string& lhs, const PMR_NS::string& rhs) const {
@@ -79,19 +96,57 @@ template <typename C> struct BaseStringIndex : public BaseIndex {
   absl::flat_hash_map<PMR_NS::string, Container, PmrHash, PmrEqual,
                       PMR_NS::polymorphic_allocator<std::pair<PMR_NS::string, Container>>>
       entries_;
+
+  // Term dictionary in order, so that prefix and fuzzy queries visit only the terms they can
+  // match. Exact lookups and updates keep the O(1) entries_, only ordered_terms indices pay
+  // for it.
+  bool ordered_terms_ = false;
+  absl::btree_set<PMR_NS::string, std::less<>, PMR_NS::polymorphic_allocator<PMR_NS::string>>
+      terms_;
 };
 
 // Index for text fields.
-// Hashmap based lookup per word.
+// Hashmap based lookup per word, with the words in order for pattern queries. Keeps the
+// statistics needed for BM25 relevance scoring: the length of every document and the
+// frequencies of the terms that occur in a document more than once.
 struct TextIndex : public BaseStringIndex<CompressedSortedSet> {
-  TextIndex(PMR_NS::memory_resource* mr) : BaseStringIndex(mr, false) {
-  }
+  explicit TextIndex(PMR_NS::memory_resource* mr);
+
+  void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
+  void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
 
   absl::flat_hash_set<std::string> Tokenize(std::string_view value) const override;
+
+  // Identifies a query term in the frequency table.
+  static uint64_t TermHash(std::string_view term);
+
+  // Inverse document frequency of a term matched by doc_freq documents.
+  double Idf(size_t doc_freq) const;
+
+  // BM25 score of a term in a document that contains it.
+  double Score(DocId doc, uint64_t term_hash, double idf) const;
+
+  // Upper bound of Score over all documents, reached as the term frequency grows.
+  static double MaxScore(double idf);
+
+ private:
+  std::vector<std::pair<std::string, uint32_t>> CountTerms(DocumentAccessor* doc,
+                                                           std::string_view field) const;
+
+  PMR_NS::vector<uint32_t> doc_lengths_;  // number of terms by document id
+  uint64_t total_length_ = 0;
+  size_t num_docs_ = 0;
+
+  // Frequencies of terms that occur more than once in a document, keyed by (doc, term hash).
+  // Most terms occur once per document, so storing only the exceptions keeps this small.
+  using TermKey = std::pair<DocId, uint64_t>;
+  absl::flat_hash_map<TermKey, uint32_t, absl::Hash<TermKey>, std::equal_to<TermKey>,
+                      PMR_NS::polymorphic_allocator<std::pair<const TermKey, uint32_t>>>
+      repeated_terms_;
 };
 
-// Index for text fields.
-// Hashmap based lookup per word.
+// Index for tag fields.
+// Hashmap based lookup per tag.
 struct TagIndex : public BaseStringIndex<SortedVector> {
   TagIndex(PMR_NS::memory_resource* mr, SchemaField::TagParams params)
       : BaseStringIndex(mr, params.case_sensitive), separator_{params.separator} {
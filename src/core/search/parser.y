@@ -67,8 +67,9 @@ using namespace std;
 // Needed 0 at the end to satisfy bison 3.5.1
 %token YYEOF 0
 %token <std::string> TERM "term" PARAM "param" FIELD "field"
+%token <std::string> PREFIX "prefix" SUFFIX "suffix" INFIX "infix" FUZZY "fuzzy term"
 
-%precedence TERM
+%precedence TERM PREFIX SUFFIX INFIX FUZZY
 %left OR_OP
 %left AND_OP
 %right NOT_OP
@@ -80,6 +81,7 @@ using namespace std;
 %nterm <bool> opt_lparen
 %nterm <AstExpr> final_query filter search_expr search_unary_expr search_or_expr search_and_expr numeric_filter_expr
 %nterm <AstExpr> field_cond field_cond_expr field_unary_expr field_or_expr field_and_expr tag_list
+%nterm <AstExpr> term_pattern
 
 %nterm <AstKnnNode> knn_query
 %nterm <std::string> opt_knn_alias
@@ -129,11 +131,13 @@ search_unary_expr:
   | NOT_OP search_unary_expr          { $$ = AstNegateNode(std::move($2)); }
   | TERM                              { $$ = AstTermNode(std::move($1)); }
   | UINT32                            { $$ = AstTermNode(to_string($1)); }
+  | term_pattern                      { $$ = std::move($1); }
   | FIELD COLON field_cond            { $$ = AstFieldNode(std::move($1), std::move($3)); }
 
 field_cond:
   TERM                                                  { $$ = AstTermNode(std::move($1)); }
   | UINT32                                              { $$ = AstTermNode(to_string($1)); }
+  | term_pattern                                        { $$ = std::move($1); }
   | NOT_OP field_cond                                   { $$ = AstNegateNode(std::move($2)); }
   | LPAREN field_cond_expr RPAREN                       { $$ = std::move($2); }
   | LBRACKET numeric_filter_expr RBRACKET               { $$ = std::move($2); }
@@ -168,6 +172,13 @@ field_unary_expr:
   | NOT_OP field_unary_expr                      { $$ = AstNegateNode(std::move($2)); };
   | TERM                                         { $$ = AstTermNode(std::move($1)); }
   | UINT32                                       { $$ = AstTermNode(to_string($1)); }
+  | term_pattern                                 { $$ = std::move($1); }
+
+term_pattern:
+  PREFIX                     { $$ = AstAffixNode(std::move($1), AstAffixNode::PREFIX); }
+  | SUFFIX                   { $$ = AstAffixNode(std::move($1), AstAffixNode::SUFFIX); }
+  | INFIX                    { $$ = AstAffixNode(std::move($1), AstAffixNode::INFIX); }
+  | FUZZY                    { $$ = AstFuzzyNode($1); }
 
 tag_list:
   TERM                       { $$ = AstTagsNode(std::move($1)); }
@@ -20,6 +20,7 @@
 #include "core/search/indices.h"
 #include "core/search/query_driver.h"
 #include "core/search/sort_indices.h"
+#include "core/search/top_k.h"
 #include "core/search/vector_utils.h"
 
 using namespace std;
@@ -118,6 +119,13 @@ struct ProfileBuilder {
     Overloaded node_info{
         [](monostate) -> string { return ""s; },
         [](const AstTermNode& n) { return absl::StrCat("Term{", n.term, "}"); },
+        [](const AstAffixNode& n) {
+          string_view kinds[] = {"Prefix", "Suffix", "Infix"};
+          return absl::StrCat(kinds[n.kind], "{", n.affix, "}");
+        },
+        [](const AstFuzzyNode& n) {
+          return absl::StrCat("Fuzzy{", n.term, ",d=", n.distance, "}");
+        },
         [](const AstRangeNode& n) { return absl::StrCat("Range{", n.lo, "<>", n.hi, "}"); },
         [](const AstLogicalNode& n) {
           auto op = n.op == AstLogicalNode::AND ? "and" : "or";
@@ -162,6 +170,9 @@ struct ProfileBuilder {
 struct BasicSearch {
   using LogicOp = AstLogicalNode::LogicOp;
 
+  // Maximum number of terms a prefix, infix or fuzzy term is expanded to per index.
+  static constexpr size_t kMaxTermExpansions = 200;
+
   BasicSearch(const FieldIndices* indices, size_t limit)
       : indices_{indices}, limit_{limit}, tmp_vec_{} {
   }
@@ -170,6 +181,10 @@ struct BasicSearch {
     profile_builder_ = ProfileBuilder{};
   }
 
+  void EnableRanking() {
+    ranked_ = true;
+  }
+
   // Get casted sub index by field
   template <typename T> T* GetIndex(string_view field) {
     static_assert(is_base_of_v<BaseIndex, T>);
@@ -269,6 +284,90 @@ struct BasicSearch {
     return UnifyResults(GetSubResults(selected_indices, mapping), LogicOp::OR);
   }
 
+  // Call cb for every document of the union of the posting lists in increasing order. All lists
+  // are merged in a single pass with a heap of their iterators.
+  template <typename F>
+  static void ForEachInUnion(const vector<const TextIndex::Container*>& lists, F&& cb) {
+    using It = TextIndex::Container::BlockListIterator;
+    vector<pair<It, It>> heap;
+    for (const auto* container : lists) {
+      if (container->begin() != container->end())
+        heap.emplace_back(container->begin(), container->end());
+    }
+
+    auto cmp = [](const auto& l, const auto& r) { return *l.first > *r.first; };
+    make_heap(heap.begin(), heap.end(), cmp);
+
+    optional<DocId> last;
+    while (!heap.empty()) {
+      pop_heap(heap.begin(), heap.end(), cmp);
+      auto& [it, end] = heap.back();
+      if (last != *it) {
+        last = *it;
+        cb(*it);
+      }
+
+      if (++it == end) {
+        heap.pop_back();
+      } else {
+        push_heap(heap.begin(), heap.end(), cmp);
+      }
+    }
+  }
+
+  // Union of the matches of all expanded terms. Pairwise merging would copy the accumulated
+  // result once per term.
+  IndexResult UnionExpansions(const vector<const TextIndex::Container*>& expansions) {
+    if (expansions.size() == 1)
+      return expansions.front();
+
+    size_t total = 0;
+    for (const auto* container : expansions)
+      total += container->Size();
+
+    vector<DocId> out;
+    out.reserve(total);
+    ForEachInUnion(expansions, [&out](DocId doc) { out.push_back(doc); });
+    return out;
+  }
+
+  // Expand a term pattern in the field's text index or in all text indices if no field is set
+  template <typename F> IndexResult SearchExpanded(string_view active_field, const F& expand) {
+    vector<const TextIndex::Container*> expansions;
+    if (!active_field.empty()) {
+      if (auto* index = GetIndex<TextIndex>(active_field); index)
+        expansions = expand(index);
+    } else {
+      for (TextIndex* index : indices_->GetAllTextIndices()) {
+        auto matched = expand(index);
+        expansions.insert(expansions.end(), matched.begin(), matched.end());
+      }
+    }
+
+    if (expansions.empty())
+      return IndexResult{};
+    return UnionExpansions(expansions);
+  }
+
+  // foo*, *foo, *foo*: union of all terms with the affix
+  IndexResult Search(const AstAffixNode& node, string_view active_field) {
+    auto expand = [&node](TextIndex* index) {
+      if (node.kind == AstAffixNode::PREFIX)
+        return index->MatchingPrefix(node.affix, kMaxTermExpansions);
+      return index->MatchingInfix(node.affix, node.kind == AstAffixNode::SUFFIX,
+                                  kMaxTermExpansions);
+    };
+    return SearchExpanded(active_field, expand);
+  }
+
+  // %foo%: union of all terms within the distance
+  IndexResult Search(const AstFuzzyNode& node, string_view active_field) {
+    auto expand = [&node](TextIndex* index) {
+      return index->MatchingFuzzy(node.term, node.distance, kMaxTermExpansions);
+    };
+    return SearchExpanded(active_field, expand);
+  }
+
   // [range]: access field's numeric index
   IndexResult Search(const AstRangeNode& node, string_view active_field) {
     DCHECK(!active_field.empty());
@@ -326,29 +425,29 @@ struct BasicSearch {
     preagg_total_ = sub_results.Size();
 
     if (auto* sort_index = GetSortIndex(node.field); sort_index) {
-      auto ids_vec = sub_results.Take();
-      scores_ = sort_index->Sort(&ids_vec, limit_, node.descending);
-      return ids_vec;
+      auto docs = [&sub_results](absl::FunctionRef<void(DocId)> cb) {
+        visit([cb](auto* set) { for_each(set->begin(), set->end(), cb); }, sub_results.Borrowed());
+      };
+      vector<DocId> ids;
+      scores_ = sort_index->Sort(docs, limit_, node.descending, &ids);
+      return ids;
     }
 
     return IndexResult{};
   }
 
   void SearchKnnFlat(FlatVectorIndex* vec_index, const AstKnnNode& knn, IndexResult&& sub_results) {
-    knn_distances_.reserve(sub_results.Size());
+    TopKHeap<pair<float, DocId>> closest{knn.limit};
     auto cb = [&](auto* set) {
       auto [dim, sim] = vec_index->Info();
       for (DocId matched_doc : *set) {
         float dist = VectorDistance(knn.vec.first.get(), vec_index->Get(matched_doc), dim, sim);
-        knn_distances_.emplace_back(dist, matched_doc);
+        closest.Push({dist, matched_doc});
       }
     };
     visit(cb, sub_results.Borrowed());
 
-    size_t prefix_size = min(knn.limit, knn_distances_.size());
-    partial_sort(knn_distances_.begin(), knn_distances_.begin() + prefix_size,
-                 knn_distances_.end());
-    knn_distances_.resize(prefix_size);
+    knn_distances_ = std::move(closest).TakeSorted();
   }
 
   void SearchKnnHnsw(HnswVectorIndex* vec_index, const AstKnnNode& knn, IndexResult&& sub_results) {
@@ -413,7 +512,186 @@ struct BasicSearch {
     return result;
   }
 
+  // A positive term of a ranked query in one text index.
+  struct RankedTerm {
+    const TextIndex* index;
+    const TextIndex::Container* postings;
+    uint64_t hash;
+    double idf;
+    double max_score;
+  };
+
+  // Collect all terms that contribute to relevance, i.e. that are not negated.
+  void CollectRankedTerms(const AstNode& node, string_view active_field, vector<RankedTerm>* out) {
+    auto add_term = [this, out](const TextIndex* index, string_view term) {
+      if (auto* postings = index->Matching(term); postings) {
+        double idf = index->Idf(postings->Size());
+        out->push_back({index, postings, TextIndex::TermHash(term), idf, TextIndex::MaxScore(idf)});
+      }
+    };
+
+    Overloaded collect{
+        [&](const AstTermNode& n) {
+          if (active_field.empty()) {
+            for (TextIndex* index : indices_->GetAllTextIndices())
+              add_term(index, n.term);
+          } else if (auto* index = GetIndex<TextIndex>(active_field); index) {
+            add_term(index, n.term);
+          }
+        },
+        [&](const AstLogicalNode& n) {
+          for (const auto& sub : n.nodes)
+            CollectRankedTerms(sub, active_field, out);
+        },
+        [&](const AstFieldNode& n) { CollectRankedTerms(*n.node, n.field, out); },
+        [](const auto&) {},
+    };
+    visit(collect, node.Variant());
+  }
+
+  // True if the query matches exactly the documents of its terms, i.e. it is a term or a
+  // disjunction of terms.
+  static bool IsTermDisjunction(const AstNode& node) {
+    Overloaded check{
+        [](const AstTermNode&) { return true; },
+        [](const AstFieldNode& n) { return IsTermDisjunction(*n.node); },
+        [](const AstLogicalNode& n) {
+          return n.op == LogicOp::OR && all_of(n.nodes.begin(), n.nodes.end(), IsTermDisjunction);
+        },
+        [](const auto&) { return false; },
+    };
+    return visit(check, node.Variant());
+  }
+
+  using ScoredDoc = pair<double, DocId>;
+
+  // Keeps the documents with the highest scores.
+  using TopScored = TopKHeap<ScoredDoc, greater<ScoredDoc>>;
+
+  // MaxScore top-k over a disjunction of terms. The terms are ordered by the upper bound of their
+  // scores. Once the k-th best score exceeds the sum of the bounds of the lowest terms, a document
+  // that contains only those terms can not enter the top-k. So only the remaining, essential
+  // terms produce candidates, and the others are probed only while the candidate can still make
+  // it. Most documents of frequent terms are never scored.
+  vector<ScoredDoc> TopKMaxScore(vector<RankedTerm> terms) {
+    sort(terms.begin(), terms.end(),
+         [](const auto& l, const auto& r) { return l.max_score < r.max_score; });
+
+    size_t num_terms = terms.size();
+    vector<double> bound_sum(num_terms + 1, 0);  // sum of the bounds of terms [0, i)
+    for (size_t i = 0; i < num_terms; i++)
+      bound_sum[i + 1] = bound_sum[i] + terms[i].max_score;
+
+    using It = TextIndex::Container::BlockListIterator;
+    vector<It> its, ends;
+    for (const auto& term : terms) {
+      its.push_back(term.postings->begin());
+      ends.push_back(term.postings->end());
+    }
+
+    auto score_if_at = [&](size_t i, DocId doc, double* score) {
+      if (its[i] != ends[i] && *its[i] == doc) {
+        *score += terms[i].index->Score(doc, terms[i].hash, terms[i].idf);
+        ++its[i];
+      }
+    };
+
+    TopScored top{limit_};
+    double threshold = 0;
+    size_t essential = 0;  // index of the first essential term
+    while (limit_ > 0) {
+      optional<DocId> candidate;
+      for (size_t i = essential; i < num_terms; i++) {
+        if (its[i] != ends[i] && (!candidate || *its[i] < *candidate))
+          candidate = *its[i];
+      }
+      if (!candidate)
+        break;
+
+      double score = 0;
+      for (size_t i = essential; i < num_terms; i++)
+        score_if_at(i, *candidate, &score);
+
+      for (size_t i = essential; i-- > 0;) {
+        if (score + bound_sum[i + 1] <= threshold)
+          break;
+        while (its[i] != ends[i] && *its[i] < *candidate)
+          ++its[i];
+        score_if_at(i, *candidate, &score);
+      }
+
+      top.Push({score, *candidate});
+      if (top.Full()) {
+        threshold = top.Last().first;
+        while (essential < num_terms && bound_sum[essential + 1] <= threshold)
+          essential++;
+      }
+    }
+    return std::move(top).TakeSorted();
+  }
+
+  // Score all matched documents, for queries that are not a plain disjunction of terms.
+  vector<ScoredDoc> TopKExhaustive(const vector<DocId>& ids, const vector<RankedTerm>& terms) {
+    vector<double> scores(ids.size(), 0);
+    for (const auto& term : terms) {
+      auto it = term.postings->begin();
+      for (size_t i = 0; it != term.postings->end() && i < ids.size();) {
+        if (*it < ids[i]) {
+          ++it;
+        } else if (ids[i] < *it) {
+          i++;
+        } else {
+          scores[i] += term.index->Score(ids[i], term.hash, term.idf);
+          ++it, i++;
+        }
+      }
+    }
+
+    TopScored top{limit_};
+    for (size_t i = 0; i < ids.size(); i++)
+      top.Push({scores[i], ids[i]});
+    return std::move(top).TakeSorted();
+  }
+
+  // Rank the matches by BM25 relevance and return the best limit_ of them.
+  SearchResult SearchRanked(const AstNode& query) {
+    vector<RankedTerm> terms;
+    CollectRankedTerms(query, "", &terms);
+
+    size_t total = 0;
+    vector<ScoredDoc> top;
+    if (IsTermDisjunction(query)) {
+      vector<const TextIndex::Container*> lists;
+      for (const auto& term : terms)
+        lists.push_back(term.postings);
+      ForEachInUnion(lists, [&total](DocId) { total++; });
+      top = TopKMaxScore(std::move(terms));
+    } else {
+      vector<DocId> ids = SearchGeneric(query, "").Take();
+      total = ids.size();
+      top = TopKExhaustive(ids, terms);
+    }
+
+    vector<DocId> ids(top.size());
+    for (size_t i = 0; i < top.size(); i++) {
+      ids[i] = top[i].second;
+      scores_.emplace_back(top[i].first);
+    }
+
+    optional<AlgorithmProfile> profile =
+        profile_builder_ ? make_optional(profile_builder_->Take()) : nullopt;
+    return SearchResult{total,
+                        total,
+                        std::move(ids),
+                        std::move(scores_),
+                        std::move(profile),
+                        std::move(error_)};
+  }
+
   SearchResult Search(const AstNode& query) {
+    if (ranked_ && !holds_alternative<AstKnnNode>(query) && !holds_alternative<AstSortNode>(query))
+      return SearchRanked(query);
+
     IndexResult result = SearchGeneric(query, "", true);
 
     // Extract profile if enabled
@@ -431,6 +709,7 @@ struct BasicSearch {
 
   const FieldIndices* indices_;
   size_t limit_;
+  bool ranked_ = false;
 
   size_t preagg_total_ = 0;
   string error_;
@@ -599,6 +878,8 @@ SearchResult SearchAlgorithm::Search(const FieldIndices* index, size_t limit) co
   auto bs = BasicSearch{index, limit};
   if (profiling_enabled_)
     bs.EnableProfiling();
+  if (ranking_enabled_)
+    bs.EnableRanking();
   return bs.Search(*query_);
 }
 
@@ -616,6 +897,10 @@ optional<AggregationInfo> SearchAlgorithm::HasAggregation() const {
     return AggregationInfo{nullopt, alias, sort->descending};
   }
 
+  // Ranked results are merged by their relevance, best first.
+  if (ranking_enabled_)
+    return AggregationInfo{nullopt, "", true};
+
   return nullopt;
 }
 
@@ -623,4 +908,8 @@ void SearchAlgorithm::EnableProfiling() {
   profiling_enabled_ = true;
 }
 
+void SearchAlgorithm::EnableRanking() {
+  ranking_enabled_ = true;
+}
+
 }  // namespace dfly::search
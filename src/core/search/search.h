@@ -145,8 +145,12 @@ class SearchAlgorithm {
 
   void EnableProfiling();
 
+  // Rank text matches by BM25 relevance. Ignored for queries with KNN or SORTBY.
+  void EnableRanking();
+
  private:
   bool profiling_enabled_ = false;
+  bool ranking_enabled_ = false;
   std::unique_ptr<AstNode> query_;
 };
 
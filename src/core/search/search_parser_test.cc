@@ -142,6 +142,18 @@ TEST_F(SearchParserTest, Numeric) {
   NEXT_EQ(TOK_TERM, string, "22");
 }
 
+TEST_F(SearchParserTest, TermPatterns) {
+  SetInput("foo* *bar *baz* %qux% %%quux%%");
+  NEXT_EQ(TOK_PREFIX, string, "foo");
+  NEXT_EQ(TOK_SUFFIX, string, "bar");
+  NEXT_EQ(TOK_INFIX, string, "baz");
+  NEXT_EQ(TOK_FUZZY, string, "%qux%");
+  NEXT_EQ(TOK_FUZZY, string, "%%quux%%");
+
+  EXPECT_EQ(0, Parse("@title:(hel* | %wrld%) -*ing"));
+  EXPECT_EQ(1, Parse("%%foo%"));
+}
+
 TEST_F(SearchParserTest, KNN) {
   SetInput("*=>[KNN 1 @vector field_vec]");
   NEXT_TOK(TOK_STAR);
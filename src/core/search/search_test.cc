@@ -14,12 +14,15 @@
 
 #include <algorithm>
 #include <memory_resource>
+#include <numeric>
 #include <random>
 
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "core/search/base.h"
+#include "core/search/indices.h"
 #include "core/search/query_driver.h"
+#include "core/search/top_k.h"
 #include "core/search/vector_utils.h"
 
 namespace dfly {
@@ -163,6 +166,46 @@ TEST_F(SearchTest, MatchTerm) {
   EXPECT_TRUE(Check()) << GetError();
 }
 
+TEST_F(SearchTest, MatchPrefix) {
+  PrepareQuery("pre*");
+
+  ExpectAll("pre", "prefix", "Pretty good", "a preview");
+  ExpectNone("repr", "spread", "pr");
+
+  EXPECT_TRUE(Check()) << GetError();
+}
+
+TEST_F(SearchTest, MatchInfixAndSuffix) {
+  PrepareQuery("*ing");
+  ExpectAll("sing", "Running late", "ing");
+  ExpectNone("ingot", "singer");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareQuery("*ell*");
+  ExpectAll("hello", "ell", "Yellow sun", "shell");
+  ExpectNone("eel", "elk");
+  EXPECT_TRUE(Check()) << GetError();
+}
+
+TEST_F(SearchTest, MatchFuzzy) {
+  PrepareQuery("%word%");
+  ExpectAll("word", "ward", "words", "wrd", "sword");
+  ExpectNone("wards", "weird", "w");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareQuery("%%word%%");
+  ExpectAll("word", "wards", "wo", "swords", "world");
+  ExpectNone("w", "cards", "keyboard");
+  EXPECT_TRUE(Check()) << GetError();
+
+  PrepareSchema({{"title", SchemaField::TEXT}, {"body", SchemaField::TEXT}});
+  PrepareQuery("@title:%helo% | @body:wor*");
+  using Map = MockedDocument::Map;
+  ExpectAll(Map{{"title", "hello"}, {"body", "no"}}, Map{{"title", "no"}, {"body", "world"}});
+  ExpectNone(Map{{"title", "halt"}, {"body", "sword"}});
+  EXPECT_TRUE(Check()) << GetError();
+}
+
 TEST_F(SearchTest, MatchNotTerm) {
   PrepareQuery("-foo");
 
@@ -399,6 +442,59 @@ TEST_F(SearchTest, Errors) {
   EXPECT_THAT(algo.Search(&indices).error, HasSubstr("Wrong vector index dimensions"));
 }
 
+TEST_F(SearchTest, RankBm25) {
+  auto schema = MakeSimpleSchema({{"title", SchemaField::TEXT}});
+  FieldIndices indices{schema, PMR_NS::get_default_resource()};
+
+  vector<string> titles = {"apple banana", "apple apple apple", "banana cherry",
+                           "cherry date fig grape"};
+  for (size_t i = titles.size(); i < 100; i++)
+    titles.push_back("filler text number");
+
+  for (DocId i = 0; i < titles.size(); i++) {
+    MockedDocument doc{Map{{"title", titles[i]}}};
+    indices.Add(i, &doc);
+  }
+
+  SearchAlgorithm algo{};
+  QueryParams params;
+  algo.Init("apple", &params);
+  algo.EnableRanking();
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1, 0));
+
+  // Rare terms outrank the frequent one, which is not scored once it can not make the top 3
+  algo.Init("apple | cherry | @title:text", &params);
+  algo.EnableRanking();
+  auto res = algo.Search(&indices, 3);
+  EXPECT_EQ(res.total, 100u);
+  EXPECT_THAT(res.ids, testing::UnorderedElementsAre(1, 0, 2));
+  EXPECT_EQ(res.ids.front(), 1u);
+  ASSERT_EQ(res.scores.size(), 3u);
+  EXPECT_TRUE(get<double>(res.scores[0]) >= get<double>(res.scores[2]));
+
+  // Queries other than disjunctions of terms score all their matches
+  algo.Init("apple -banana", &params);
+  algo.EnableRanking();
+  EXPECT_THAT(algo.Search(&indices).ids, testing::ElementsAre(1));
+
+  // Term frequencies are keyed by the case folding of the index
+  EXPECT_EQ(TextIndex::TermHash("\xc3\x84pfel"), TextIndex::TermHash("\xc3\xa4pfel"));  // Äpfel
+}
+
+TEST(TopKHeapTest, SelectsFirstK) {
+  vector<int> values(1000);
+  iota(values.begin(), values.end(), 0);
+  shuffle(values.begin(), values.end(), default_random_engine{});
+
+  TopKHeap<int, greater<int>> top{5};
+  for (int v : values)
+    top.Push(v);
+  EXPECT_THAT(std::move(top).TakeSorted(), testing::ElementsAre(999, 998, 997, 996, 995));
+
+  TopKHeap<int> none{0};
+  EXPECT_FALSE(none.Push(1));
+}
+
 class KnnTest : public SearchTest, public testing::WithParamInterface<bool /* hnsw */> {};
 
 TEST_P(KnnTest, Simple1D) {
@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <type_traits>
 
+#include "core/search/top_k.h"
+
 namespace dfly::search {
 
 using namespace std;
@@ -32,14 +34,16 @@ template <typename T> SortableValue SimpleValueSortIndex<T>::Lookup(DocId doc) c
 }
 
 template <typename T>
-std::vector<ResultScore> SimpleValueSortIndex<T>::Sort(std::vector<DocId>* ids, size_t limit,
-                                                       bool desc) const {
-  auto cb = [this, desc](const auto& lhs, const auto& rhs) {
+std::vector<ResultScore> SimpleValueSortIndex<T>::Sort(DocStream docs, size_t limit, bool desc,
+                                                       std::vector<DocId>* ids) const {
+  auto less = [this, desc](DocId lhs, DocId rhs) {
     return desc ? (values_[lhs] > values_[rhs]) : (values_[lhs] < values_[rhs]);
   };
-  std::partial_sort(ids->begin(), ids->begin() + std::min(ids->size(), limit), ids->end(), cb);
+  TopKHeap<DocId, decltype(less)> top{limit, less};
+  docs([&top](DocId id) { top.Push(id); });
+  *ids = std::move(top).TakeSorted();
 
-  vector<ResultScore> out(min(ids->size(), limit));
+  vector<ResultScore> out(ids->size());
   for (size_t i = 0; i < out.size(); i++)
     out[i] = values_[(*ids)[i]];
   return out;
@@ -22,7 +22,8 @@ template <typename T> struct SimpleValueSortIndex : BaseSortIndex {
   SimpleValueSortIndex(PMR_NS::memory_resource* mr);
 
   SortableValue Lookup(DocId doc) const override;
-  std::vector<ResultScore> Sort(std::vector<DocId>* ids, size_t limit, bool desc) const override;
+  std::vector<ResultScore> Sort(DocStream docs, size_t limit, bool desc,
+                                std::vector<DocId>* ids) const override;
 
   void Add(DocId id, DocumentAccessor* doc, std::string_view field) override;
   void Remove(DocId id, DocumentAccessor* doc, std::string_view field) override;
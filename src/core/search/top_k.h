@@ -0,0 +1,63 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace dfly::search {
+
+// Selects the first k elements of a stream by the Less ordering. Keeps a binary heap of at most
+// k elements with the last of them on top, so selecting from n elements takes O(n log k) time
+// and O(k) memory, and elements that can not make it are rejected with a single comparison.
+template <typename T, typename Less = std::less<T>> class TopKHeap {
+ public:
+  explicit TopKHeap(size_t k, Less less = Less{}) : k_{k}, less_{std::move(less)} {
+  }
+
+  // Returns true if the element is among the first k so far.
+  bool Push(T value) {
+    if (heap_.size() < k_) {
+      heap_.push_back(std::move(value));
+      std::push_heap(heap_.begin(), heap_.end(), less_);
+      return true;
+    }
+
+    if (k_ == 0 || !less_(value, heap_.front()))
+      return false;
+
+    std::pop_heap(heap_.begin(), heap_.end(), less_);
+    heap_.back() = std::move(value);
+    std::push_heap(heap_.begin(), heap_.end(), less_);
+    return true;
+  }
+
+  bool Full() const {
+    return heap_.size() == k_;
+  }
+
+  size_t Size() const {
+    return heap_.size();
+  }
+
+  // The last of the selected elements. Must not be empty.
+  const T& Last() const {
+    return heap_.front();
+  }
+
+  // Returns the selected elements in order.
+  std::vector<T> TakeSorted() && {
+    std::sort_heap(heap_.begin(), heap_.end(), less_);
+    return std::move(heap_);
+  }
+
+ private:
+  size_t k_;
+  Less less_;
+  std::vector<T> heap_;
+};
+
+}  // namespace dfly::search
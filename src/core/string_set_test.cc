@@ -418,6 +418,37 @@ TEST_F(StringSetTest, Ttl) {
   }
 }
 
+TEST_F(StringSetTest, ExpireDue) {
+  for (unsigned i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(ss_->Add(StrCat("foo", i), i % 2 ? i / 100 + 1 : UINT32_MAX));
+  }
+  EXPECT_EQ(1000u, ss_->UpperBoundSize());
+  EXPECT_EQ(1u, ss_->NextExpiry());
+
+  // Nothing is due yet
+  EXPECT_EQ(0u, ss_->ExpireDue(100));
+
+  // Only the buckets of due entries are visited
+  ss_->set_time(1);
+  EXPECT_EQ(50u, ss_->ExpireDue(1000));
+  EXPECT_EQ(950u, ss_->UpperBoundSize());
+  EXPECT_EQ(2u, ss_->NextExpiry());
+
+  ss_->set_time(5);
+  while (ss_->ExpireDue(8) > 0) {
+  }
+  EXPECT_EQ(750u, ss_->UpperBoundSize());
+
+  ss_->set_time(100);
+  while (ss_->ExpireDue(8) > 0) {
+  }
+  EXPECT_EQ(500u, ss_->UpperBoundSize());
+  EXPECT_EQ(UINT32_MAX, ss_->NextExpiry());
+
+  for (auto it = ss_->begin(); it != ss_->end(); ++it)
+    EXPECT_FALSE(it.HasExpiry());
+}
+
 TEST_F(StringSetTest, Grow) {
   mt19937 generator(0);
 
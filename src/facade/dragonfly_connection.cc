@@ -369,7 +369,10 @@ size_t Connection::MessageHandle::UsedMemory() const {
       return 0;  // no access to internal type, memory usage negligible
     }
     size_t operator()(const InvalidationMessage& msg) {
-      return 0;
+      size_t keys_size = 0;
+      for (const auto& key : msg.keys)
+        keys_size += key.capacity();
+      return msg.keys.capacity() * sizeof(string) + keys_size;
     }
     size_t operator()(const MCPipelineMessagePtr& msg) {
       return sizeof(MCPipelineMessage) + msg->backing_size +
@@ -465,13 +468,20 @@ void Connection::DispatchOperations::operator()(CheckpointMessage msg) {
 
 void Connection::DispatchOperations::operator()(const InvalidationMessage& msg) {
   RedisReplyBuilder* rbuilder = (RedisReplyBuilder*)builder;
-  DCHECK(rbuilder->IsResp3());
-  rbuilder->StartCollection(2, facade::RedisReplyBuilder::CollectionType::PUSH);
-  rbuilder->SendBulkString("invalidate");
+  if (msg.redirected) {
+    rbuilder->StartCollection(3, facade::RedisReplyBuilder::CollectionType::PUSH);
+    rbuilder->SendBulkString("message");
+    rbuilder->SendBulkString("__redis__:invalidate");
+  } else {
+    DCHECK(rbuilder->IsResp3());
+    rbuilder->StartCollection(2, facade::RedisReplyBuilder::CollectionType::PUSH);
+    rbuilder->SendBulkString("invalidate");
+  }
+
   if (msg.invalidate_due_to_flush) {
     rbuilder->SendNull();
   } else {
-    std::string_view keys[] = {msg.key};
+    vector<string_view> keys(msg.keys.begin(), msg.keys.end());
     rbuilder->SendStringArr(keys);
   }
 }
@@ -1562,6 +1572,20 @@ void Connection::SendCheckpoint(fb2::BlockingCounter bc, bool ignore_paused, boo
 }
 
 void Connection::SendInvalidationMessageAsync(InvalidationMessage msg) {
+  // The dispatch fiber has not reached the last message yet, so it is safe to extend it.
+  if (!msg.invalidate_due_to_flush && !dispatch_q_.empty() && !cc_->conn_closing) {
+    MessageHandle& last = dispatch_q_.back();
+    auto* last_msg = get_if<InvalidationMessage>(&last.handle);
+    if (last_msg && !last_msg->invalidate_due_to_flush &&
+        last_msg->redirected == msg.redirected) {
+      size_t prev_mem = last.UsedMemory();
+      last_msg->keys.insert(last_msg->keys.end(), make_move_iterator(msg.keys.begin()),
+                            make_move_iterator(msg.keys.end()));
+      stats_->dispatch_queue_bytes += last.UsedMemory() - prev_mem;
+      return;
+    }
+  }
+
   SendAsync({std::move(msg)});
 }
 
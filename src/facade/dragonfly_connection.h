@@ -123,9 +123,13 @@ class Connection : public util::Connection {
     util::fb2::BlockingCounter bc;  // Decremented counter when processed
   };
 
+  // Invalidation of client side caches. Invalidations that are queued one after another are
+  // coalesced into a single message.
   struct InvalidationMessage {
-    std::string key;
+    std::vector<std::string> keys;
     bool invalidate_due_to_flush = false;
+    // sent as a message of __redis__:invalidate (CLIENT TRACKING REDIRECT)
+    bool redirected = false;
   };
 
   struct MessageDeleter {
@@ -227,7 +231,8 @@ class Connection : public util::Connection {
   void SendCheckpoint(util::fb2::BlockingCounter bc, bool ignore_paused = false,
                       bool ignore_blocked = false);
 
-  // Add InvalidationMessage to dispatch queue.
+  // Add InvalidationMessage to dispatch queue. Merges it into the last queued message if that is
+  // a compatible invalidation, so a burst of invalidations results in a single push.
   virtual void SendInvalidationMessageAsync(InvalidationMessage);
 
   // Must be called before sending pubsub messages to ensure the threads pipeline queue limit is not
@@ -90,6 +90,10 @@ void SinkReplyBuilder::Send(const iovec* v, uint32_t len) {
     return;
   }
 
+  WriteToSink(v, len, bsize);
+}
+
+void SinkReplyBuilder::WriteToSink(const iovec* v, uint32_t len, size_t bsize) {
   int64_t before_ns = util::fb2::ProactorBase::GetMonotonicTimeNs();
   error_code ec;
   send_active_ = true;
@@ -128,6 +132,13 @@ void SinkReplyBuilder::SendRaw(std::string_view raw) {
   Send(&v, 1);
 }
 
+void SinkReplyBuilder::SendRawDirect(std::string_view raw) {
+  has_replied_ = true;
+  DCHECK(sink_);
+  iovec v = {IoVec(raw)};
+  WriteToSink(&v, 1, raw.size());
+}
+
 void SinkReplyBuilder::ExpectReply() {
   has_replied_ = false;
 }
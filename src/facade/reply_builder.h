@@ -153,6 +153,12 @@ class SinkReplyBuilder {
 
   void Send(const iovec* v, uint32_t len);
 
+  // Writes raw data to the sink right away, after the batched replies, even in batch mode.
+  void SendRawDirect(std::string_view str);
+
+  // Writes the batched replies and then v, which holds bsize bytes, to the sink.
+  void WriteToSink(const iovec* v, uint32_t len, size_t bsize);
+
   void StartAggregate();
   void StopAggregate();
 
@@ -240,6 +246,14 @@ class RedisReplyBuilder : public SinkReplyBuilder {
 
   virtual void StartCollection(unsigned len, CollectionType type);
 
+  // Sends collection elements that were already serialized as RESP, e.g. by the shard that read
+  // them. The elements are never batched, so the call returns once the socket took them, also
+  // for pipelined commands. Not supported by the capturing builder, which records replies by
+  // their type.
+  void SendSerialized(std::string_view resp) {
+    SendRawDirect(resp);
+  }
+
   static char* FormatDouble(double val, char* dest, unsigned dest_len);
 
  private:
@@ -43,6 +43,7 @@ const char *strEncoding(int encoding) {
     case OBJ_ENCODING_QUICKLIST: return "quicklist";
     case OBJ_ENCODING_STREAM: return "stream";
     case OBJ_ENCODING_LISTPACK: return "listpack";
+    case OBJ_ENCODING_RINGLIST: return "ringlist";
     case OBJ_ENCODING_COMPRESS_INTERNAL: return "compress_internal";
     default: return "unknown";
     }
@@ -82,6 +82,7 @@ const char *strEncoding(int encoding);
 #define OBJ_ENCODING_QUICKLIST 9U /* Encoded as linked list of ziplists */
 #define OBJ_ENCODING_STREAM 10U /* Encoded as a radix tree of listpacks */
 #define OBJ_ENCODING_LISTPACK 11 /* Encoded as a listpack */
+#define OBJ_ENCODING_RINGLIST 12U /* Encoded as a dragonfly RingList */
 #define OBJ_ENCODING_COMPRESS_INTERNAL 15U  /* Kept as lzf compressed, to pass compressed blob to another thread */
 
 #endif /* __REDIS_AUX_H */
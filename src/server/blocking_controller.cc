@@ -6,19 +6,29 @@
 
 #include <absl/container/inlined_vector.h>
 
+#include <absl/time/clock.h>
+
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 
+#include "base/flags.h"
 #include "base/logging.h"
 #include "server/engine_shard_set.h"
+#include "server/server_state.h"
 #include "server/transaction.h"
 
+ABSL_FLAG(uint32_t, blocking_wakeup_batch, 64,
+          "Maximum number of transactions blocked on a key that are served in queue order by the "
+          "shard pass that finds the key ready. 0 wakes them one by one.");
+
 namespace dfly {
 
 using namespace std;
+using absl::GetFlag;
 
 struct WatchItem {
   Transaction* trans;
   KeyReadyChecker key_ready_checker;
+  uint64_t notify_ns = 0;  // when the transaction was notified.
 
   Transaction* get() const {
     return trans;
@@ -57,11 +67,13 @@ struct BlockingController::DbWatchTable {
   // Requires that the key queue be in the required state.
   bool AddAwakeEvent(string_view key);
 
-  // Returns true if awakened tx was removed from the queue.
-  bool UnwatchTx(string_view key, Transaction* tx);
+  // Returns true if awakened tx was removed from the queue and sets notify_ns to the time
+  // it was notified.
+  bool UnwatchTx(string_view key, Transaction* tx, uint64_t* notify_ns);
 };
 
-bool BlockingController::DbWatchTable::UnwatchTx(string_view key, Transaction* tx) {
+bool BlockingController::DbWatchTable::UnwatchTx(string_view key, Transaction* tx,
+                                                 uint64_t* notify_ns) {
   auto wq_it = queue_map.find(key);
 
   // With multiple same keys we may have misses because the first iteration
@@ -74,6 +86,7 @@ bool BlockingController::DbWatchTable::UnwatchTx(string_view key, Transaction* t
 
   bool res = false;
   if (wq->state == WatchQueue::ACTIVE && wq->items.front().get() == tx) {
+    *notify_ns = wq->items.front().notify_ns;
     wq->items.pop_front();
 
     // We suspend the queue and add keys to re-verification.
@@ -136,9 +149,14 @@ void BlockingController::FinalizeWatched(Keys keys, Transaction* tx) {
   // Add keys of processed transaction so we could awake the next one in the queue
   // in case those keys still exist.
   for (string_view key : base::it::Wrap(facade::kToSV, keys)) {
-    bool removed_awakened = wt.UnwatchTx(key, tx);
+    uint64_t notify_ns = 0;
+    bool removed_awakened = wt.UnwatchTx(key, tx, &notify_ns);
     CHECK(!removed_awakened || removed)
         << tx->DebugId() << " " << key << " " << tx->DEBUG_GetLocalMask(owner_->shard_id());
+    if (removed_awakened) {
+      uint64_t now = absl::GetCurrentTimeNanos();
+      owner_->stats().blocked_wakeup_latency_usec += (now - min(now, notify_ns)) / 1000;
+    }
   }
 
   if (wt.queue_map.empty()) {
@@ -155,46 +173,55 @@ void BlockingController::NotifyPending() {
   DbContext context;
   context.time_now_ms = GetCurrentTimeMs();
 
-  for (DbIndex index : awakened_indices_) {
-    auto dbit = watched_dbs_.find(index);
-    if (dbit == watched_dbs_.end())
-      continue;
-
-    context.db_index = index;
-    DbWatchTable& wt = *dbit->second;
-    for (const auto& key : wt.awakened_keys) {
-      string_view sv_key = key;
-      DVLOG(1) << "Processing awakened key " << sv_key;
-      auto w_it = wt.queue_map.find(sv_key);
-      if (w_it == wt.queue_map.end()) {
-        // This should not happen because we remove keys from awakened_keys every type we remove
-        // the entry from queue_map. TODO: to make it a CHECK after Dec 2024
-        LOG(ERROR) << "Internal error: Key " << sv_key
-                   << " was not found in the watch queue, wt.awakened_keys len is "
-                   << wt.awakened_keys.size() << " wt.queue_map len is " << wt.queue_map.size();
-        for (const auto& item : wt.awakened_keys) {
-          LOG(ERROR) << "Awakened key: " << item;
-        }
+  // Serving a waiter can make more keys ready, e.g. BLMOVE pushes to its destination. Those
+  // keys are added to the awakened sets while we iterate over copies of them, and handled by
+  // the next round.
+  while (!awakened_indices_.empty()) {
+    auto indices = std::move(awakened_indices_);
+    awakened_indices_.clear();
 
+    for (DbIndex index : indices) {
+      auto dbit = watched_dbs_.find(index);
+      if (dbit == watched_dbs_.end())
         continue;
-      }
 
-      CHECK(w_it != wt.queue_map.end());
-      DVLOG(1) << "Notify WQ: [" << owner_->shard_id() << "] " << key;
-      WatchQueue* wq = w_it->second.get();
-      NotifyWatchQueue(sv_key, wq, context);
-      if (wq->items.empty()) {
-        // we erase awakened_keys right after this loop finishes running.
-        wt.queue_map.erase(w_it);
+      context.db_index = index;
+      DbWatchTable& wt = *dbit->second;
+      auto awakened_keys = std::move(wt.awakened_keys);
+      wt.awakened_keys.clear();
+
+      for (const auto& key : awakened_keys) {
+        string_view sv_key = key;
+        DVLOG(1) << "Processing awakened key " << sv_key;
+        auto w_it = wt.queue_map.find(sv_key);
+        if (w_it == wt.queue_map.end()) {
+          // This should not happen because we remove keys from awakened_keys every type we
+          // remove the entry from queue_map. TODO: to make it a CHECK after Dec 2024
+          LOG(ERROR) << "Internal error: Key " << sv_key
+                     << " was not found in the watch queue, wt.awakened_keys len is "
+                     << awakened_keys.size() << " wt.queue_map len is " << wt.queue_map.size();
+          for (const auto& item : awakened_keys) {
+            LOG(ERROR) << "Awakened key: " << item;
+          }
+
+          continue;
+        }
+
+        CHECK(w_it != wt.queue_map.end());
+        DVLOG(1) << "Notify WQ: [" << owner_->shard_id() << "] " << key;
+        WatchQueue* wq = w_it->second.get();
+        NotifyWatchQueue(sv_key, wq, context);
+        if (wq->items.empty()) {
+          wt.awakened_keys.erase(w_it->first);
+          wt.queue_map.erase(w_it);
+        }
       }
-    }
-    wt.awakened_keys.clear();
 
-    if (wt.queue_map.empty()) {
-      watched_dbs_.erase(dbit);
+      if (wt.queue_map.empty()) {
+        watched_dbs_.erase(dbit);
+      }
     }
   }
-  awakened_indices_.clear();
 }
 
 void BlockingController::AddWatched(Keys watch_keys, KeyReadyChecker krc, Transaction* trans) {
@@ -240,7 +267,9 @@ void BlockingController::AwakeWatched(DbIndex db_index, string_view db_key) {
   }
 }
 
-// Marks the queue as active and notifies the first transaction in the queue.
+// Marks the queue as active and notifies the first transaction in the queue. Transactions that
+// can be served on the shard are served right here instead, in queue order and up to
+// blocking_wakeup_batch of them, while the key holds elements.
 void BlockingController::NotifyWatchQueue(std::string_view key, WatchQueue* wq,
                                           const DbContext& context) {
   DCHECK_EQ(wq->state, WatchQueue::SUSPENDED);
@@ -248,6 +277,11 @@ void BlockingController::NotifyWatchQueue(std::string_view key, WatchQueue* wq,
   auto& queue = wq->items;
   ShardId sid = owner_->shard_id();
 
+  // Served transactions write right away, so a paused server only notifies them.
+  unsigned max_served =
+      ServerState::tlocal()->IsPaused() ? 0 : GetFlag(FLAGS_blocking_wakeup_batch);
+  unsigned woken = 0;
+
   // In the most cases we shouldn't have skipped elements at all
   absl::InlinedVector<dfly::WatchItem, 4> skipped;
   while (!queue.empty()) {
@@ -256,13 +290,25 @@ void BlockingController::NotifyWatchQueue(std::string_view key, WatchQueue* wq,
     // We check may the transaction be notified otherwise move it to the end of the queue
     if (wi.key_ready_checker(owner_, context, head, key)) {
       DVLOG(2) << "WQ-Pop " << head->DebugId() << " from key " << key;
-      if (head->NotifySuspended(owner_->committed_txid(), sid, key)) {
-        wq->state = WatchQueue::ACTIVE;
-        // We deliberately keep the notified transaction in the queue to know which queue
-        // must handled when this transaction finished.
-        wq->notify_txid = owner_->committed_txid();
-        awakened_transactions_.insert(head);
-        break;
+      bool served = false;
+      if (head->NotifySuspended(owner_->committed_txid(), sid, key,
+                                woken < max_served ? &served : nullptr)) {
+        ++woken;
+        if (!served) {
+          wq->state = WatchQueue::ACTIVE;
+          // We deliberately keep the notified transaction in the queue to know which queue
+          // must handled when this transaction finished.
+          wq->notify_txid = owner_->committed_txid();
+          wi.notify_ns = absl::GetCurrentTimeNanos();
+          awakened_transactions_.insert(head);
+          break;
+        }
+
+        // The served transaction already concluded and watched only this key.
+        queue.pop_front();
+        if (!IsValid(owner_->db_slice().FindReadOnly(context, key).it))
+          break;
+        continue;
       }
     } else {
       skipped.push_back(std::move(wi));
@@ -270,6 +316,12 @@ void BlockingController::NotifyWatchQueue(std::string_view key, WatchQueue* wq,
 
     queue.pop_front();
   }
+
+  if (woken > 0) {
+    auto& stats = owner_->stats();
+    stats.blocked_wakeup_total += woken;
+    stats.blocked_wakeup_batch_total++;
+  }
   std::move(skipped.begin(), skipped.end(), std::back_inserter(queue));
 }
 
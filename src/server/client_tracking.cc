@@ -0,0 +1,171 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/client_tracking.h"
+
+#include <absl/container/flat_hash_map.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "base/logging.h"
+#include "facade/dragonfly_connection.h"
+#include "server/conn_context.h"
+#include "server/engine_shard_set.h"
+#include "server/server_state.h"
+
+namespace dfly {
+
+using namespace std;
+
+namespace {
+
+atomic_uint32_t bcast_connections{0};
+
+constexpr string_view kInvalidateChannel = "__redis__:invalidate";
+
+}  // namespace
+
+auto TrackingPrefixTable::Node::Child(char c) const -> Node* {
+  auto it = lower_bound(children.begin(), children.end(), c,
+                        [](const auto& child, char ch) { return child.first < ch; });
+  return (it != children.end() && it->first == c) ? it->second.get() : nullptr;
+}
+
+void TrackingPrefixTable::Add(string_view prefix, facade::Connection* conn) {
+  Node* node = &root_;
+  for (char c : prefix) {
+    auto it = lower_bound(node->children.begin(), node->children.end(), c,
+                          [](const auto& child, char ch) { return child.first < ch; });
+    if (it == node->children.end() || it->first != c)
+      it = node->children.emplace(it, c, make_unique<Node>());
+    node = it->second.get();
+  }
+
+  DCHECK(find(node->conns.begin(), node->conns.end(), conn) == node->conns.end());
+  node->conns.push_back(conn);
+  ++size_;
+}
+
+void TrackingPrefixTable::Remove(string_view prefix, facade::Connection* conn) {
+  RemoveImpl(&root_, prefix, conn);
+}
+
+bool TrackingPrefixTable::RemoveImpl(Node* node, string_view prefix, facade::Connection* conn) {
+  if (prefix.empty()) {
+    auto it = find(node->conns.begin(), node->conns.end(), conn);
+    if (it != node->conns.end()) {
+      node->conns.erase(it);
+      --size_;
+    }
+  } else {
+    auto it = lower_bound(node->children.begin(), node->children.end(), prefix[0],
+                          [](const auto& child, char ch) { return child.first < ch; });
+    if (it == node->children.end() || it->first != prefix[0])
+      return false;
+
+    if (RemoveImpl(it->second.get(), prefix.substr(1), conn))
+      node->children.erase(it);
+  }
+  return node->conns.empty() && node->children.empty();
+}
+
+void TrackingPrefixTable::Match(string_view key,
+                                absl::FunctionRef<void(facade::Connection*)> cb) const {
+  const Node* node = &root_;
+  for (size_t i = 0;; ++i) {
+    for (facade::Connection* conn : node->conns)
+      cb(conn);
+
+    if (i == key.size())
+      break;
+
+    node = node->Child(key[i]);
+    if (!node)
+      break;
+  }
+}
+
+void RegisterBroadcastTracking(ConnectionContext* cntx) {
+  auto& table = ServerState::tlocal()->tracking_prefixes();
+  for (const string& prefix : cntx->conn_state.tracking_info_.prefixes())
+    table.Add(prefix, cntx->conn());
+  bcast_connections.fetch_add(1, memory_order_relaxed);
+}
+
+void UnregisterBroadcastTracking(ConnectionContext* cntx) {
+  auto& table = ServerState::tlocal()->tracking_prefixes();
+  for (const string& prefix : cntx->conn_state.tracking_info_.prefixes())
+    table.Remove(prefix, cntx->conn());
+  bcast_connections.fetch_sub(1, memory_order_relaxed);
+}
+
+bool HasBroadcastTracking() {
+  return bcast_connections.load(memory_order_relaxed) > 0;
+}
+
+void InvalidateBroadcastKeys(const vector<BroadcastInvalidation>& keys) {
+  const auto& table = ServerState::tlocal()->tracking_prefixes();
+  if (table.Empty())
+    return;
+
+  // Group the keys by connection, so that every connection gets a single push.
+  absl::flat_hash_map<facade::Connection*, vector<string>> conn_keys;
+  for (const auto& [key, client_id] : keys) {
+    table.Match(key, [&](facade::Connection* conn) {
+      if (client_id != 0 && conn->GetClientId() == client_id) {
+        auto* cntx = static_cast<ConnectionContext*>(conn->cntx());
+        if (cntx && cntx->conn_state.tracking_info_.IsNoLoop())
+          return;
+      }
+      conn_keys[conn].push_back(key);
+    });
+  }
+
+  for (auto& [conn, matched] : conn_keys)
+    SendTrackingInvalidation(conn, std::move(matched));
+}
+
+void UntrackClient(uint32_t client_id) {
+  shard_set->RunBriefInParallel(
+      [client_id](EngineShard* shard) { shard->db_slice().UntrackClient(client_id); });
+}
+
+bool IsInvalidationSubscriber(facade::Connection* conn) {
+  auto* cntx = static_cast<ConnectionContext*>(conn->cntx());
+  if (!cntx || !cntx->conn_state.subscribe_info)
+    return false;
+  return cntx->conn_state.subscribe_info->channels.contains(kInvalidateChannel);
+}
+
+void SendTrackingInvalidation(facade::Connection* conn, vector<string> keys, bool flush) {
+  auto* cntx = static_cast<ConnectionContext*>(conn->cntx());
+  if (!cntx || !cntx->conn_state.tracking_info_.IsTrackingOn())
+    return;
+
+  facade::Connection::InvalidationMessage msg;
+  msg.keys = std::move(keys);
+  msg.invalidate_due_to_flush = flush;
+
+  const auto& redirect = cntx->conn_state.tracking_info_.redirect();
+  if (!redirect) {
+    conn->SendInvalidationMessageAsync(std::move(msg));
+    return;
+  }
+
+  // The redirect target receives the invalidations as messages of __redis__:invalidate channel.
+  // It may have unsubscribed since, in which case it does not expect them anymore.
+  msg.redirected = true;
+  auto send = [ref = *redirect, msg = std::move(msg)]() mutable {
+    if (auto* target = ref.Get(); target && IsInvalidationSubscriber(target))
+      target->SendInvalidationMessageAsync(std::move(msg));
+  };
+
+  if (redirect->Thread() == ServerState::tlocal()->thread_index())
+    send();
+  else if (!redirect->IsExpired())
+    shard_set->pool()->at(redirect->Thread())->DispatchBrief(std::move(send));
+}
+
+}  // namespace dfly
@@ -0,0 +1,92 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <absl/functional/function_ref.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace facade {
+class Connection;
+}
+
+namespace dfly {
+
+class ConnectionContext;
+
+// Thread local registry of connections that use CLIENT TRACKING in broadcasting mode (BCAST).
+// Prefixes are stored in a byte-wise trie, so matching a key visits only the nodes along its
+// path, regardless of how many prefixes are registered. Similarly to MonitorsRepo, every thread
+// holds only its own connections. This is safe because tracking connections are
+// subscribers and therefore never migrate.
+class TrackingPrefixTable {
+ public:
+  // Registers conn for all keys starting with prefix. The empty prefix matches all keys.
+  void Add(std::string_view prefix, facade::Connection* conn);
+
+  void Remove(std::string_view prefix, facade::Connection* conn);
+
+  // Calls cb for every connection registered with a prefix of key.
+  void Match(std::string_view key, absl::FunctionRef<void(facade::Connection*)> cb) const;
+
+  bool Empty() const {
+    return size_ == 0;
+  }
+
+ private:
+  struct Node {
+    Node* Child(char c) const;
+
+    std::vector<std::pair<char, std::unique_ptr<Node>>> children;  // sorted by char
+    std::vector<facade::Connection*> conns;
+  };
+
+  // Returns true if node became empty and can be removed by its parent.
+  bool RemoveImpl(Node* node, std::string_view prefix, facade::Connection* conn);
+
+  Node root_;
+  size_t size_ = 0;
+};
+
+// Registers the connection of cntx in the thread local prefix table with the prefixes of
+// its tracking info.
+void RegisterBroadcastTracking(ConnectionContext* cntx);
+void UnregisterBroadcastTracking(ConnectionContext* cntx);
+
+// Returns true if there is at least one broadcasting connection on any thread.
+// Thread-safe, used by the shards to skip collecting keys that nobody listens to.
+bool HasBroadcastTracking();
+
+// A key modified by a shard and the id of the client that modified it, or 0 if it was not
+// modified by a client (expiry, eviction). NOLOOP clients are not notified about their own writes.
+struct BroadcastInvalidation {
+  std::string key;
+  uint32_t client_id = 0;
+};
+
+// Runs on every proxy thread. Invalidates keys for all matching broadcasting connections
+// of the thread, with a single message per connection.
+void InvalidateBroadcastKeys(const std::vector<BroadcastInvalidation>& keys);
+
+// Removes the tracking state of a non broadcasting client from all shards, once it turns
+// tracking off.
+void UntrackClient(uint32_t client_id);
+
+// Returns true if conn is subscribed to __redis__:invalidate, i.e. it can be a REDIRECT target.
+// Must be called from the thread of conn.
+bool IsInvalidationSubscriber(facade::Connection* conn);
+
+// Sends invalidation of keys to a tracking connection of the current thread, or to its
+// redirect target if it uses REDIRECT. The redirect target must be subscribed to
+// __redis__:invalidate, otherwise the invalidation is dropped. If flush is true, keys are
+// ignored and the client must drop its whole cache.
+void SendTrackingInvalidation(facade::Connection* conn, std::vector<std::string> keys,
+                              bool flush = false);
+
+}  // namespace dfly
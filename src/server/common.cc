@@ -65,6 +65,17 @@ void TEST_InvalidateLockTagOptions() {
       [](ShardId shard, ProactorBase* proactor) { locktag_lock_options = nullopt; });
 }
 
+bool InitHuffmanTable(string_view table) {
+  CHECK(shard_set != nullptr);
+
+  atomic_bool success = true;
+  shard_set->pool()->AwaitBrief([&](unsigned index, ProactorBase* proactor) {
+    if (!CompactObj::InitHuffmanThreadLocal(table))
+      success.store(false, memory_order_relaxed);
+  });
+  return success.load(memory_order_relaxed);
+}
+
 const LockTagOptions& LockTagOptions::instance() {
   if (!locktag_lock_options.has_value()) {
     string delimiter = absl::GetFlag(FLAGS_locktag_delimiter);
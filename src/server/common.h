@@ -133,6 +133,10 @@ extern size_t max_memory_limit;
 // malloc memory stats.
 int64_t GetMallocCurrentCommitted();
 
+// Installs the huffman table used by CompactObj to encode short strings on all proactor threads.
+// Returns false if the table is malformed.
+bool InitHuffmanTable(std::string_view table);
+
 // version 5.11 maps to 511 etc.
 // set upon server start.
 extern unsigned kernel_version;
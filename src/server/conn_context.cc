@@ -303,7 +303,8 @@ void ConnectionState::ExecInfo::ClearWatched() {
 }
 
 bool ConnectionState::ClientTracking::ShouldTrackKeys() const {
-  if (!IsTrackingOn()) {
+  // In broadcasting mode the keys are matched by prefix on invalidation.
+  if (!IsTrackingOn() || bcast_) {
     return false;
   }
 
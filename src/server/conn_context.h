@@ -10,6 +10,7 @@
 #include "acl/acl_commands_def.h"
 #include "facade/acl_commands_def.h"
 #include "facade/conn_context.h"
+#include "facade/dragonfly_connection.h"
 #include "facade/reply_capture.h"
 #include "server/common.h"
 #include "server/tx_base.h"
@@ -215,6 +216,35 @@ struct ConnectionState {
       noloop_ = noloop;
     }
 
+    bool IsNoLoop() const {
+      return noloop_;
+    }
+
+    // Broadcasting mode (BCAST): instead of remembering the keys that were read, the client is
+    // notified about every modified key that starts with one of the prefixes. No prefixes
+    // means all keys.
+    void SetBroadcast(bool bcast, std::vector<std::string> prefixes) {
+      bcast_ = bcast;
+      prefixes_ = bcast && prefixes.empty() ? std::vector<std::string>{""} : std::move(prefixes);
+    }
+
+    bool IsBroadcast() const {
+      return bcast_;
+    }
+
+    const std::vector<std::string>& prefixes() const {
+      return prefixes_;
+    }
+
+    // REDIRECT: invalidations are delivered to another connection.
+    void SetRedirect(std::optional<facade::Connection::WeakRef> redirect) {
+      redirect_ = std::move(redirect);
+    }
+
+    const std::optional<facade::Connection::WeakRef>& redirect() const {
+      return redirect_;
+    }
+
     // Check if the keys should be tracked. Result adheres to the state machine described above.
     bool ShouldTrackKeys() const;
 
@@ -241,7 +271,10 @@ struct ConnectionState {
     // a flag indicating whether the client has turned on client tracking.
     bool tracking_enabled_ = false;
     bool noloop_ = false;
+    bool bcast_ = false;
     Options option_ = NONE;
+    std::vector<std::string> prefixes_;
+    std::optional<facade::Connection::WeakRef> redirect_;
     // sequence number
     size_t seq_num_ = 0;
     size_t caching_seq_num_ = 0;
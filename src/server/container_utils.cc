@@ -3,8 +3,11 @@
 //
 #include "server/container_utils.h"
 
+#include <absl/strings/str_cat.h>
+
 #include "base/flags.h"
 #include "base/logging.h"
+#include "core/ring_list.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
 #include "core/string_set.h"
@@ -23,8 +26,23 @@ extern "C" {
 
 ABSL_FLAG(bool, singlehop_blocking, true, "Use single hop optimization for blocking commands");
 
+ABSL_FLAG(uint32_t, cmd_slice_quantum_usec, 1000,
+          "Reads of big containers by LRANGE, HGETALL, HKEYS, HVALS and SMEMBERS are split into "
+          "slices of at most this time. Other transactions run on the shard between the slices "
+          "and the elements of a slice are sent while the next one is read. 0 disables it");
+
+ABSL_FLAG(uint32_t, cmd_slice_max_bytes, 1 << 20,
+          "Maximal size of the serialized elements of a slice of a big container read. Bounds the "
+          "memory a read holds for a slow client");
+
+ABSL_FLAG(uint32_t, cmd_slice_write_wait_usec, 1000,
+          "Maximal time a slice of a big container read waits for the socket write of the "
+          "previous slice while the key is locked. Once exceeded, the rest of the key is read at "
+          "once and the lock is released before the client gets it");
+
 namespace dfly::container_utils {
 using namespace std;
+using namespace util;
 namespace {
 
 struct ShardFFResult {
@@ -150,6 +168,20 @@ quicklistEntry QLEntry() {
 }
 
 bool IterateList(const PrimeValue& pv, const IterateFunc& func, long start, long end) {
+  if (pv.Encoding() == kEncodingRingList) {
+    const RingList* rl = static_cast<const RingList*>(pv.RObjPtr());
+    long llen = rl->Size();
+    if (end < 0 || end >= llen)
+      end = llen - 1;
+
+    for (long i = start; i <= end; ++i) {
+      string_view sv = rl->At(i);
+      if (!func(ContainerEntry{sv.data(), sv.size()}))
+        return false;
+    }
+    return true;
+  }
+
   quicklist* ql = static_cast<quicklist*>(pv.RObjPtr());
   long llen = quicklistCount(ql);
   if (end < 0 || end >= llen)
@@ -342,11 +374,23 @@ OpResult<string> RunCbOnFirstNonEmptyBlocking(Transaction* trans, int req_obj_ty
     return owner->db_slice().FindReadOnly(context, key, req_obj_type).ok();
   };
 
-  auto status = trans->WaitOnWatch(limit_tp, std::move(wcb), key_checker, block_flag, pause_flag);
+  // A single key can be served by the shard that wakes us, so that the waiters of a key get
+  // its elements in the order they blocked.
+  bool single_key = trans->GetUniqueShardCnt() == 1 &&
+                    trans->GetShardArgs(trans->GetUniqueShard()).Size() == 1;
+  auto status = trans->WaitOnWatch(limit_tp, std::move(wcb), key_checker, block_flag, pause_flag,
+                                   single_key ? &func : nullptr);
 
   if (status != OpStatus::OK)
     return status;
 
+  if (!trans->IsScheduled()) {
+    result_key = *trans->GetWakeKey(trans->GetUniqueShard());
+    if (info)
+      *info = "SERVED/";
+    return result_key;
+  }
+
   auto cb = [&](Transaction* t, EngineShard* shard) {
     if (auto wake_key = t->GetWakeKey(shard->shard_id()); wake_key) {
       result_key = *wake_key;
@@ -370,4 +414,150 @@ OpResult<string> RunCbOnFirstNonEmptyBlocking(Transaction* trans, int req_obj_ty
   return result_key;
 }
 
+ReadSlice::ReadSlice(uint64_t cursor, bool streamed) : cursor(cursor), streamed_(streamed) {
+  uint32_t quantum_usec = absl::GetFlag(FLAGS_cmd_slice_quantum_usec);
+  if (streamed && quantum_usec > 0) {
+    deadline_ns_ = absl::GetCurrentTimeNanos() + uint64_t(quantum_usec) * 1000;
+    max_bytes_ = absl::GetFlag(FLAGS_cmd_slice_max_bytes);
+  } else {
+    DisableSlicing();
+  }
+}
+
+void ReadSlice::Add(string_view item) {
+  ++count_;
+  if (!streamed_) {
+    items_.emplace_back(item);
+    return;
+  }
+
+  // Bulk strings have the same encoding in RESP2 and RESP3.
+  absl::StrAppend(&serialized_, "$", item.size(), "\r\n", item, "\r\n");
+}
+
+void ReadSlice::Add(ContainerEntry entry) {
+  if (entry.value)
+    return Add(string_view{entry.value, entry.length});
+
+  char buf[absl::numbers_internal::kFastToBufferSize];
+  char* end = absl::numbers_internal::FastIntToBuffer(entry.longval, buf);
+  Add(string_view{buf, size_t(end - buf)});
+}
+
+bool ReadSlice::Exhausted() {
+  if (serialized_.size() >= max_bytes_)
+    return true;
+
+  // Reading the clock for every element would dominate the cost of small elements.
+  constexpr unsigned kCheckPeriod = 64;
+  if (deadline_ns_ == UINT64_MAX || ++calls_ % kCheckPeriod != 0)
+    return false;
+  return uint64_t(absl::GetCurrentTimeNanos()) >= deadline_ns_;
+}
+
+OpStatus ScheduleSlicedRead(Transaction* trans, const SliceReadCb& cb,
+                            facade::RedisReplyBuilder* rb,
+                            facade::RedisReplyBuilder::CollectionType type) {
+  // Only a single shard transaction can avoid concluding, multi transactions and the squashed
+  // commands, that reply through a capturing builder, read everything at once.
+  bool sliced = !trans->IsMulti() && trans->GetUniqueShardCnt() == 1;
+
+  optional<ReadSlice> slice;
+  OpStatus status = OpStatus::OK;
+  bool read_rest = false;
+  auto hop_cb = [&](Transaction* t, EngineShard* shard) -> Transaction::RunnableResult {
+    uint64_t cursor = slice ? slice->cursor : 0;
+    slice.emplace(cursor, sliced);
+    if (read_rest)
+      slice->DisableSlicing();
+    status = cb(t->GetOpArgs(shard), &*slice);
+    if (status == OpStatus::OK && !slice->done)
+      return {OpStatus::OK, Transaction::RunnableResult::AVOID_CONCLUDING};
+    return status;
+  };
+
+  trans->ScheduleSingleHop(hop_cb);
+  if (status != OpStatus::OK)
+    return status;
+
+  if (!sliced) {
+    DCHECK(slice->done);
+    rb->SendStringArr(absl::Span<const string>{slice->items()}, type);
+    return OpStatus::OK;
+  }
+
+  size_t total = slice->total;
+  size_t sent = 0;
+  unsigned len = type == facade::RedisReplyBuilder::MAP ? total / 2 : total;
+  if (slice->done) {
+    rb->StartCollection(len, type);
+    rb->SendSerialized(slice->serialized());
+    DCHECK_EQ(slice->size(), total);
+    return OpStatus::OK;
+  }
+
+  // The transaction keeps the key locked and the head of the shard queue between the hops, so
+  // the slices are written by a separate fiber and a hop never waits for the socket.
+  auto wait_usec = chrono::microseconds(absl::GetFlag(FLAGS_cmd_slice_write_wait_usec));
+  vector<string> pending;
+  fb2::Done written;
+  fb2::Fiber writer;
+  auto take_slice = [&] {
+    pending.push_back(slice->TakeSerialized());
+    sent += slice->size();
+  };
+  auto write = [&](bool header) {
+    written.Reset();
+    writer = fb2::Fiber("sliced_read_write", [&, header, parts = std::move(pending)] {
+      if (header)
+        rb->StartCollection(len, type);
+      for (const string& part : parts) {
+        if (!part.empty())
+          rb->SendSerialized(part);
+      }
+      written.Notify();
+    });
+    pending.clear();
+  };
+
+  take_slice();
+  write(true);
+  while (!slice->done) {
+    VLOG(2) << "Sliced read sent " << sent << " out of " << total;
+    trans->Execute(hop_cb, true);
+
+    // The key is locked and can not change between the slices.
+    if (status != OpStatus::OK) {
+      LOG(DFATAL) << "Sliced read failed with " << status;
+      break;
+    }
+
+    if (!slice->done && !written.WaitFor(wait_usec)) {
+      // The client does not keep up. Read the rest at once, so the key is not locked while the
+      // socket drains.
+      VLOG(1) << "Sliced read of " << total << " elements waits for the socket, reading the rest";
+      take_slice();
+      read_rest = true;
+      trans->Execute(hop_cb, true);
+      if (status != OpStatus::OK) {
+        LOG(DFATAL) << "Sliced read failed with " << status;
+        break;
+      }
+      DCHECK(slice->done);
+    }
+
+    take_slice();
+    writer.Join();
+    write(false);
+  }
+
+  // The last hop concluded, so the rest of the reply is written without holding the key.
+  writer.Join();
+
+  DCHECK_EQ(sent, total);
+  for (; sent < total; ++sent)
+    rb->SendNull();
+  return OpStatus::OK;
+}
+
 }  // namespace dfly::container_utils
@@ -5,6 +5,7 @@
 
 #include "base/logging.h"
 #include "core/compact_object.h"
+#include "facade/reply_builder.h"
 #include "server/table.h"
 
 extern "C" {
@@ -92,6 +93,76 @@ OpResult<std::string> RunCbOnFirstNonEmptyBlocking(Transaction* trans, int req_o
                                                    bool* block_flag, bool* pause_flag,
                                                    std::string* info = nullptr);
 
+// One slice of a sliced read, i.e. the elements a shard callback reads in one hop. The slice
+// is bounded by cmd_slice_quantum_usec and cmd_slice_max_bytes. Once either is exhausted, the
+// callback stops and the read continues in the next hop. The key stays locked in between,
+// while other transactions run on the shard.
+class ReadSlice {
+ public:
+  // A streamed slice serializes its elements as RESP bulk strings on the shard, so they are
+  // written to the socket without being copied again. Otherwise the elements are kept as
+  // strings for the reply builder and the slice is never exhausted.
+  ReadSlice(uint64_t cursor, bool streamed);
+
+  void Add(std::string_view item);
+  void Add(ContainerEntry entry);
+
+  // Returns true if the callback should stop reading. Called for every element or bucket read.
+  bool Exhausted();
+
+  // Called for objects that can not be read across hops, e.g. keys with expiry that a reader
+  // on another connection may delete between the hops.
+  void DisableSlicing() {
+    deadline_ns_ = UINT64_MAX;
+    max_bytes_ = SIZE_MAX;
+  }
+
+  size_t size() const {
+    return count_;
+  }
+
+  const StringVec& items() const {
+    return items_;
+  }
+
+  std::string_view serialized() const {
+    return serialized_;
+  }
+
+  // Moves the serialized elements out, so they can be written while the next slice is read.
+  std::string TakeSerialized() {
+    return std::move(serialized_);
+  }
+
+  size_t total = 0;     // number of elements of the whole reply, set by the first slice
+  uint64_t cursor = 0;  // position of the slice, opaque to the caller and 0 for the first one
+  bool done = true;
+
+ private:
+  bool streamed_;
+  unsigned calls_ = 0;
+  size_t count_ = 0;
+  uint64_t deadline_ns_;
+  size_t max_bytes_;
+  StringVec items_;
+  std::string serialized_;
+};
+
+// Reads from slice->cursor until the slice is exhausted, and sets the cursor of the next slice.
+using SliceReadCb = std::function<OpStatus(const OpArgs&, ReadSlice* slice)>;
+
+// Runs a single key read in slices, one hop each, and streams the elements of every slice to
+// the client as a collection of the total size reported by the first slice. A slice is written
+// by a separate fiber while the next one is read, and no slice is read before the previous
+// write finished, so a client that keeps up holds at most two slices in memory. The hop never
+// waits for the socket longer than cmd_slice_write_wait_usec. If the client does not keep up,
+// the rest of the key is read in one concluding hop and written after the key is unlocked.
+// Multi transactions read in a single slice. Returns the status of the first slice if it
+// failed, in which case nothing was sent.
+OpStatus ScheduleSlicedRead(Transaction* trans, const SliceReadCb& cb,
+                            facade::RedisReplyBuilder* rb,
+                            facade::RedisReplyBuilder::CollectionType type);
+
 };  // namespace container_utils
 
 }  // namespace dfly
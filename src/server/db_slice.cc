@@ -8,12 +8,16 @@
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "core/string_map.h"
+#include "core/string_set.h"
 #include "generic_family.h"
 #include "server/channel_store.h"
+#include "server/client_tracking.h"
 #include "server/cluster/cluster_defs.h"
 #include "server/engine_shard_set.h"
 #include "server/error.h"
 #include "server/journal/journal.h"
+#include "server/search/doc_index.h"
 #include "server/server_state.h"
 #include "server/tiered_storage.h"
 #include "strings/human_readable.h"
@@ -37,6 +41,14 @@ ABSL_FLAG(double, table_growth_margin, 0.4,
 ABSL_FLAG(std::string, notify_keyspace_events, "",
           "notify-keyspace-events. Only Ex is supported for now");
 
+ABSL_FLAG(dfly::MemoryBytesFlag, tracking_table_max_bytes, dfly::MemoryBytesFlag{256u << 20},
+          "Maximum memory of the table that tracks keys exactly for client side caching, "
+          "divided between the shards. Keys beyond the limit are tracked by hash buckets, "
+          "which may cause false positive invalidations. 0 - unlimited.");
+
+ABSL_FLAG(uint32_t, tracking_table_buckets, 4096,
+          "Number of hash buckets per shard for keys that do not fit into the tracking table.");
+
 namespace dfly {
 
 using namespace std;
@@ -57,6 +69,17 @@ static_assert(kPrimeSegmentSize == 32288);
 // 24576
 static_assert(kExpireSegmentSize == 23528);
 
+// Returns the dense set of hashes and sets that can hold members with ttl, nullptr otherwise.
+DenseSet* GetDenseSet(const PrimeValue& pv) {
+  if (pv.Encoding() != kEncodingStrMap2)
+    return nullptr;
+  if (pv.ObjType() == OBJ_HASH)
+    return static_cast<StringMap*>(pv.RObjPtr());
+  if (pv.ObjType() == OBJ_SET)
+    return static_cast<StringSet*>(pv.RObjPtr());
+  return nullptr;
+}
+
 void AccountObjectMemory(string_view key, unsigned type, int64_t size, DbTable* db) {
   DCHECK_NE(db, nullptr);
   DbTableStats& stats = db->stats;
@@ -220,6 +243,12 @@ unsigned PrimeEvictionPolicy::Evict(const PrimeTable::HotspotBuckets& eb, PrimeT
   return 1;
 }
 
+// Approximate memory of a tracking table entry, the key and its set of clients.
+size_t TrackedKeyBytes(string_view key, size_t num_clients) {
+  return sizeof(string) + key.size() + sizeof(absl::flat_hash_set<uint32_t>) +
+         num_clients * sizeof(facade::Connection::WeakRef);
+}
+
 }  // namespace
 
 #define ADD(x) (x) += o.x
@@ -239,11 +268,12 @@ DbStats& DbStats::operator+=(const DbStats& o) {
 }
 
 SliceEvents& SliceEvents::operator+=(const SliceEvents& o) {
-  static_assert(sizeof(SliceEvents) == 112, "You should update this function with new fields");
+  static_assert(sizeof(SliceEvents) == 120, "You should update this function with new fields");
 
   ADD(evicted_keys);
   ADD(hard_evictions);
   ADD(expired_keys);
+  ADD(expired_members);
   ADD(garbage_collected);
   ADD(stash_unloaded);
   ADD(bumpups);
@@ -269,7 +299,7 @@ DbSlice::DbSlice(uint32_t index, bool caching_mode, EngineShard* owner)
   db_arr_.emplace_back();
   CreateDb(0);
   expire_base_[0] = expire_base_[1] = 0;
-  soft_budget_limit_ = (0.3 * max_memory_limit / shard_set->size());
+  soft_budget_limit_ = (kSoftBudgetFactor * max_memory_limit / shard_set->size());
 
   std::string keyspace_events = GetFlag(FLAGS_notify_keyspace_events);
   if (!keyspace_events.empty() && keyspace_events != "Ex") {
@@ -306,7 +336,10 @@ auto DbSlice::GetStats() const -> Stats {
     stats.expire_count = db_wrap.expire.size();
     stats.table_mem_usage = (db_wrap.prime.mem_usage() + db_wrap.expire.mem_usage());
   }
-  s.small_string_bytes = CompactObj::GetStats().small_string_bytes;
+  auto cobj_stats = CompactObj::GetStats();
+  s.small_string_bytes = cobj_stats.small_string_bytes;
+  s.huff_encode_total = cobj_stats.huff_encode_total;
+  s.huff_encode_success = cobj_stats.huff_encode_success;
 
   return s;
 }
@@ -316,13 +349,15 @@ SlotStats DbSlice::GetSlotStats(cluster::SlotId sid) const {
   return db_arr_[0]->slots_stats[sid];
 }
 
-void DbSlice::Reserve(DbIndex db_ind, size_t key_size) {
+void DbSlice::Reserve(DbIndex db_ind, size_t key_size, size_t expire_size) {
   ActivateDb(db_ind);
 
   auto& db = db_arr_[db_ind];
   DCHECK(db);
 
   db->prime.Reserve(key_size);
+  if (expire_size > 0)
+    db->expire.Reserve(expire_size);
 }
 
 DbSlice::AutoUpdater::AutoUpdater() {
@@ -743,6 +778,8 @@ void DbSlice::FlushDbIndexes(const std::vector<DbIndex>& indexes) {
 void DbSlice::FlushDb(DbIndex db_ind) {
   // clear client tracking map.
   client_tracking_map_.clear();
+  client_tracking_bytes_ = 0;
+  client_tracking_buckets_.clear();
 
   if (db_ind != kDbAll) {
     // Flush a single database if a specific index is provided
@@ -1186,6 +1223,100 @@ auto DbSlice::DeleteExpiredStep(const Context& cntx, unsigned count) -> DeleteEx
   return result;
 }
 
+void DbSlice::TrackMemberExpiry(DbIndex db_ind, string_view key, const PrimeValue& pv) {
+  DenseSet* ds = GetDenseSet(pv);
+  uint32_t next_expiry = ds ? ds->NextExpiry() : UINT32_MAX;
+  if (next_expiry == UINT32_MAX)
+    return;
+
+  auto& db = *db_arr_[db_ind];
+  auto [it, added] = db.member_expiry_keys.try_emplace(key, next_expiry);
+  if (!added) {
+    if (it->second <= next_expiry)
+      return;
+    it->second = next_expiry;
+  }
+  db.member_expiry_heap.emplace(next_expiry, key);
+}
+
+uint32_t DbSlice::DeleteExpiredMembersStep(const Context& cntx, unsigned count) {
+  // Unlike keys, member deletions are not replicated. Replicas sweep on their own clock, which
+  // reads on them use anyway to skip expired members.
+  if (!expire_allowed_)
+    return 0;
+
+  auto& db = *db_arr_[cntx.db_index];
+  auto& heap = db.member_expiry_heap;
+  uint32_t now_sec = MemberTimeSeconds(cntx.time_now_ms);
+  uint32_t deleted = 0;
+  vector<DbTable::MemberExpiryRecord> locked;
+
+  // Only containers with due members are visited, in order of their next expiry
+  while (count > 0 && !heap.empty() && heap.top().first <= now_sec) {
+    DbTable::MemberExpiryRecord record = heap.top();
+    heap.pop();
+    const string& key = record.second;
+
+    auto kit = db.member_expiry_keys.find(key);
+    if (kit == db.member_expiry_keys.end() || kit->second != record.first)
+      continue;  // stale record
+
+    // Locked keys are retried on a later step, their transactions may hold iterators
+    if (!CheckLock(IntentLock::EXCLUSIVE, cntx.db_index, key)) {
+      locked.push_back(std::move(record));
+      continue;
+    }
+
+    auto res = FindMutable(cntx, key);
+    DenseSet* ds = IsValid(res.it) ? GetDenseSet(res.it->second) : nullptr;
+    if (!ds || ds->NextExpiry() == UINT32_MAX) {
+      res.post_updater.Cancel();
+      db.member_expiry_keys.erase(kit);
+      continue;
+    }
+
+    PrimeValue& pv = res.it->second;
+    bool is_hash = pv.ObjType() == OBJ_HASH;
+    if (is_hash)
+      owner_->search_indices()->RemoveDoc(key, cntx, pv);
+
+    size_t prev_size = ds->UpperBoundSize();
+    ds->set_time(now_sec);
+    count -= min(count, max(ds->ExpireDue(count), 1u));
+    deleted += prev_size - ds->UpperBoundSize();
+
+    res.post_updater.Run();
+
+    // Deletion of the key below removes the document again
+    if (is_hash)
+      owner_->search_indices()->AddDoc(key, cntx, pv);
+
+    if (ds->Empty()) {
+      // The container expired as a whole, replicate its deletion like a key expiry
+      if (auto journal = owner_->journal(); journal)
+        RecordExpiry(cntx.db_index, key);
+      Del(cntx.db_index, res.it);
+      db.member_expiry_keys.erase(kit);
+      continue;
+    }
+
+    // Reschedule by the next expiry, it is still due if the sweep was cut by the budget
+    uint32_t next_expiry = ds->NextExpiry();
+    if (next_expiry == UINT32_MAX) {
+      db.member_expiry_keys.erase(kit);
+    } else {
+      kit->second = next_expiry;
+      heap.emplace(next_expiry, std::move(record.second));
+    }
+  }
+
+  for (auto& record : locked)
+    heap.push(std::move(record));
+
+  events_.expired_members += deleted;
+  return deleted;
+}
+
 int32_t DbSlice::GetNextSegmentForEviction(int32_t segment_id, DbIndex db_ind) const {
   // wraps around if we reached the end
   return db_arr_[db_ind]->prime.NextSeg((size_t)segment_id) %
@@ -1280,7 +1411,7 @@ finish:
 void DbSlice::CreateDb(DbIndex db_ind) {
   auto& db = db_arr_[db_ind];
   if (!db) {
-    db.reset(new DbTable{owner_->memory_resource(), db_ind});
+    db.reset(new DbTable{owner_->table_memory_resource(), db_ind});
   }
 }
 
@@ -1444,34 +1575,88 @@ void DbSlice::ResetEvents() {
   events_ = {};
 }
 
+void DbSlice::TrackKey(const facade::Connection::WeakRef& conn_ref, std::string_view key) {
+  uint64_t max_bytes = GetFlag(FLAGS_tracking_table_max_bytes).value;
+  auto it = client_tracking_map_.find(key);
+  if (it != client_tracking_map_.end()) {
+    if (it->second.insert(conn_ref).second)
+      client_tracking_bytes_ += sizeof(conn_ref);
+    return;
+  }
+
+  if (max_bytes == 0 || client_tracking_bytes_ < max_bytes / shard_set->size()) {
+    client_tracking_map_[key].insert(conn_ref);
+    client_tracking_bytes_ += TrackedKeyBytes(key, 1);
+    return;
+  }
+
+  if (client_tracking_buckets_.empty()) {
+    unsigned num_buckets = std::max(GetFlag(FLAGS_tracking_table_buckets), 1u);
+    client_tracking_buckets_.reserve(num_buckets);
+    for (unsigned i = 0; i < num_buckets; ++i)
+      client_tracking_buckets_.emplace_back(HashSetAllocator{owner_->memory_resource()});
+  }
+
+  size_t bucket = absl::Hash<string_view>{}(key) % client_tracking_buckets_.size();
+  client_tracking_buckets_[bucket].insert(conn_ref);
+}
+
 void DbSlice::SendInvalidationTrackingMessage(std::string_view key) {
-  if (client_tracking_map_.empty())
+  if (HasBroadcastTracking())
+    bcast_invalidations_.push_back({string(key), noloop_client_id_});
+
+  if (client_tracking_map_.empty() && client_tracking_buckets_.empty())
     return;
 
+  vector<facade::Connection::WeakRef> clients;
   auto it = client_tracking_map_.find(key);
-  if (it == client_tracking_map_.end()) {
-    return;
+  if (it != client_tracking_map_.end()) {
+    clients.assign(it->second.begin(), it->second.end());
+  }
+
+  // The key may have been read by any client of its bucket. They are invalidated for this key
+  // only and stay in the bucket, since they may have cached other keys of the bucket as well.
+  if (!client_tracking_buckets_.empty()) {
+    size_t index = absl::Hash<string_view>{}(key) % client_tracking_buckets_.size();
+    auto& bucket = client_tracking_buckets_[index];
+    absl::erase_if(bucket, [](const auto& ref) { return ref.IsExpired(); });
+    for (const auto& ref : bucket) {
+      if (it == client_tracking_map_.end() || !it->second.contains(ref))
+        clients.push_back(ref);
+    }
+  }
+
+  if (it != client_tracking_map_.end()) {
+    // remove this key from the tracking table as the key no longer exists
+    client_tracking_bytes_ -= TrackedKeyBytes(it->first, it->second.size());
+    client_tracking_map_.erase(it);
   }
-  auto& client_set = it->second;
+
+  if (clients.empty())
+    return;
+
   // Notify all the clients. We copy key because we dispatch briefly below and
   // we need to preserve its lifetime
   // TODO this key is further copied within DispatchFiber. Fix this.
-  auto cb = [key = std::string(key), client_set = std::move(client_set)](unsigned idx,
-                                                                         util::ProactorBase*) {
-    for (auto& client : client_set) {
+  auto cb = [key = std::string(key), clients = std::move(clients)](unsigned idx,
+                                                                   util::ProactorBase*) {
+    for (auto& client : clients) {
       if (client.IsExpired() || (client.Thread() != idx)) {
         continue;
       }
-      auto* conn = client.Get();
-      auto* cntx = static_cast<ConnectionContext*>(conn->cntx());
-      if (cntx && cntx->conn_state.tracking_info_.IsTrackingOn()) {
-        conn->SendInvalidationMessageAsync({key});
-      }
+      if (auto* conn = client.Get(); conn)
+        SendTrackingInvalidation(conn, {key});
     }
   };
   shard_set->pool()->DispatchBrief(std::move(cb));
-  // remove this key from the tracking table as the key no longer exists
-  client_tracking_map_.erase(key);
+}
+
+void DbSlice::UntrackClient(uint32_t client_id) {
+  for (auto& bucket : client_tracking_buckets_) {
+    absl::erase_if(bucket, [client_id](const auto& ref) {
+      return ref.IsExpired() || ref.GetClientId() == client_id;
+    });
+  }
 }
 
 void DbSlice::PerformDeletion(PrimeIterator del_it, DbTable* table) {
@@ -1531,6 +1716,18 @@ void DbSlice::OnCbFinish() {
   // TBD update bumpups logic we can not clear now after cb finish as cb can preempt
   // btw what do we do with inline?
   fetched_items_.clear();
+  FlushBroadcastInvalidations();
+  noloop_client_id_ = 0;
+}
+
+void DbSlice::FlushBroadcastInvalidations() {
+  if (bcast_invalidations_.empty())
+    return;
+
+  auto keys = make_shared<vector<BroadcastInvalidation>>(std::move(bcast_invalidations_));
+  bcast_invalidations_.clear();
+  shard_set->pool()->DispatchBrief(
+      [keys](unsigned, util::ProactorBase*) { InvalidateBroadcastKeys(*keys); });
 }
 
 void DbSlice::CallChangeCallbacks(DbIndex id, const ChangeReq& cr) const {
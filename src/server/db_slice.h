@@ -8,6 +8,7 @@
 #include "core/string_or_view.h"
 #include "facade/dragonfly_connection.h"
 #include "facade/op_status.h"
+#include "server/client_tracking.h"
 #include "server/cluster/slot_set.h"
 #include "server/common.h"
 #include "server/conn_context.h"
@@ -44,6 +45,7 @@ struct SliceEvents {
   // evictions that were performed when we have a negative memory budget.
   size_t hard_evictions = 0;
   size_t expired_keys = 0;
+  size_t expired_members = 0;  // hash fields and set members deleted by the member expiry sweep
   size_t garbage_checked = 0;
   size_t garbage_collected = 0;
   size_t stash_unloaded = 0;
@@ -179,6 +181,7 @@ class DbSlice {
     std::vector<DbStats> db_stats;
     SliceEvents events;
     size_t small_string_bytes = 0;
+    uint64_t huff_encode_total = 0, huff_encode_success = 0;
   };
 
   using Context = DbContext;
@@ -222,8 +225,9 @@ class DbSlice {
   DbSlice(uint32_t index, bool caching_mode, EngineShard* owner);
   ~DbSlice();
 
-  // Activates `db_ind` database if it does not exist (see ActivateDb below).
-  void Reserve(DbIndex db_ind, size_t key_size);
+  // Activates `db_ind` database if it does not exist (see ActivateDb below) and allocates its
+  // tables to hold key_size keys, expire_size of them with expiry, without splitting.
+  void Reserve(DbIndex db_ind, size_t key_size, size_t expire_size = 0);
 
   // Returns statistics for the whole db slice. A bit heavy operation.
   Stats GetStats() const;
@@ -236,10 +240,11 @@ class DbSlice {
   }
 
   // From time to time DbSlice is set with a new set of params needed to estimate its
-  // memory usage.
-  void SetCachedParams(int64_t budget, size_t bytes_per_object) {
+  // memory usage. memory_limit is the part of max_memory_limit assigned to the shard.
+  void SetCachedParams(int64_t budget, size_t bytes_per_object, size_t memory_limit) {
     memory_budget_ = budget;
     bytes_per_object_ = bytes_per_object;
+    soft_budget_limit_ = kSoftBudgetFactor * memory_limit;
   }
 
   ssize_t memory_budget() const {
@@ -349,6 +354,16 @@ class DbSlice {
 
   void OnCbFinish();
 
+  // Id of the client whose callback runs on the shard, recorded with the keys it modifies for
+  // the broadcasting tracking clients. Set only for NOLOOP clients, 0 otherwise.
+  void SetNoLoopClientId(uint32_t client_id) {
+    noloop_client_id_ = client_id;
+  }
+
+  // Sends the keys that were modified since the last call to the broadcasting tracking clients.
+  // Called after every callback, so each hop results in a single dispatch.
+  void FlushBroadcastInvalidations();
+
   bool Acquire(IntentLock::Mode m, const KeyLockArgs& lock_args);
   void Release(IntentLock::Mode m, const KeyLockArgs& lock_args);
 
@@ -424,6 +439,13 @@ class DbSlice {
 
   // Deletes some amount of possible expired items.
   DeleteExpiredStats DeleteExpiredStep(const Context& cntx, unsigned count);
+
+  // Registers a hash or a set for the member expiry sweep if some of its members have ttl.
+  void TrackMemberExpiry(DbIndex db_ind, std::string_view key, const PrimeValue& pv);
+
+  // Deletes expired members of tracked hashes and sets with due members, visiting up to `count`
+  // of their buckets. Returns the number of deleted members.
+  uint32_t DeleteExpiredMembersStep(const Context& cntx, unsigned count);
   void FreeMemWithEvictionStep(DbIndex db_indx, size_t increase_goal_bytes);
   void ScheduleForOffloadStep(DbIndex db_indx, size_t increase_goal_bytes);
 
@@ -461,9 +483,13 @@ class DbSlice {
   }
 
   // Track keys for the client represented by the the weak reference to its connection.
-  void TrackKey(const facade::Connection::WeakRef& conn_ref, std::string_view key) {
-    client_tracking_map_[key].insert(conn_ref);
-  }
+  // Keys beyond the size limit of the tracking table are tracked approximately, see
+  // client_tracking_buckets_.
+  void TrackKey(const facade::Connection::WeakRef& conn_ref, std::string_view key);
+
+  // Removes the client from the tracking buckets once it turns tracking off. Disconnected
+  // clients are removed lazily, once their bucket is invalidated.
+  void UntrackClient(uint32_t client_id);
 
   // Delete a key referred by its iterator.
   void PerformDeletion(Iterator del_it, DbTable* table);
@@ -534,6 +560,9 @@ class DbSlice {
   void CallChangeCallbacks(DbIndex id, const ChangeReq& cr) const;
 
  private:
+  // Part of the shard memory limit below which the table growth is checked conservatively.
+  static constexpr double kSoftBudgetFactor = 0.3;
+
   ShardId shard_id_;
   uint8_t caching_mode_ : 1;
 
@@ -566,6 +595,10 @@ class DbSlice {
   // Used in temporary computations in Find item and CbFinish
   mutable absl::flat_hash_set<CompactObjectView> fetched_items_;
 
+  // Modified keys pending for the broadcasting tracking clients (CLIENT TRACKING BCAST).
+  std::vector<BroadcastInvalidation> bcast_invalidations_;
+  uint32_t noloop_client_id_ = 0;
+
   // Registered by shard indices on when first document index is created.
   DocDeletionCallback doc_del_cb_;
 
@@ -597,6 +630,15 @@ class DbSlice {
                       absl::container_internal::hash_default_hash<std::string>,
                       absl::container_internal::hash_default_eq<std::string>, AllocatorType>
       client_tracking_map_;
+
+  // Approximate memory used by client_tracking_map_, bounded by tracking_table_max_bytes.
+  size_t client_tracking_bytes_ = 0;
+
+  // Once client_tracking_map_ reaches its limit, keys are tracked by hash buckets that hold
+  // only the clients. A change of a key is sent to all the clients of its bucket, which yields
+  // false positive invalidations but never misses one. The clients stay in the bucket, since
+  // they may have cached other keys of it. Allocated on first overflow.
+  std::vector<ConnectionHashSet> client_tracking_buckets_;
 };
 
 inline bool IsValid(const DbSlice::Iterator& it) {
@@ -9,6 +9,7 @@ extern "C" {
 
 #include <absl/cleanup/cleanup.h>
 #include <absl/random/random.h>
+#include <absl/strings/escaping.h>
 #include <absl/strings/str_cat.h>
 #include <zstd.h>
 
@@ -16,6 +17,7 @@ extern "C" {
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "core/huff_coder.h"
 #include "core/string_map.h"
 #include "server/blocking_controller.h"
 #include "server/container_utils.h"
@@ -288,6 +290,52 @@ void DoBuildObjHist(EngineShard* shard, ObjHistMap* obj_hist_map) {
   }
 }
 
+struct ByteHist {
+  unsigned hist[256] = {0};
+  size_t num_samples = 0;
+
+  void Add(string_view str) {
+    for (uint8_t c : str)
+      hist[c]++;
+    num_samples++;
+  }
+};
+
+// Samples keys and short string values of the shard.
+void DoBuildByteHist(EngineShard* shard, size_t max_samples, ByteHist* dest) {
+  // Longer strings can not be huffman encoded inline anyway.
+  constexpr size_t kMaxValueLen = CompactObj::MaxHuffLen();
+
+  auto& db_slice = shard->db_slice();
+  string scratch;
+  unsigned steps = 0;
+
+  for (unsigned i = 0; i < db_slice.db_array_size(); ++i) {
+    DbTable* dbt = db_slice.GetDBTable(i);
+    if (dbt == nullptr)
+      continue;
+
+    PrimeTable::Cursor cursor;
+    do {
+      cursor = dbt->prime.Traverse(cursor, [&](PrimeIterator it) {
+        dest->Add(it->first.GetSlice(&scratch));
+        const PrimeValue& pv = it->second;
+        if (pv.ObjType() == OBJ_STRING && !pv.IsExternal() && pv.Size() <= kMaxValueLen)
+          dest->Add(pv.GetSlice(&scratch));
+        ++steps;
+      });
+
+      if (dest->num_samples >= max_samples)
+        return;
+
+      if (steps >= 20000) {
+        steps = 0;
+        ThisFiber::Yield();
+      }
+    } while (cursor);
+  }
+}
+
 ObjInfo InspectOp(string_view key, DbIndex db_index) {
   auto& db_slice = EngineShard::tlocal()->db_slice();
   auto [pt, exp_t] = db_slice.GetTables(db_index);
@@ -394,6 +442,10 @@ void DebugCmd::Run(CmdArgList args) {
         "    ELEMENTS specifies how many sub elements if relevant (like entries in a list / set).",
         "OBJHIST",
         "    Prints histogram of object sizes.",
+        "COMPRESSION [max_bits]",
+        "    Samples keys and short string values and builds a huffman table for them.",
+        "    Returns the estimated compression ratio and the base64 encoded table that can be",
+        "    passed to --huffman_table.",
         "STACKTRACE",
         "    Prints the stacktraces of all current fibers to the logs.",
         "SHARDS",
@@ -446,6 +498,10 @@ void DebugCmd::Run(CmdArgList args) {
     return ObjHist();
   }
 
+  if (subcmd == "COMPRESSION") {
+    return Compression(args.subspan(1));
+  }
+
   if (subcmd == "STACKTRACE") {
     return Stacktrace();
   }
@@ -918,6 +974,55 @@ void DebugCmd::ObjHist() {
   rb->SendVerbatimString(result);
 }
 
+void DebugCmd::Compression(CmdArgList args) {
+  constexpr size_t kMaxSamplesPerShard = 100000;
+
+  unsigned max_bits = HuffmanEncoder::kMaxCodeBits;
+  if (args.size() > 1)
+    return cntx_->SendError(kSyntaxErr);
+
+  if (args.size() == 1 && !absl::SimpleAtoi(ArgS(args, 0), &max_bits))
+    return cntx_->SendError(kInvalidIntErr);
+
+  vector<ByteHist> shard_hist(shard_set->size());
+  shard_set->RunBlockingInParallel([&](EngineShard* shard) {
+    DoBuildByteHist(shard, kMaxSamplesPerShard, &shard_hist[shard->shard_id()]);
+  });
+
+  ByteHist total;
+  for (const auto& hist : shard_hist) {
+    for (unsigned i = 0; i < 256; ++i)
+      total.hist[i] += hist.hist[i];
+    total.num_samples += hist.num_samples;
+  }
+
+  HuffmanEncoder encoder;
+  string err_msg;
+  if (!encoder.Build(total.hist, max_bits, &err_msg))
+    return cntx_->SendError(err_msg);
+
+  size_t raw_bytes = 0, compressed_bits = 0;
+  for (unsigned i = 0; i < 256; ++i) {
+    char c = i;
+    raw_bytes += total.hist[i];
+    compressed_bits += size_t(total.hist[i]) * encoder.EncodedBits(string_view{&c, 1});
+  }
+  size_t compressed_bytes = (compressed_bits + 7) / 8;
+
+  auto* rb = static_cast<RedisReplyBuilder*>(cntx_->reply_builder());
+  rb->StartCollection(5, RedisReplyBuilder::MAP);
+  rb->SendSimpleString("sampled");
+  rb->SendLong(total.num_samples);
+  rb->SendSimpleString("raw_bytes");
+  rb->SendLong(raw_bytes);
+  rb->SendSimpleString("compressed_bytes");
+  rb->SendLong(compressed_bytes);
+  rb->SendSimpleString("ratio");
+  rb->SendDouble(raw_bytes ? double(compressed_bytes) / raw_bytes : 1.0);
+  rb->SendSimpleString("huffman_table");
+  rb->SendBulkString(absl::Base64Escape(encoder.Export()));
+}
+
 void DebugCmd::Stacktrace() {
   fb2::Mutex m;
   shard_set->pool()->AwaitFiberOnAll([&m](unsigned index, ProactorBase* base) {
@@ -48,6 +48,7 @@ class DebugCmd {
   void Watched();
   void TxAnalysis();
   void ObjHist();
+  void Compression(CmdArgList args);
   void Stacktrace();
   void Shards();
   void LogTraffic(CmdArgList);
@@ -12,6 +12,7 @@
 #include "base/flags.h"
 #include "base/logging.h"
 #include "server/detail/snapshot_storage.h"
+#include "server/journal/journal.h"
 #include "server/main_service.h"
 #include "server/script_mgr.h"
 #include "server/transaction.h"
@@ -166,6 +167,13 @@ std::optional<SaveInfo> SaveStagesController::InitResourcesAndStart() {
 
   InitResources();
 
+  // Snapshots of the default file are loaded on startup, so the persistent journal restarts
+  // from them: the shards switch to a new journal generation at the snapshot point.
+  if (auto* journal = ServerState::tlocal()->journal();
+      journal && journal->IsPersistent() && basename_.empty()) {
+    journal_generation_ = journal->NewGeneration();
+  }
+
   if (use_dfs_format_)
     SaveDfs();
   else
@@ -185,6 +193,11 @@ SaveInfo SaveStagesController::Finalize() {
     shared_err_ = err;
   }
 
+  if (journal_generation_ && !shared_err_) {
+    if (auto* journal = ServerState::tlocal()->journal(); journal)
+      journal->RemoveFilesBefore(journal_generation_);
+  }
+
   return GetSaveInfo();
 }
 
@@ -257,6 +270,8 @@ void SaveStagesController::SaveDfs() {
     // a hack to avoid deadlock in Transaction::RunCallback(...)
     shard->db_slice().UnlockChangeCb();
     SaveDfsSingle(shard);
+    if (journal_generation_)
+      shard->journal()->RotateFile(journal_generation_);
     shard->db_slice().LockChangeCb();
     return OpStatus::OK;
   };
@@ -270,6 +285,8 @@ void SaveStagesController::SaveDfsSingle(EngineShard* shard) {
 
   SaveMode mode = shard == nullptr ? SaveMode::SUMMARY : SaveMode::SINGLE_SHARD;
   auto glob_data = shard == nullptr ? RdbSaver::GetGlobalData(service_) : RdbSaver::GlobalData{};
+  if (shard == nullptr)
+    glob_data.journal_generation = journal_generation_;
 
   if (auto err = snapshot->Start(mode, filename, glob_data); err) {
     shared_err_ = err;
@@ -291,15 +308,21 @@ void SaveStagesController::SaveRdb() {
   if (!is_cloud_)
     filename += ".tmp";
 
-  if (auto err = snapshot->Start(SaveMode::RDB, filename, RdbSaver::GetGlobalData(service_)); err) {
+  auto glob_data = RdbSaver::GetGlobalData(service_);
+  glob_data.journal_generation = journal_generation_;
+  if (auto err = snapshot->Start(SaveMode::RDB, filename, glob_data); err) {
+    shared_err_ = err;
     snapshot.reset();
     return;
   }
 
-  auto cb = [snapshot = snapshot.get()](Transaction* t, EngineShard* shard) {
+  auto cb = [snapshot = snapshot.get(), gen = journal_generation_](Transaction* t,
+                                                                   EngineShard* shard) {
     // a hack to avoid deadlock in Transaction::RunCallback(...)
     shard->db_slice().UnlockChangeCb();
     snapshot->StartInShard(shard);
+    if (gen)
+      shard->journal()->RotateFile(gen);
     shard->db_slice().LockChangeCb();
     return OpStatus::OK;
   };
@@ -125,6 +125,7 @@ struct SaveStagesController : public SaveStagesInputs {
   absl::Time start_time_;
   std::filesystem::path full_path_;
   bool is_cloud_;
+  uint64_t journal_generation_ = 0;  // set if the snapshot anchors the persistent journal
 
   AggregateGenericError shared_err_;
   std::vector<std::pair<std::unique_ptr<RdbSnapshot>, std::filesystem::path>> snapshots_;
@@ -0,0 +1,251 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#include "server/detail/shm_ring.h"
+
+#include <absl/numeric/bits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "util/fibers/fibers.h"
+
+namespace dfly {
+namespace detail {
+
+using namespace std;
+using namespace util;
+
+namespace {
+
+constexpr uint64_t kMagic = 0x474e49524d485344;  // "DSHMRING"
+constexpr size_t kHeaderSize = 4096;
+
+// A polling side first yields to the other fibers of its thread, which is enough when the
+// other process keeps up, and then backs off to sleeps of up to kMaxSleep.
+constexpr unsigned kYieldAttempts = 64;
+constexpr auto kMinSleep = 20us;
+constexpr auto kMaxSleep = 1ms;
+
+error_code LastError() {
+  return error_code{errno, system_category()};
+}
+
+}  // namespace
+
+// Lives at the start of the segment, followed by the data at kHeaderSize. head and tail count
+// the bytes written and read so far and are only advanced by the writer and the reader
+// respectively, so the ring needs no locks. reader_sleeps is set by a reader that is about to
+// sleep on the doorbell and cleared by the writer that rings it.
+struct ShmRing::Header {
+  uint64_t magic;
+  uint64_t capacity;  // power of 2
+  alignas(64) atomic_uint64_t head;
+  alignas(64) atomic_uint64_t tail;
+  alignas(64) atomic_uint32_t closed;
+  atomic_uint32_t reader_sleeps;
+};
+
+static_assert(sizeof(ShmRing::Header) <= kHeaderSize);
+static_assert(atomic_uint64_t::is_always_lock_free && atomic_uint32_t::is_always_lock_free,
+              "the ring is shared between processes");
+
+ShmRing::ShmRing(string name, bool owner, void* map, size_t map_size)
+    : name_(std::move(name)),
+      owner_(owner),
+      header_(static_cast<Header*>(map)),
+      data_(static_cast<uint8_t*>(map) + kHeaderSize),
+      map_size_(map_size) {
+}
+
+ShmRing::~ShmRing() {
+  munmap(header_, map_size_);
+  if (owner_ && !unlinked_)
+    shm_unlink(name_.c_str());
+}
+
+io::Result<unique_ptr<ShmRing>> ShmRing::Create(string name, size_t capacity) {
+  capacity = absl::bit_ceil(max<size_t>(capacity, 4096));
+  size_t map_size = kHeaderSize + capacity;
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    return nonstd::make_unexpected(LastError());
+
+  void* map = MAP_FAILED;
+  if (ftruncate(fd, map_size) == 0)
+    map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  error_code ec = map == MAP_FAILED ? LastError() : error_code{};
+  close(fd);
+
+  if (ec) {
+    shm_unlink(name.c_str());
+    return nonstd::make_unexpected(ec);
+  }
+
+  Header* header = new (map) Header{};
+  header->magic = kMagic;
+  header->capacity = capacity;
+  return unique_ptr<ShmRing>{new ShmRing(std::move(name), true, map, map_size)};
+}
+
+io::Result<unique_ptr<ShmRing>> ShmRing::Open(string name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0)
+    return nonstd::make_unexpected(LastError());
+
+  struct stat st;
+  error_code ec;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) != 0)
+    ec = LastError();
+  else if (size_t(st.st_size) <= kHeaderSize)
+    ec = make_error_code(errc::invalid_argument);
+  else if ((map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) ==
+           MAP_FAILED)
+    ec = LastError();
+  close(fd);
+
+  if (ec)
+    return nonstd::make_unexpected(ec);
+
+  const Header* header = static_cast<const Header*>(map);
+  if (header->magic != kMagic || !absl::has_single_bit(header->capacity) ||
+      header->capacity + kHeaderSize != size_t(st.st_size)) {
+    munmap(map, st.st_size);
+    return nonstd::make_unexpected(make_error_code(errc::invalid_argument));
+  }
+
+  return unique_ptr<ShmRing>{new ShmRing(std::move(name), false, map, st.st_size)};
+}
+
+template <typename Pred> bool ShmRing::WaitFor(Pred pred) const {
+  for (unsigned attempt = 0; !pred(); ++attempt) {
+    // The other side may have made progress right before closing the ring.
+    if (IsClosed())
+      return pred();
+
+    if (attempt < kYieldAttempts)
+      ThisFiber::Yield();
+    else
+      ThisFiber::SleepFor(
+          min<chrono::microseconds>(kMaxSleep, kMinSleep * (attempt - kYieldAttempts + 1)));
+  }
+  return true;
+}
+
+template <typename Pred> bool ShmRing::WaitForWriter(Pred pred) {
+  while (!pred()) {
+    if (IsClosed())
+      return pred();
+
+    // Pairs with the fence in WriteSome: either the writer sees the flag and rings the doorbell,
+    // or the check below sees its data.
+    header_->reader_sleeps.store(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (pred() || IsClosed()) {
+      header_->reader_sleeps.store(0, memory_order_relaxed);
+      continue;
+    }
+
+    // The doorbell shares the fate of the flow connection.
+    if (!wait_writer_())
+      return pred();
+  }
+  return true;
+}
+
+io::Result<size_t> ShmRing::WriteSome(const iovec* v, uint32_t len) {
+  if (IsClosed())
+    return nonstd::make_unexpected(make_error_code(errc::broken_pipe));
+
+  const uint64_t capacity = header_->capacity;
+  const uint64_t head = header_->head.load(memory_order_relaxed);
+  uint64_t tail = 0;
+  if (!WaitFor([&] {
+        tail = header_->tail.load(memory_order_acquire);
+        return head - tail < capacity;
+      })) {
+    return nonstd::make_unexpected(make_error_code(errc::broken_pipe));
+  }
+
+  uint64_t pos = head;
+  size_t room = capacity - (head - tail);
+  for (uint32_t i = 0; i < len && room > 0; ++i) {
+    const uint8_t* src = static_cast<const uint8_t*>(v[i].iov_base);
+    size_t n = min(v[i].iov_len, room);
+    size_t offs = pos & (capacity - 1);
+    size_t first = min<size_t>(n, capacity - offs);
+    memcpy(data_ + offs, src, first);
+    memcpy(data_, src + first, n - first);
+    pos += n;
+    room -= n;
+  }
+
+  header_->head.store(pos, memory_order_release);
+
+  atomic_thread_fence(memory_order_seq_cst);
+  if (notify_reader_ && header_->reader_sleeps.load(memory_order_relaxed) &&
+      header_->reader_sleeps.exchange(0, memory_order_relaxed)) {
+    notify_reader_();
+  }
+  return pos - head;
+}
+
+io::Result<size_t> ShmRing::ReadSome(const iovec* v, uint32_t len) {
+  const uint64_t capacity = header_->capacity;
+  const uint64_t tail = header_->tail.load(memory_order_relaxed);
+  uint64_t head = 0;
+  auto readable = [&] {
+    head = header_->head.load(memory_order_acquire);
+    return head != tail;
+  };
+  if (!(wait_writer_ ? WaitForWriter(readable) : WaitFor(readable)))
+    return nonstd::make_unexpected(make_error_code(errc::connection_aborted));
+
+  uint64_t pos = tail;
+  for (uint32_t i = 0; i < len && pos != head; ++i) {
+    uint8_t* dest = static_cast<uint8_t*>(v[i].iov_base);
+    size_t n = min<size_t>(v[i].iov_len, head - pos);
+    size_t offs = pos & (capacity - 1);
+    size_t first = min<size_t>(n, capacity - offs);
+    memcpy(dest, data_ + offs, first);
+    memcpy(dest + first, data_, n - first);
+    pos += n;
+  }
+
+  header_->tail.store(pos, memory_order_release);
+  return pos - tail;
+}
+
+void ShmRing::Close() {
+  header_->closed.store(1, memory_order_release);
+}
+
+bool ShmRing::IsClosed() const {
+  return header_->closed.load(memory_order_acquire) != 0;
+}
+
+void ShmRing::SetNotifyReader(function<void()> notify) {
+  notify_reader_ = std::move(notify);
+}
+
+void ShmRing::SetWaitWriter(function<bool()> wait) {
+  wait_writer_ = std::move(wait);
+}
+
+void ShmRing::Unlink() {
+  if (owner_ && !unlinked_) {
+    shm_unlink(name_.c_str());
+    unlinked_ = true;
+  }
+}
+
+}  // namespace detail
+}  // namespace dfly
@@ -0,0 +1,85 @@
+// Copyright 2024, DragonflyDB authors.  All rights reserved.
+// See LICENSE for licensing terms.
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "io/io.h"
+
+namespace dfly {
+namespace detail {
+
+// Single producer, single consumer byte ring in a POSIX shared memory segment. Carries the data
+// of a replication flow when the replica runs on the same host as the master: the replica
+// creates the segment and reads from it, the master opens it by name and writes to it.
+// An empty ring puts the reader to sleep on a doorbell, which the writer rings when it publishes
+// data. Both processes already share the flow connection, so the doorbell is a byte written to
+// its socket and the reader sleeps in the proactor like on any socket read. A writer facing a
+// full ring yields its fiber and then sleeps with growing intervals until the reader catches up,
+// so neither side ever blocks its proactor thread.
+class ShmRing : public io::Sink, public io::Source {
+ public:
+  ~ShmRing() override;
+
+  // Creates a segment with room for at least capacity bytes. Fails if the name is taken.
+  static io::Result<std::unique_ptr<ShmRing>> Create(std::string name, size_t capacity);
+
+  // Opens a segment created by another process.
+  static io::Result<std::unique_ptr<ShmRing>> Open(std::string name);
+
+  // Blocks until at least one byte is written. Fails once the ring is closed.
+  io::Result<size_t> WriteSome(const iovec* v, uint32_t len) final;
+
+  // Blocks until at least one byte is read. Data written before the ring was closed is still
+  // delivered, after that reads fail.
+  io::Result<size_t> ReadSome(const iovec* v, uint32_t len) final;
+
+  // Closes the ring for both processes and wakes up the waiting sides.
+  void Close();
+
+  // Writer side: rings the doorbell of a sleeping reader.
+  void SetNotifyReader(std::function<void()> notify);
+
+  // Reader side: sleeps until the writer rang the doorbell, returns false if the doorbell broke.
+  // Reads then fail like on a closed ring. Without a doorbell the reader polls.
+  void SetWaitWriter(std::function<bool()> wait);
+
+  // Removes the name of the segment, the processes that mapped it keep using it. The creator
+  // calls it once the other side opened the segment, so that a crash does not leak it.
+  void Unlink();
+
+  bool IsClosed() const;
+
+  const std::string& name() const {
+    return name_;
+  }
+
+ private:
+  struct Header;
+
+  ShmRing(std::string name, bool owner, void* map, size_t map_size);
+
+  // Waits until pred() holds. Returns false if the ring was closed first.
+  template <typename Pred> bool WaitFor(Pred pred) const;
+
+  // Like WaitFor, but sleeps on the doorbell between the checks.
+  template <typename Pred> bool WaitForWriter(Pred pred);
+
+  std::string name_;
+  bool owner_;  // the creator unlinks the segment
+  bool unlinked_ = false;
+  Header* header_;
+  uint8_t* data_;
+  size_t map_size_;
+
+  std::function<void()> notify_reader_;
+  std::function<bool()> wait_writer_;
+};
+
+}  // namespace detail
+}  // namespace dfly
@@ -6,6 +6,7 @@
 #include <absl/random/random.h>
 #include <absl/strings/str_cat.h>
 #include <absl/strings/strip.h>
+#include <sys/socket.h>
 
 #include <limits>
 #include <memory>
@@ -20,6 +21,7 @@
 #include "facade/dragonfly_connection.h"
 #include "facade/dragonfly_listener.h"
 #include "server/debugcmd.h"
+#include "server/detail/shm_ring.h"
 #include "server/engine_shard_set.h"
 #include "server/error.h"
 #include "server/journal/journal.h"
@@ -32,6 +34,17 @@
 #include "server/transaction.h"
 using namespace std;
 
+ABSL_FLAG(uint32_t, replication_resume_buffer, 4u << 20,
+          "Minimum bytes of full sync data each flow keeps to resume the sync after a broken "
+          "connection. A broken connection loses the data buffered by the sockets of both "
+          "sides, so each flow keeps at least twice the send buffer size of its socket. On "
+          "links with a high bandwidth-delay product whose buffers grow past that, set it to "
+          "the sum of the socket buffer limits of the master and the replica. "
+          "0 disables resuming.");
+ABSL_FLAG(uint32_t, replication_resume_timeout_ms, 30000,
+          "Time to wait for a replica to resume a broken full sync flow before cancelling the "
+          "sync.");
+
 ABSL_DECLARE_FLAG(bool, info_replication_valkey_compatible);
 
 namespace dfly {
@@ -48,6 +61,16 @@ const char kIdNotFound[] = "syncid not found";
 const char kInvalidSyncId[] = "bad sync id";
 const char kInvalidState[] = "invalid state";
 
+// Bytes a broken connection may lose: the send buffer of sock and the receive window of the
+// peer. The peer window is not known, so it is assumed to match the send buffer.
+size_t InflightLimit(util::FiberSocketBase* sock) {
+  int sndbuf = 0;
+  socklen_t len = sizeof(sndbuf);
+  if (getsockopt(sock->native_handle(), SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) != 0)
+    return 0;
+  return 2 * size_t(sndbuf);
+}
+
 bool ToSyncId(string_view str, uint32_t* num) {
   if (!absl::StartsWith(str, "SYNC"))
     return false;
@@ -137,7 +160,7 @@ void DflyCmd::Run(CmdArgList args, ConnectionContext* cntx) {
     return Thread(args, cntx);
   }
 
-  if (sub_cmd == "FLOW" && (args.size() == 4 || args.size() == 5)) {
+  if (sub_cmd == "FLOW" && args.size() >= 4 && args.size() <= 7) {
     return Flow(args, cntx);
   }
 
@@ -211,15 +234,31 @@ void DflyCmd::Flow(CmdArgList args, ConnectionContext* cntx) {
   string_view flow_id_str = ArgS(args, 3);
 
   std::optional<LSN> seqid;
-  if (args.size() == 5) {
-    seqid.emplace();
-    if (!absl::SimpleAtoi(ArgS(args, 4), &seqid.value())) {
+  std::optional<uint64_t> resume_offset;
+  string_view shm_name;
+  if (args.size() == 6 && absl::EqualsIgnoreCase(ArgS(args, 4), "RESUME")) {
+    resume_offset.emplace();
+    if (!absl::SimpleAtoi(ArgS(args, 5), &resume_offset.value())) {
       return cntx->SendError(facade::kInvalidIntErr);
     }
+  } else {
+    size_t next_arg = 4;
+    if (args.size() > next_arg && !absl::EqualsIgnoreCase(ArgS(args, next_arg), "SHM")) {
+      seqid.emplace();
+      if (!absl::SimpleAtoi(ArgS(args, next_arg++), &seqid.value())) {
+        return cntx->SendError(facade::kInvalidIntErr);
+      }
+    }
+
+    if (args.size() == next_arg + 2 && absl::EqualsIgnoreCase(ArgS(args, next_arg), "SHM")) {
+      shm_name = ArgS(args, next_arg + 1);
+    } else if (args.size() != next_arg) {
+      return cntx->SendError(kSyntaxErr);
+    }
   }
 
   VLOG(1) << "Got DFLY FLOW master_id: " << master_id << " sync_id: " << sync_id_str
-          << " flow: " << flow_id_str << " seq: " << seqid.value_or(-1);
+          << " flow: " << flow_id_str << " seq: " << seqid.value_or(-1) << " shm: " << shm_name;
 
   if (master_id != sf_->master_replid()) {
     return cntx->SendError(kBadMasterId);
@@ -235,9 +274,26 @@ void DflyCmd::Flow(CmdArgList args, ConnectionContext* cntx) {
     return;
 
   unique_lock lk(replica_ptr->mu);
+  if (resume_offset) {
+    if (replica_ptr->replica_state != SyncState::FULL_SYNC)
+      return cntx->SendError(kInvalidState);
+    return ResumeFlow(sync_id, flow_id, *resume_offset, replica_ptr.get(), std::move(lk), cntx);
+  }
+
   if (replica_ptr->replica_state != SyncState::PREPARATION)
     return cntx->SendError(kInvalidState);
 
+  std::unique_ptr<detail::ShmRing> shm_ring;
+  if (!shm_name.empty()) {
+    auto ring = detail::ShmRing::Open(string{shm_name});
+    if (!ring) {
+      LOG(WARNING) << "Could not open shared memory ring " << shm_name << ": "
+                   << ring.error().message();
+      return cntx->SendError(absl::StrCat("could not open shared memory ring ", shm_name));
+    }
+    shm_ring = std::move(*ring);
+  }
+
   // Set meta info on connection.
   cntx->conn()->SetName(absl::StrCat("repl_flow_", sync_id));
   cntx->conn_state.replication_info.repl_session_id = sync_id;
@@ -251,6 +307,14 @@ void DflyCmd::Flow(CmdArgList args, ConnectionContext* cntx) {
   flow.conn = cntx->conn();
   flow.eof_token = eof_token;
   flow.version = replica_ptr->version;
+  flow.shm_ring = std::move(shm_ring);
+  if (flow.shm_ring) {
+    // The replica sleeps on the flow connection while the ring is empty.
+    flow.shm_ring->SetNotifyReader([&flow] {
+      if (flow.conn && flow.conn->socket()->IsOpen())
+        (void)flow.conn->socket()->Write(io::Buffer(string_view{"\n"}));
+    });
+  }
   if (!cntx->conn()->Migrate(shard_set->pool()->at(flow_id))) {
     // Listener::PreShutdown() triggered
     if (cntx->conn()->socket()->IsOpen()) {
@@ -283,6 +347,60 @@ void DflyCmd::Flow(CmdArgList args, ConnectionContext* cntx) {
   rb->SendSimpleString(eof_token);
 }
 
+void DflyCmd::ResumeFlow(uint32_t sync_id, unsigned flow_id, uint64_t offset,
+                         ReplicaInfo* replica_ptr, unique_lock<fb2::Mutex> lk,
+                         ConnectionContext* cntx) {
+  RedisReplyBuilder* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+  FlowInfo* flow = &replica_ptr->flows[flow_id];
+  shared_ptr<ResumableFlowSink> sink = flow->resumable_sink;
+  if (!sink || !sink->CanResume(offset))
+    return cntx->SendError(kInvalidState);
+
+  cntx->conn()->SetName(absl::StrCat("repl_flow_", sync_id));
+  cntx->conn_state.replication_info.repl_session_id = sync_id;
+  cntx->conn_state.replication_info.repl_flow_id = flow_id;
+
+  if (!cntx->conn()->Migrate(shard_set->pool()->at(flow_id))) {
+    // Listener::PreShutdown() triggered
+    if (cntx->conn()->socket()->IsOpen()) {
+      return cntx->SendError(kInvalidState);
+    }
+    return;
+  }
+
+  // Take over the flow, closing the previous connection does not cancel the sync anymore.
+  cntx->replication_flow = flow;
+  flow->conn = cntx->conn();
+
+  LOG(INFO) << "Resuming full sync of flow " << flow_id << " at offset " << offset;
+
+  // Replaying can block for long, the sink is kept alive by the shared pointer. A cancellation
+  // in the meantime shuts down the new connection, which fails the replay.
+  lk.unlock();
+
+  // The stream continues right after the reply, so it must not stay in the batch.
+  rb->SendOk();
+  rb->FlushBatch();
+  if (!sink->Resume(cntx->conn()->socket(), offset)) {
+    // The replica can not tell the stream data apart from an error, make it retry instead.
+    (void)cntx->conn()->socket()->Shutdown(SHUT_RDWR);
+  }
+}
+
+bool DflyCmd::DetachFlow(ConnectionContext* cntx, ReplicaInfo* replica_ptr) {
+  lock_guard lk(replica_ptr->mu);
+  FlowInfo* flow = cntx->replication_flow;
+  if (flow->conn != cntx->conn())
+    return true;
+
+  if (replica_ptr->replica_state != SyncState::FULL_SYNC || !flow->resumable_sink)
+    return false;
+
+  flow->resumable_sink->Detach();
+  flow->conn = nullptr;
+  return true;
+}
+
 void DflyCmd::Sync(CmdArgList args, ConnectionContext* cntx) {
   RedisReplyBuilder* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
   string_view sync_id_str = ArgS(args, 1);
@@ -485,13 +603,23 @@ OpStatus DflyCmd::StartFullSyncInThread(FlowInfo* flow, Context* cntx, EngineSha
   // of the flows also contain them.
   SaveMode save_mode =
       shard->shard_id() == 0 ? SaveMode::SINGLE_SHARD_WITH_SUMMARY : SaveMode::SINGLE_SHARD;
-  flow->saver = std::make_unique<RdbSaver>(flow->conn->socket(), save_mode, false);
+  size_t resume_buffer = absl::GetFlag(FLAGS_replication_resume_buffer);
+  if (!flow->shm_ring && resume_buffer > 0 && flow->version >= DflyVersion::VER5) {
+    resume_buffer = max(resume_buffer, InflightLimit(flow->conn->socket()));
+    auto timeout = chrono::milliseconds(absl::GetFlag(FLAGS_replication_resume_timeout_ms));
+    flow->resumable_sink =
+        std::make_shared<ResumableFlowSink>(flow->conn->socket(), resume_buffer, timeout);
+  }
+  flow->saver = std::make_unique<RdbSaver>(flow->DataSink(), save_mode, false);
 
   flow->cleanup = [flow]() {
     flow->saver->Cancel();
+    if (flow->resumable_sink)
+      flow->resumable_sink->Cancel();
     flow->TryShutdownSocket();
     flow->full_sync_fb.JoinIfNeeded();
     flow->saver.reset();
+    flow->resumable_sink.reset();
   };
 
   error_code ec;
@@ -530,15 +658,23 @@ void DflyCmd::StopFullSyncInThread(FlowInfo* flow, EngineShard* shard) {
   // Reset cleanup and saver
   flow->cleanup = []() {};
   flow->saver.reset();
+  flow->resumable_sink.reset();
 }
 
 OpStatus DflyCmd::StartStableSyncInThread(FlowInfo* flow, Context* cntx, EngineShard* shard) {
+  // The flow connection broke at the end of the full sync and was not resumed.
+  if (flow->conn == nullptr)
+    return OpStatus::CANCELLED;
+
   // Create streamer for shard flows.
 
   if (shard != nullptr) {
     flow->streamer.reset(new JournalStreamer(sf_->journal(), cntx));
     bool send_lsn = flow->version >= DflyVersion::VER4;
-    flow->streamer->Start(flow->conn->socket(), send_lsn);
+    if (flow->shm_ring)
+      flow->streamer->StartWithSink(flow->shm_ring.get(), send_lsn);
+    else
+      flow->streamer->Start(flow->conn->socket(), send_lsn);
   }
 
   // Register cleanup.
@@ -560,7 +696,7 @@ void DflyCmd::FullSyncFb(FlowInfo* flow, Context* cntx) {
     return;
   }
 
-  ec = flow->conn->socket()->Write(io::Buffer(flow->eof_token));
+  ec = flow->DataSink()->Write(io::Buffer(flow->eof_token));
   if (ec) {
     cntx->ReportError(ec);
     return;
@@ -617,6 +753,11 @@ void DflyCmd::OnClose(ConnectionContext* cntx) {
   if (!replica_ptr)
     return;
 
+  // A broken full sync flow waits for the replica to resume it on a new connection, and
+  // cancels the sync by itself if the replica does not come back in time.
+  if (cntx->replication_flow && DetachFlow(cntx, replica_ptr.get()))
+    return;
+
   // Because CancelReplication holds the per-replica mutex,
   // aborting connection will block here until cancellation finishes.
   // This allows keeping resources alive during the cleanup phase.
@@ -723,6 +864,9 @@ void DflyCmd::GetReplicationMemoryStats(ReplicationMemoryStats* stats) const {
 
       if (flow.saver)
         stats->full_sync_buf_bytes += flow.saver->GetTotalBuffersSize();
+
+      if (flow.resumable_sink)
+        stats->full_sync_buf_bytes += flow.resumable_sink->GetBufferSize();
     }
   };
   shard_set->RunBlockingInParallel(cb);
@@ -783,6 +927,65 @@ void DflyCmd::SetDflyClientVersion(ConnectionContext* cntx, DflyVersion version)
   replica_ptr->version = version;
 }
 
+void DflyCmd::OnFlowAck(FlowInfo* flow, LSN lsn) {
+  flow->last_acked_lsn = lsn;
+  acks_ec_.notifyAll();
+}
+
+unsigned DflyCmd::WaitForAcks(const std::vector<LSN>& lsns, unsigned num_replicas,
+                              chrono::steady_clock::time_point deadline) {
+  std::vector<shared_ptr<ReplicaInfo>> replicas;
+  {
+    lock_guard lk(mu_);
+    for (const auto& [_, info] : replica_infos_) {
+      lock_guard repl_lk{info->mu};
+      if (info->replica_state == SyncState::STABLE_SYNC)
+        replicas.push_back(info);
+    }
+  }
+
+  auto is_acked = [&lsns](const ReplicaInfo& replica, ShardId sid) {
+    return replica.flows[sid].last_acked_lsn >= lsns[sid];
+  };
+  auto count_acked = [&] {
+    return (unsigned)count_if(replicas.begin(), replicas.end(), [&](const auto& replica) {
+      if (replica->cntx.IsCancelled())
+        return false;
+      for (ShardId sid = 0; sid < lsns.size(); ++sid) {
+        if (!is_acked(*replica, sid))
+          return false;
+      }
+      return true;
+    });
+  };
+
+  if (unsigned acked = count_acked(); acked >= num_replicas || replicas.empty())
+    return acked;
+
+  // Flows acknowledge a PING right away, so record one in every shard some flow lags behind in
+  // instead of waiting for the periodic ACKs. It is appended after lsns, so it does not move
+  // the target.
+  auto lags = [&](ShardId sid) {
+    return any_of(replicas.begin(), replicas.end(),
+                  [&](const auto& replica) { return !is_acked(*replica, sid); });
+  };
+  shard_set->RunBriefInParallel(
+      [](EngineShard* shard) {
+        if (auto* journal = shard->journal(); journal)
+          journal->RecordEntry(0, journal::Op::PING, 0, 0, nullopt, {}, false);
+      },
+      lags);
+
+  auto done = [&] {
+    return count_acked() >= num_replicas || shutting_down_.load(memory_order_relaxed);
+  };
+  if (deadline == chrono::steady_clock::time_point::max())
+    acks_ec_.await(done);
+  else
+    acks_ec_.await_until(done, deadline);
+  return count_acked();
+}
+
 // Must run under locked replica_info.mu.
 bool DflyCmd::CheckReplicaStateOrReply(const ReplicaInfo& repl_info, SyncState expected,
                                        RedisReplyBuilder* rb) {
@@ -804,6 +1007,8 @@ bool DflyCmd::CheckReplicaStateOrReply(const ReplicaInfo& repl_info, SyncState e
 }
 
 void DflyCmd::BreakOnShutdown() {
+  shutting_down_.store(true, memory_order_relaxed);
+  acks_ec_.notifyAll();
 }
 
 void DflyCmd::Shutdown() {
@@ -819,10 +1024,105 @@ void DflyCmd::Shutdown() {
 }
 
 void FlowInfo::TryShutdownSocket() {
-  // Close socket for clean disconnect.
-  if (conn->socket()->IsOpen()) {
+  // Close socket for clean disconnect. A flow waiting to be resumed has no connection.
+  if (conn && conn->socket()->IsOpen()) {
     (void)conn->socket()->Shutdown(SHUT_RDWR);
   }
+  if (shm_ring) {
+    shm_ring->Close();
+  }
+}
+
+io::Sink* FlowInfo::DataSink() {
+  if (shm_ring)
+    return shm_ring.get();
+  if (resumable_sink)
+    return resumable_sink.get();
+  return conn->socket();
+}
+
+ResumableFlowSink::ResumableFlowSink(FiberSocketBase* sock, size_t replay_limit,
+                                     chrono::milliseconds resume_timeout)
+    : sock_(sock), replay_limit_(replay_limit), resume_timeout_(resume_timeout) {
+}
+
+io::Result<size_t> ResumableFlowSink::WriteSome(const iovec* v, uint32_t len) {
+  size_t total = 0;
+  error_code ec;
+  uint64_t generation;
+  {
+    lock_guard lk(mu_);
+    for (uint32_t i = 0; i < len; ++i) {
+      replay_.append(static_cast<const char*>(v[i].iov_base), v[i].iov_len);
+      total += v[i].iov_len;
+    }
+    offset_ += total;
+
+    // Trim in large steps to keep the cost of moving the buffer amortized.
+    if (replay_.size() > replay_limit_ + replay_limit_ / 4) {
+      size_t drop = replay_.size() - replay_limit_;
+      replay_.erase(0, drop);
+      replay_start_ += drop;
+    }
+
+    ec = sock_ ? sock_->Write(v, len) : make_error_code(errc::not_connected);
+    generation = generation_;
+  }
+
+  // A resume replays the data of this write as well.
+  if (ec)
+    ec = AwaitResume(generation, ec);
+  if (ec)
+    return nonstd::make_unexpected(ec);
+  return total;
+}
+
+error_code ResumableFlowSink::AwaitResume(uint64_t generation, error_code ec) {
+  if (cancelled_)
+    return ec;
+
+  LOG(WARNING) << "Full sync flow broke at offset " << offset_ << ": " << ec.message()
+               << ", waiting for the replica to resume it";
+
+  auto deadline = chrono::steady_clock::now() + resume_timeout_;
+  cv_status status = waker_.await_until(
+      [&] { return generation_ != generation || cancelled_; }, deadline);
+  if (status == cv_status::timeout || cancelled_)
+    return ec;
+  return {};
+}
+
+bool ResumableFlowSink::Resume(FiberSocketBase* sock, uint64_t offset) {
+  // Unblock a write that is stuck on the broken connection.
+  if (sock_ && sock_->IsOpen())
+    (void)sock_->Shutdown(SHUT_RDWR);
+
+  lock_guard lk(mu_);
+  if (!CanResume(offset))
+    return false;
+
+  // Writes append to the replay buffer under the same mutex, so it can be sent without a copy.
+  sock_ = sock;
+  error_code ec = sock_->Write(io::Buffer(string_view{replay_}.substr(offset - replay_start_)));
+  LOG_IF(WARNING, ec) << "Could not resume full sync flow: " << ec.message();
+
+  // Even if the write failed, the waiting writer can proceed and wait for the next resume.
+  ++generation_;
+  waker_.notifyAll();
+  return true;
+}
+
+void ResumableFlowSink::Detach() {
+  if (sock_ && sock_->IsOpen())
+    (void)sock_->Shutdown(SHUT_RDWR);
+
+  lock_guard lk(mu_);
+  sock_ = nullptr;
+}
+
+void ResumableFlowSink::Cancel() {
+  cancelled_ = true;
+  waker_.notifyAll();
 }
 
 FlowInfo::~FlowInfo() {
@@ -7,9 +7,11 @@
 #include <absl/container/btree_map.h>
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 
 #include "server/conn_context.h"
+#include "util/fiber_socket_base.h"
 
 namespace facade {
 class RedisReplyBuilder;
@@ -28,6 +30,55 @@ class JournalStreamer;
 struct ReplicaRoleInfo;
 struct ReplicationMemoryStats;
 
+namespace detail {
+class ShmRing;
+}  // namespace detail
+
+// Full sync sink of a flow that survives broken connections. Keeps the last written bytes in a
+// replay buffer. When a write fails, it waits for the replica to attach a new connection with
+// DFLY FLOW ... RESUME <offset> and continues the stream from that offset.
+class ResumableFlowSink : public io::Sink {
+ public:
+  ResumableFlowSink(util::FiberSocketBase* sock, size_t replay_limit,
+                    std::chrono::milliseconds resume_timeout);
+
+  io::Result<size_t> WriteSome(const iovec* v, uint32_t len) final;
+
+  // Whether the data from offset on is still in the replay buffer.
+  bool CanResume(uint64_t offset) const {
+    return offset >= replay_start_ && offset <= offset_;
+  }
+
+  // Continues the stream on sock from offset. Returns false if the data at offset was
+  // dropped from the replay buffer in the meantime.
+  bool Resume(util::FiberSocketBase* sock, uint64_t offset);
+
+  // Stops using the current socket because its connection is closing.
+  void Detach();
+
+  // Fails the pending and all further writes.
+  void Cancel();
+
+  size_t GetBufferSize() const {
+    return replay_.capacity();
+  }
+
+ private:
+  std::error_code AwaitResume(uint64_t generation, std::error_code ec);
+
+  util::FiberSocketBase* sock_;
+  uint64_t offset_ = 0;        // Bytes written so far.
+  uint64_t replay_start_ = 0;  // Offset of the first byte in replay_.
+  std::string replay_;
+  size_t replay_limit_;
+  std::chrono::milliseconds resume_timeout_;
+
+  uint64_t generation_ = 0;  // Incremented by each resume.
+  bool cancelled_ = false;
+  util::fb2::Mutex mu_;  // Serializes the writes to sock_ and the accesses to replay_.
+  util::fb2::EventCount waker_;
+};
+
 // Stores information related to a single flow.
 struct FlowInfo {
   FlowInfo();
@@ -36,7 +87,14 @@ struct FlowInfo {
   // Shutdown associated socket if its still open.
   void TryShutdownSocket();
 
+  // Where the flow data goes: the shared memory ring if the replica asked for one,
+  // the resumable sink during full sync, the connection socket otherwise.
+  io::Sink* DataSink();
+
   facade::Connection* conn = nullptr;
+  std::unique_ptr<detail::ShmRing> shm_ring;  // Set for same-host replicas (FLOW ... SHM).
+  // Set during full sync. Shared, because resuming writes to it without holding ReplicaInfo::mu.
+  std::shared_ptr<ResumableFlowSink> resumable_sink;
 
   util::fb2::Fiber full_sync_fb;              // Full sync fiber.
   std::unique_ptr<RdbSaver> saver;            // Saver for full sync phase.
@@ -152,6 +210,15 @@ class DflyCmd {
   // Transition into cancelled state, run cleanup.
   void CancelReplication(uint32_t sync_id, std::shared_ptr<ReplicaInfo> replica_info_ptr);
 
+  // Records that the flow acknowledged the journal up to lsn and wakes up the WAIT callers.
+  void OnFlowAck(FlowInfo* flow, LSN lsn);
+
+  // Waits until num_replicas replicas acknowledged the journal of every shard up to lsns,
+  // or until the deadline. Returns the number of replicas that did. Only the replicas that are
+  // in stable sync when the wait starts are counted.
+  unsigned WaitForAcks(const std::vector<LSN>& lsns, unsigned num_replicas,
+                       std::chrono::steady_clock::time_point deadline);
+
  private:
   // JOURNAL [START/STOP]
   // Start or stop journaling.
@@ -161,11 +228,18 @@ class DflyCmd {
   // Return connection thread index or migrate to another thread.
   void Thread(CmdArgList args, ConnectionContext* cntx);
 
-  // FLOW <masterid> <syncid> <flowid> [<seqid>]
+  // FLOW <masterid> <syncid> <flowid> RESUME <offset>
+  // Continue the full sync of a flow whose connection broke on this connection, starting with
+  // the byte at offset of the flow stream. Replies with OK right before the stream continues.
+  //
+  // FLOW <masterid> <syncid> <flowid> [<seqid>] [SHM <name>]
   // Register connection as flow for sync session.
   // If seqid is given, it means the client wants to try partial sync.
   // If it is possible, return Ok and prepare for a partial sync, else
   // return error and ask the replica to execute FLOW again.
+  // If SHM is given, the flow data is written to the shared memory ring of that name instead
+  // of the connection. Replies with an error if the ring can not be opened, for example when
+  // the replica runs on another host.
   void Flow(CmdArgList args, ConnectionContext* cntx);
 
   // SYNC <syncid>
@@ -200,6 +274,16 @@ class DflyCmd {
   // Fiber that runs full sync for each flow.
   void FullSyncFb(FlowInfo* flow, Context* cntx);
 
+  // Continue the full sync of a broken flow on the connection of cntx. Called with the replica
+  // mutex held by lk, which is released before the stream is replayed.
+  void ResumeFlow(uint32_t sync_id, unsigned flow_id, uint64_t offset, ReplicaInfo* replica_ptr,
+                  std::unique_lock<util::fb2::Mutex> lk, ConnectionContext* cntx);
+
+  // Returns true if the flow connection of cntx can close without cancelling the replication:
+  // either the flow moved to another connection, or it is in full sync and waits for the
+  // replica to resume it.
+  bool DetachFlow(ConnectionContext* cntx, ReplicaInfo* replica_ptr);
+
   // Main entrypoint for stopping replication.
   void StopReplication(uint32_t sync_id);
 
@@ -227,6 +311,9 @@ class DflyCmd {
   ReplicaInfoMap replica_infos_;
 
   mutable util::fb2::Mutex mu_;  // Guard global operations. See header top for locking levels.
+
+  util::fb2::EventCount acks_ec_;  // Notified on every ACK, wakes up WaitForAcks.
+  std::atomic_bool shutting_down_ = false;
 };
 
 }  // namespace dfly
@@ -73,6 +73,19 @@ ABSL_FLAG(string, shard_round_robin_prefix, "",
 ABSL_FLAG(uint32_t, mem_defrag_check_sec_interval, 10,
           "Number of seconds between every defragmentation necessity check");
 
+ABSL_FLAG(bool, shard_memory_rebalance, true,
+          "If true, maxmemory is periodically redistributed between the shards according to "
+          "their demand. Otherwise every shard is limited by an even share of maxmemory.");
+
+ABSL_FLAG(uint32_t, table_huge_pages_mb, 0,
+          "Size in MiB of the huge page region every shard maps for its hash table segments, "
+          "placed on the NUMA node of the shard thread. Segments that do not fit are allocated "
+          "on regular pages. 0 disables huge pages. Requires pre-allocated huge pages, "
+          "see /proc/sys/vm/nr_hugepages");
+
+ABSL_FLAG(string, table_huge_page_size, "2mb",
+          "Size of the huge pages backing the hash tables, 2mb or 1gb");
+
 namespace dfly {
 
 using namespace tiering::literals;
@@ -87,6 +100,20 @@ constexpr uint64_t kCursorDoneState = 0u;
 
 vector<EngineShardSet::CachedStats> cached_stats;  // initialized in EngineShardSet::Init
 
+size_t TableHugePageSize() {
+  string page_size = GetFlag(FLAGS_table_huge_page_size);
+  if (page_size == "1gb")
+    return 1ULL << 30;
+  LOG_IF(WARNING, page_size != "2mb") << "Unknown huge page size " << page_size << ", using 2mb";
+  return 1ULL << 21;
+}
+
+// Memory used by the whole process. The shard heaps do not include connections, IO and
+// replication buffers, so the resident size is used when it is larger.
+uint64_t ProcessUsedMemory(uint64_t shards_used) {
+  return max<uint64_t>(shards_used, rss_mem_current.load(memory_order_relaxed));
+}
+
 struct ShardMemUsage {
   std::size_t commited = 0;
   std::size_t used = 0;
@@ -212,7 +239,7 @@ EngineShardSet* shard_set = nullptr;
 uint64_t TEST_current_time_ms = 0;
 
 EngineShard::Stats& EngineShard::Stats::operator+=(const EngineShard::Stats& o) {
-  static_assert(sizeof(Stats) == 48);
+  static_assert(sizeof(Stats) == 72);
 
   defrag_attempt_total += o.defrag_attempt_total;
   defrag_realloc_total += o.defrag_realloc_total;
@@ -220,6 +247,9 @@ EngineShard::Stats& EngineShard::Stats::operator+=(const EngineShard::Stats& o)
   poll_execution_total += o.poll_execution_total;
   tx_ooo_total += o.tx_ooo_total;
   tx_immediate_total += o.tx_immediate_total;
+  blocked_wakeup_total += o.blocked_wakeup_total;
+  blocked_wakeup_batch_total += o.blocked_wakeup_batch_total;
+  blocked_wakeup_latency_usec += o.blocked_wakeup_latency_usec;
 
   return *this;
 }
@@ -372,6 +402,8 @@ EngineShard::EngineShard(util::ProactorBase* pb, mi_heap_t* heap)
     : queue_(1, kQueueLen),
       txq_([](const Transaction* t) { return t->txid(); }),
       mi_resource_(heap),
+      table_resource_(&mi_resource_, size_t(GetFlag(FLAGS_table_huge_pages_mb)) << 20,
+                      TableHugePageSize()),
       db_slice_(pb->GetPoolIndex(), GetFlag(FLAGS_cache_mode), this) {
   tmp_str1 = sdsempty();
 
@@ -585,6 +617,7 @@ void EngineShard::Heartbeat() {
     return;
 
   constexpr double kTtlDeleteLimit = 200;
+  constexpr unsigned kMemberExpiryBuckets = 256;
   constexpr double kRedLimitFactor = 0.1;
 
   uint32_t traversed = GetMovingSum6(TTL_TRAVERSE);
@@ -598,9 +631,9 @@ void EngineShard::Heartbeat() {
     ttl_delete_target = kTtlDeleteLimit * double(deleted) / (double(traversed) + 10);
   }
 
-  ssize_t eviction_redline = (max_memory_limit * kRedLimitFactor) / shard_set->size();
-  size_t tiering_redline =
-      (max_memory_limit * GetFlag(FLAGS_tiered_offload_threshold)) / shard_set->size();
+  size_t memory_limit = MemoryLimit();
+  ssize_t eviction_redline = memory_limit * kRedLimitFactor;
+  size_t tiering_redline = memory_limit * GetFlag(FLAGS_tiered_offload_threshold);
 
   DbContext db_cntx;
   db_cntx.time_now_ms = GetCurrentTimeMs();
@@ -618,6 +651,8 @@ void EngineShard::Heartbeat() {
       counter_[TTL_DELETE].IncBy(stats.deleted);
     }
 
+    db_slice_.DeleteExpiredMembersStep(db_cntx, kMemberExpiryBuckets);
+
     // if our budget is below the limit
     if (db_slice_.memory_budget() < eviction_redline) {
       db_slice_.FreeMemWithEvictionStep(i, eviction_redline - db_slice_.memory_budget());
@@ -628,6 +663,10 @@ void EngineShard::Heartbeat() {
     }
   }
 
+  // Expired and evicted keys are not deleted by transactions, so their invalidations
+  // are not flushed by OnCbFinish.
+  db_slice_.FlushBroadcastInvalidations();
+
   // Journal entries for expired entries are not writen to socket in the loop above.
   // Trigger write to socket when loop finishes.
   if (auto journal = EngineShard::tlocal()->journal(); journal) {
@@ -639,6 +678,7 @@ void EngineShard::RunPeriodic(std::chrono::milliseconds period_ms) {
   bool runs_global_periodic = (shard_id() == 0);  // Only shard 0 runs global periodic.
   unsigned global_count = 0;
   int64_t last_stats_time = time(nullptr);
+  MemoryBudgetManager budget_manager;
 
   while (true) {
     Heartbeat();
@@ -674,6 +714,9 @@ void EngineShard::RunPeriodic(std::chrono::milliseconds period_ms) {
               rss_mem_peak.store(total_rss, memory_order_relaxed);
           }
         }
+
+        if (GetFlag(FLAGS_shard_memory_rebalance))
+          budget_manager.Rebalance(max_memory_limit, ProcessUsedMemory(sum), &cached_stats);
       }
     }
   }
@@ -686,7 +729,8 @@ void EngineShard::CacheStats() {
   // Used memory for this shard.
   size_t used_mem = UsedMemory();
   cached_stats[db_slice_.shard_id()].used_memory.store(used_mem, memory_order_relaxed);
-  ssize_t free_mem = max_memory_limit - used_mem_current.load(memory_order_relaxed);
+  ssize_t free_mem =
+      max_memory_limit - ProcessUsedMemory(used_mem_current.load(memory_order_relaxed));
 
   size_t entries = 0;
   size_t table_memory = 0;
@@ -700,12 +744,25 @@ void EngineShard::CacheStats() {
   size_t obj_memory = table_memory <= used_mem ? used_mem - table_memory : 0;
 
   size_t bytes_per_obj = entries > 0 ? obj_memory / entries : 0;
-  db_slice_.SetCachedParams(free_mem / shard_set->size(), bytes_per_obj);
+
+  // With rebalancing every shard is bound by its own limit, otherwise the free memory is
+  // split evenly.
+  size_t memory_limit = MemoryLimit();
+  ssize_t budget = GetFlag(FLAGS_shard_memory_rebalance)
+                       ? ssize_t(memory_limit) - ssize_t(used_mem)
+                       : free_mem / ssize_t(shard_set->size());
+  db_slice_.SetCachedParams(budget, bytes_per_obj, memory_limit);
 }
 
 size_t EngineShard::UsedMemory() const {
-  return mi_resource_.used() + zmalloc_used_memory_tl + SmallString::UsedThreadLocal() +
-         search_indices()->GetUsedMemory();
+  return mi_resource_.used() + table_resource_.used() + zmalloc_used_memory_tl +
+         SmallString::UsedThreadLocal() + search_indices()->GetUsedMemory();
+}
+
+size_t EngineShard::MemoryLimit() const {
+  if (!GetFlag(FLAGS_shard_memory_rebalance))
+    return max_memory_limit / shard_set->size();
+  return cached_stats[shard_id()].memory_share.load(memory_order_relaxed) * max_memory_limit;
 }
 
 BlockingController* EngineShard::EnsureBlockingController() {
@@ -845,6 +902,8 @@ size_t GetTieredFileLimit(size_t threads) {
 void EngineShardSet::Init(uint32_t sz, bool update_db_time) {
   CHECK_EQ(0u, size());
   cached_stats.resize(sz);
+  for (auto& stats : cached_stats)
+    stats.memory_share.store(1.0 / sz, memory_order_relaxed);
   shard_queue_.resize(sz);
 
   size_t max_shard_file_size = GetTieredFileLimit(sz);
@@ -877,6 +936,32 @@ void EngineShardSet::TEST_EnableCacheMode() {
   RunBriefInParallel([](EngineShard* shard) { shard->db_slice().TEST_EnableCacheMode(); });
 }
 
+void MemoryBudgetManager::Rebalance(size_t max_memory, uint64_t process_used,
+                                    vector<EngineShardSet::CachedStats>* stats) {
+  if (max_memory == 0)
+    return;
+
+  const size_t num_shards = stats->size();
+  const double free_mem = max(0.0, double(max_memory) - double(process_used));
+  prev_used_.resize(num_shards, 0);
+
+  vector<double> demand(num_shards);
+  double total_demand = 0;
+  for (size_t i = 0; i < num_shards; ++i) {
+    uint64_t used = (*stats)[i].used_memory.load(memory_order_relaxed);
+    demand[i] = used + (used > prev_used_[i] ? used - prev_used_[i] : 0);
+    total_demand += demand[i];
+    prev_used_[i] = used;
+  }
+
+  for (size_t i = 0; i < num_shards; ++i) {
+    double weight = total_demand > 0 ? demand[i] / total_demand : 1.0 / num_shards;
+    weight = (1 - kEvenFactor) * weight + kEvenFactor / num_shards;
+    double limit = prev_used_[i] + free_mem * weight;
+    (*stats)[i].memory_share.store(min(limit / max_memory, 1.0), memory_order_relaxed);
+  }
+}
+
 ShardId Shard(string_view v, ShardId shard_num) {
   if (cluster::IsClusterShardedByTag()) {
     v = LockTagOptions::instance().Tag(v);
@@ -12,6 +12,7 @@ extern "C" {
 #include <absl/container/flat_hash_map.h>
 #include <xxhash.h>
 
+#include "core/huge_page_resource.h"
 #include "core/mi_memory_resource.h"
 #include "core/task_queue.h"
 #include "core/tx_queue.h"
@@ -40,6 +41,13 @@ class EngineShard {
     uint64_t tx_immediate_total = 0;
     uint64_t tx_ooo_total = 0;
 
+    // Transactions woken by BlockingController, the number of wakeup passes that woke them
+    // and the total time from notification until they finished running on the shard. Waiters
+    // served right in the wakeup pass add no latency.
+    uint64_t blocked_wakeup_total = 0;
+    uint64_t blocked_wakeup_batch_total = 0;
+    uint64_t blocked_wakeup_latency_usec = 0;
+
     Stats& operator+=(const Stats&);
   };
 
@@ -72,6 +80,15 @@ class EngineShard {
     return &mi_resource_;
   }
 
+  // Memory resource for the hash tables of the db slice, backed by huge pages if configured.
+  PMR_NS::memory_resource* table_memory_resource() {
+    return &table_resource_;
+  }
+
+  const HugePageMemoryResource::Stats& table_huge_page_stats() const {
+    return table_resource_.stats();
+  }
+
   TaskQueue* GetFiberQueue() {
     return &queue_;
   }
@@ -113,6 +130,10 @@ class EngineShard {
   // Returns used memory for this shard.
   size_t UsedMemory() const;
 
+  // The part of max_memory_limit this shard may use. It is rebalanced periodically according
+  // to the demand of the shards, unless shard_memory_rebalance is disabled.
+  size_t MemoryLimit() const;
+
   TieredStorage* tiered_storage() {
     return tiered_storage_.get();
   }
@@ -234,6 +255,7 @@ class EngineShard {
 
   TxQueue txq_;
   MiMemoryResource mi_resource_;
+  HugePageMemoryResource table_resource_;
   DbSlice db_slice_;
 
   Stats stats_;
@@ -267,11 +289,13 @@ class EngineShardSet {
  public:
   struct CachedStats {
     std::atomic_uint64_t used_memory;
+    std::atomic<double> memory_share;  // part of max_memory_limit assigned to the shard
 
-    CachedStats() : used_memory(0) {
+    CachedStats() : used_memory(0), memory_share(0) {
     }
 
-    CachedStats(const CachedStats& o) : used_memory(o.used_memory.load()) {
+    CachedStats(const CachedStats& o)
+        : used_memory(o.used_memory.load()), memory_share(o.memory_share.load()) {
     }
   };
 
@@ -346,6 +370,25 @@ class EngineShardSet {
   std::vector<TaskQueue*> shard_queue_;
 };
 
+// Splits max_memory between the shards. Only the memory that the process as a whole does not
+// use is distributed: connections, IO and replication buffers live outside of the shard heaps,
+// but count against max_memory as well. The free memory is divided according to the demand of
+// every shard: its used memory plus its recent growth, so that shards with skewed load get the
+// headroom that the others do not use. A part of the free memory is split evenly, so that idle
+// shards can still absorb writes until the next rebalance.
+class MemoryBudgetManager {
+ public:
+  // process_used is the memory used by the whole process, stats hold the used memory of every
+  // shard and receive its memory_share.
+  void Rebalance(size_t max_memory, uint64_t process_used,
+                 std::vector<EngineShardSet::CachedStats>* stats);
+
+ private:
+  static constexpr double kEvenFactor = 0.25;
+
+  std::vector<uint64_t> prev_used_;
+};
+
 template <typename U, typename P>
 void EngineShardSet::RunBriefInParallel(U&& func, P&& pred) const {
   util::fb2::BlockingCounter bc{0};
@@ -87,5 +87,30 @@ TEST_F(RoundRobinSharderTest, RoundRobinShard) {
   }
 }
 
+TEST(MemoryBudgetManagerTest, Rebalance) {
+  vector<EngineShardSet::CachedStats> stats(2);
+  stats[0].used_memory = 600;
+  stats[1].used_memory = 200;
+
+  // The process uses 200 bytes outside of the shards, only the rest is split between them.
+  MemoryBudgetManager manager;
+  manager.Rebalance(2000, 1000, &stats);
+  double share0 = stats[0].memory_share.load(), share1 = stats[1].memory_share.load();
+  EXPECT_DOUBLE_EQ((share0 + share1) * 2000, 1800);
+  EXPECT_GT(share0 * 2000 - 600, share1 * 2000 - 200);  // the busier shard gets more headroom
+  EXPECT_GT(share1 * 2000, 200);
+
+  // A growing shard gets a larger part of the free memory.
+  stats[1].used_memory = 400;
+  manager.Rebalance(2000, 1200, &stats);
+  EXPECT_GT(stats[1].memory_share.load(), share1);
+  EXPECT_DOUBLE_EQ((stats[0].memory_share.load() + stats[1].memory_share.load()) * 2000, 1800);
+
+  // Without free memory the shards are bound by what they use.
+  manager.Rebalance(2000, 2500, &stats);
+  EXPECT_DOUBLE_EQ(stats[0].memory_share.load(), 0.3);
+  EXPECT_DOUBLE_EQ(stats[1].memory_share.load(), 0.2);
+}
+
 }  // namespace
 }  // namespace dfly
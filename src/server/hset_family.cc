@@ -49,6 +49,7 @@ bool IsGoodForListpack(CmdArgList args, const uint8_t* lp) {
 using container_utils::GetStringMap;
 using container_utils::LpFind;
 using container_utils::LpGetView;
+using container_utils::ReadSlice;
 
 pair<uint8_t*, bool> LpDelete(uint8_t* lp, string_view field) {
   uint8_t* fptr = lpFirst(lp);
@@ -530,35 +531,29 @@ OpResult<string> OpGet(const OpArgs& op_args, string_view key, string_view field
   return string(it->second, sdslen(it->second));
 }
 
-OpResult<vector<string>> OpGetAll(const OpArgs& op_args, string_view key, uint8_t mask) {
+OpStatus OpGetAll(const OpArgs& op_args, string_view key, uint8_t mask, ReadSlice* slice) {
   auto& db_slice = op_args.shard->db_slice();
   auto it_res = db_slice.FindReadOnly(op_args.db_cntx, key, OBJ_HASH);
   if (!it_res) {
     if (it_res.status() == OpStatus::KEY_NOTFOUND)
-      return vector<string>{};
+      return OpStatus::OK;
     return it_res.status();
   }
 
   const PrimeValue& pv = (*it_res)->second;
 
-  vector<string> res;
-  bool keyval = (mask == (FIELDS | VALUES));
-
   if (pv.Encoding() == kEncodingListPack) {
     uint8_t* lp = (uint8_t*)pv.RObjPtr();
-    res.resize(lpLength(lp) / (keyval ? 1 : 2));
-
     uint8_t* fptr = lpFirst(lp);
     uint8_t intbuf[LP_INTBUF_SIZE];
 
-    unsigned index = 0;
     while (fptr) {
       if (mask & FIELDS) {
-        res[index++] = LpGetView(fptr, intbuf);
+        slice->Add(LpGetView(fptr, intbuf));
       }
       fptr = lpNext(lp, fptr);
       if (mask & VALUES) {
-        res[index++] = LpGetView(fptr, intbuf);
+        slice->Add(LpGetView(fptr, intbuf));
       }
       fptr = lpNext(lp, fptr);
     }
@@ -566,19 +561,46 @@ OpResult<vector<string>> OpGetAll(const OpArgs& op_args, string_view key, uint8_
     DCHECK_EQ(pv.Encoding(), kEncodingStrMap2);
     StringMap* sm = GetStringMap(pv, op_args.db_cntx);
 
-    res.reserve(sm->UpperBoundSize() * (keyval ? 2 : 1));
-    for (const auto& k_v : *sm) {
-      if (mask & FIELDS) {
-        res.emplace_back(k_v.first, sdslen(k_v.first));
-      }
+    // Expired fields are removed while reading, so the size is known only after reading all.
+    if (pv.HasExpire() || sm->ExpirationUsed()) {
+      for (const auto& k_v : *sm) {
+        if (mask & FIELDS) {
+          slice->Add(string_view{k_v.first, sdslen(k_v.first)});
+        }
 
-      if (mask & VALUES) {
-        res.emplace_back(k_v.second, sdslen(k_v.second));
+        if (mask & VALUES) {
+          slice->Add(string_view{k_v.second, sdslen(k_v.second)});
+        }
       }
+    } else {
+      // The cursor is the scan cursor of the map.
+      auto scan_cb = [&](const void* obj) {
+        sds field = (sds)obj;
+        sds val = (sds)absl::little_endian::Load64(field + sdslen(field) + 1);
+        if (mask & FIELDS) {
+          slice->Add(string_view{field, sdslen(field)});
+        }
+
+        if (mask & VALUES) {
+          slice->Add(string_view{val, sdslen(val)});
+        }
+      };
+
+      bool keyval = (mask == (FIELDS | VALUES));
+      slice->total = sm->UpperBoundSize() * (keyval ? 2 : 1);
+      uint64_t cursor = slice->cursor;
+      do {
+        cursor = sm->Scan(cursor, scan_cb);
+      } while (cursor && !slice->Exhausted());
+
+      slice->cursor = cursor;
+      slice->done = cursor == 0;
+      return OpStatus::OK;
     }
   }
 
-  return res;
+  slice->total = slice->size();
+  return OpStatus::OK;
 }
 
 OpResult<size_t> OpStrLen(const OpArgs& op_args, string_view key, string_view field) {
@@ -688,6 +710,9 @@ OpResult<uint32_t> OpSet(const OpArgs& op_args, string_view key, CmdArgList valu
 
       created += unsigned(added);
     }
+
+    if (op_sp.ttl != UINT32_MAX)
+      db_slice.TrackMemberExpiry(op_args.db_cntx.db_index, key, pv);
   }
 
   op_args.shard->search_indices()->AddDoc(key, op_args.db_cntx, pv);
@@ -698,19 +723,16 @@ OpResult<uint32_t> OpSet(const OpArgs& op_args, string_view key, CmdArgList valu
 void HGetGeneric(CmdArgList args, ConnectionContext* cntx, uint8_t getall_mask) {
   string_view key = ArgS(args, 0);
 
-  auto cb = [&](Transaction* t, EngineShard* shard) {
-    return OpGetAll(t->GetOpArgs(shard), key, getall_mask);
+  auto cb = [&](const OpArgs& op_args, ReadSlice* slice) {
+    return OpGetAll(op_args, key, getall_mask, slice);
   };
 
-  OpResult<vector<string>> result = cntx->transaction->ScheduleSingleHopT(std::move(cb));
-
   auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
-  if (result) {
-    bool is_map = (getall_mask == (VALUES | FIELDS));
-    rb->SendStringArr(absl::Span<const string>{*result},
-                      is_map ? RedisReplyBuilder::MAP : RedisReplyBuilder::ARRAY);
-  } else {
-    cntx->SendError(result.status());
+  bool is_map = (getall_mask == (VALUES | FIELDS));
+  OpStatus status = container_utils::ScheduleSlicedRead(
+      cntx->transaction, cb, rb, is_map ? RedisReplyBuilder::MAP : RedisReplyBuilder::ARRAY);
+  if (status != OpStatus::OK) {
+    cntx->SendError(status);
   }
 }
 
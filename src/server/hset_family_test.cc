@@ -4,11 +4,15 @@
 
 #include "server/hset_family.h"
 
+#include <absl/container/flat_hash_map.h>
+#include <absl/flags/reflection.h>
+
 extern "C" {
 #include "redis/listpack.h"
 #include "redis/sds.h"
 }
 
+#include "base/flags.h"
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "facade/facade_test.h"
@@ -20,6 +24,8 @@ using namespace util;
 using namespace boost;
 using namespace facade;
 
+ABSL_DECLARE_FLAG(uint32_t, cmd_slice_max_bytes);
+
 namespace dfly {
 
 class HSetFamilyTest : public BaseFamilyTest {
@@ -315,6 +321,22 @@ TEST_F(HSetFamilyTest, HSetEx) {
   EXPECT_THAT(Run({"HGET", "k", "f"}), ArgType(RespExpr::NIL));
 }
 
+TEST_F(HSetFamilyTest, ActiveFieldExpiry) {
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(CheckedInt({"HSETEX", "key", "10", absl::StrCat("k", i), "v"}), 1);
+  }
+  EXPECT_EQ(CheckedInt({"HSET", "key", "keep", "v"}), 1);
+  EXPECT_EQ(CheckedInt({"HSETEX", "gone", "10", "f", "v"}), 1);
+
+  AdvanceTime(10'000);
+  shard_set->TEST_EnableHeartbeat();
+
+  // Fields are deleted without accessing the hashes
+  ExpectConditionWithinTimeout([&] { return GetMetrics().events.expired_members == 101; });
+  EXPECT_THAT(Run({"HLEN", "key"}), IntArg(1));
+  EXPECT_THAT(Run({"EXISTS", "gone"}), IntArg(0));
+}
+
 TEST_F(HSetFamilyTest, TriggerConvertToStrMap) {
   const int kElements = 200;
   // Enough for IsGoodForListpack to become false
@@ -356,4 +378,46 @@ TEST_F(HSetFamilyTest, RandomField1NotExpired) {
   EXPECT_THAT(Run({"HRANDFIELD", "key"}), "keep");
 }
 
+TEST_F(HSetFamilyTest, HGetAllSlicedConcurrentWrites) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_cmd_slice_max_bytes, 64);
+
+  vector<string> args{"hset", "key"};
+  for (unsigned i = 0; i < 1000; ++i) {
+    args.push_back(absl::StrCat("f", i));
+    args.push_back(absl::StrCat("v", i));
+  }
+  Run(absl::MakeSpan(args));
+
+  // Writes to the key wait for the sliced read to finish, writes to other keys run between
+  // the slices.
+  atomic_bool done = false;
+  auto writer = pp_->at(1)->LaunchFiber([&] {
+    for (unsigned i = 0; !done; ++i) {
+      Run("writer", {"hset", "key", absl::StrCat("w", i), "x"});
+      Run("writer", {"hset", "other", absl::StrCat("w", i), "x"});
+    }
+  });
+
+  for (unsigned round = 0; round < 5; ++round) {
+    auto resp = Run({"hgetall", "key"});
+    ASSERT_EQ(resp.type, RespExpr::ARRAY);
+    auto vec = resp.GetVec();
+    ASSERT_EQ(vec.size() % 2, 0u);
+
+    // No field is missing or repeated, and the written fields are a prefix of the writes.
+    absl::flat_hash_map<string, string> fields;
+    for (size_t i = 0; i < vec.size(); i += 2)
+      ASSERT_TRUE(fields.emplace(vec[i].GetString(), vec[i + 1].GetString()).second);
+    ASSERT_GE(fields.size(), 1000u);
+    for (unsigned i = 0; i < 1000; ++i)
+      ASSERT_EQ(fields[absl::StrCat("f", i)], absl::StrCat("v", i));
+    for (unsigned i = 0; i < fields.size() - 1000; ++i)
+      ASSERT_EQ(fields[absl::StrCat("w", i)], "x");
+  }
+
+  done = true;
+  writer.Join();
+}
+
 }  // namespace dfly
@@ -4,6 +4,13 @@
 
 #include "server/journal/journal.h"
 
+#include <absl/flags/flag.h>
+#include <absl/strings/match.h>
+#include <absl/strings/numbers.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+
+#include <algorithm>
 #include <filesystem>
 
 #include "base/logging.h"
@@ -11,6 +18,8 @@
 #include "server/journal/journal_slice.h"
 #include "server/server_state.h"
 
+ABSL_DECLARE_FLAG(dfly::journal::FsyncMode, journal_fsync);
+
 namespace dfly {
 namespace journal {
 
@@ -28,6 +37,9 @@ thread_local JournalSlice journal_slice;
 Journal::Journal() {
 }
 
+Journal::~Journal() {
+}
+
 void Journal::StartInThread() {
   journal_slice.Init(unsigned(ProactorBase::me()->GetPoolIndex()));
 
@@ -35,6 +47,58 @@ void Journal::StartInThread() {
   EngineShard* shard = EngineShard::tlocal();
   if (shard) {
     shard->set_journal(this);
+    if (IsPersistent()) {
+      journal_slice.OpenFile(dir_, generation_.load(memory_order_relaxed),
+                             &progress_[shard->shard_id()]);
+    }
+  }
+}
+
+void Journal::SetPersistence(string dir, uint64_t generation) {
+  dir_ = std::move(dir);
+  generation_.store(generation, memory_order_relaxed);
+  sync_durable_ = absl::GetFlag(FLAGS_journal_fsync) == FsyncMode::ALWAYS;
+  num_shards_ = shard_set->size();
+  progress_.reset(new FileProgress[num_shards_]);
+}
+
+bool Journal::AwaitDurable(unsigned sid) {
+  DCHECK_LT(sid, num_shards_);
+  FileProgress& progress = progress_[sid];
+  LSN lsn = progress.recorded.load(memory_order_acquire);
+  progress.ec.await([&] {
+    return progress.failed.load(memory_order_acquire) ||
+           progress.written.load(memory_order_acquire) >= lsn;
+  });
+  return !progress.failed.load(memory_order_acquire);
+}
+
+bool Journal::HasFileError() const {
+  for (unsigned i = 0; i < num_shards_; ++i) {
+    if (progress_[i].failed.load(memory_order_relaxed))
+      return true;
+  }
+  return false;
+}
+
+uint64_t Journal::NewGeneration() {
+  return generation_.fetch_add(1, memory_order_relaxed) + 1;
+}
+
+void Journal::RemoveFilesBefore(uint64_t generation) {
+  auto files = ListJournalFiles(dir_);
+  if (!files) {
+    LOG(ERROR) << "Could not list journal files " << files.error().message();
+    return;
+  }
+
+  for (const JournalFile& file : *files) {
+    if (file.generation >= generation)
+      continue;
+
+    error_code ec;
+    fs::remove(file.path, ec);
+    LOG_IF(ERROR, ec) << "Could not remove journal file " << file.path << " " << ec.message();
   }
 }
 
@@ -47,6 +111,7 @@ error_code Journal::Close() {
 
   lock_guard lk(state_mu_);
   auto close_cb = [&](auto*) {
+    journal_slice.CloseFile();
     ServerState::tlocal()->set_journal(nullptr);
     EngineShard* shard = EngineShard::tlocal();
     if (shard) {
@@ -88,5 +153,46 @@ void Journal::RecordEntry(TxId txid, Op opcode, DbIndex dbid, unsigned shard_cnt
   journal_slice.AddLogRecord(Entry{txid, opcode, dbid, shard_cnt, slot, std::move(payload)}, await);
 }
 
+void Journal::RotateFile(uint64_t generation) {
+  journal_slice.RotateFile(generation);
+}
+
+string JournalFileName(unsigned shard, uint64_t generation) {
+  return absl::StrCat("journal-", absl::Dec(shard, absl::kZeroPad4), "-", generation, ".log");
+}
+
+io::Result<vector<JournalFile>> ListJournalFiles(string_view dir) {
+  vector<JournalFile> res;
+  error_code ec;
+  fs::directory_iterator it{fs::path{dir}, ec};
+  if (ec == errc::no_such_file_or_directory)
+    return res;
+
+  for (; !ec && it != fs::directory_iterator{}; it.increment(ec)) {
+    string name = it->path().filename().string();
+    if (!absl::StartsWith(name, "journal-") || !absl::EndsWith(name, ".log"))
+      continue;
+
+    string_view stem{name};
+    stem.remove_suffix(4);
+    vector<string_view> parts = absl::StrSplit(stem, '-');
+    JournalFile file;
+    if (parts.size() != 3 || !absl::SimpleAtoi(parts[1], &file.shard) ||
+        !absl::SimpleAtoi(parts[2], &file.generation))
+      continue;
+
+    file.path = it->path().string();
+    res.push_back(std::move(file));
+  }
+
+  if (ec)
+    return nonstd::make_unexpected(ec);
+
+  sort(res.begin(), res.end(), [](const JournalFile& l, const JournalFile& r) {
+    return tie(l.shard, l.generation) < tie(r.shard, r.generation);
+  });
+  return res;
+}
+
 }  // namespace journal
 }  // namespace dfly
@@ -4,6 +4,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/io.h"
 #include "server/journal/types.h"
 #include "util/proactor_pool.h"
 
@@ -13,16 +19,46 @@ class Transaction;
 
 namespace journal {
 
+struct FileProgress;
+
 class Journal {
  public:
   using Span = absl::Span<const std::string_view>;
 
   Journal();
+  ~Journal();
 
   void StartInThread();
 
   std::error_code Close();
 
+  // Persists the journal in dir: every shard appends its entries to its own file of the
+  // current generation. Together with the last snapshot the files restore the dataset after a
+  // restart. Must be called before the journal is started.
+  void SetPersistence(std::string dir, uint64_t generation);
+
+  bool IsPersistent() const {
+    return !dir_.empty();
+  }
+
+  // journal_fsync=always: write commands are acknowledged only once they are durable.
+  bool IsSyncDurable() const {
+    return sync_durable_;
+  }
+
+  // Waits until the entries recorded so far by shard sid are written to its journal file.
+  // Can be called from any thread. Returns false if the file can not be written.
+  bool AwaitDurable(unsigned sid);
+
+  // Returns true if writing any of the journal files failed. The journal is not persisted
+  // anymore, so write commands are refused. Can be called from any thread.
+  bool HasFileError() const;
+
+  // Starts a new generation when a snapshot is taken. The files of older generations are
+  // covered by the snapshot and can be removed with RemoveFilesBefore once it is saved.
+  uint64_t NewGeneration();
+  void RemoveFilesBefore(uint64_t generation);
+
   //******* The following functions must be called in the context of the owning shard *********//
 
   uint32_t RegisterOnChange(ChangeCallback cb);
@@ -37,9 +73,29 @@ class Journal {
   void RecordEntry(TxId txid, Op opcode, DbIndex dbid, unsigned shard_cnt,
                    std::optional<cluster::SlotId> slot, Entry::Payload payload, bool await);
 
+  // Entries recorded from now on by the shard go to the file of the given generation.
+  void RotateFile(uint64_t generation);
+
  private:
   mutable util::fb2::Mutex state_mu_;
+
+  std::string dir_;
+  std::atomic_uint64_t generation_{0};
+  bool sync_durable_ = false;
+  std::unique_ptr<FileProgress[]> progress_;  // per shard
+  unsigned num_shards_ = 0;
 };
 
+struct JournalFile {
+  unsigned shard;
+  uint64_t generation;
+  std::string path;
+};
+
+std::string JournalFileName(unsigned shard, uint64_t generation);
+
+// Returns the journal files in dir, ordered by shard and generation.
+io::Result<std::vector<JournalFile>> ListJournalFiles(std::string_view dir);
+
 }  // namespace journal
 }  // namespace dfly
@@ -14,11 +14,27 @@
 
 #include "base/function2.hpp"
 #include "base/logging.h"
+#include "server/error.h"
+#include "server/journal/journal.h"
 #include "server/journal/serializer.h"
 
 ABSL_FLAG(uint32_t, shard_repl_backlog_len, 1 << 10,
           "The length of the circular replication log per shard");
 
+ABSL_FLAG(dfly::journal::FsyncMode, journal_fsync, dfly::journal::FsyncMode::PERIODIC,
+          "When the journal files are made durable: 'always' - every batch of entries is "
+          "written synchronously as soon as it is recorded and write commands are acknowledged "
+          "only once their entries are durable, 'periodic' - the entries are written "
+          "synchronously every journal_fsync_interval_ms, 'no' - the entries are written "
+          "every journal_fsync_interval_ms and flushing is left to the operating system");
+
+ABSL_FLAG(uint32_t, journal_fsync_interval_ms, 1000,
+          "Interval of writing the journal files, unless journal_fsync is 'always'");
+
+ABSL_FLAG(uint64_t, journal_max_pending_bytes, 64u << 20,
+          "Maximum size of the journal entries of a shard that wait to be written to the file. "
+          "Commands that exceed it are delayed until the pending entries are written.");
+
 namespace dfly {
 namespace journal {
 using namespace std;
@@ -28,10 +44,6 @@ namespace fs = std::filesystem;
 namespace {
 
 /*
-string ShardName(std::string_view base, unsigned index) {
-  return absl::StrCat(base, "-", absl::Dec(index, absl::kZeroPad4), ".log");
-}
-
 uint32_t NextPowerOf2(uint32_t x) {
   if (x < 2) {
     return 1;
@@ -42,8 +54,47 @@ uint32_t NextPowerOf2(uint32_t x) {
 
 */
 
+error_code CreateDir(const fs::path& dir_path) {
+  error_code ec;
+  fs::status(dir_path, ec);
+  if (ec == errc::no_such_file_or_directory)
+    fs::create_directories(dir_path, ec);
+  return ec;
+}
+
 }  // namespace
 
+bool AbslParseFlag(std::string_view in, FsyncMode* mode, std::string* err) {
+  if (in == "always") {
+    *mode = FsyncMode::ALWAYS;
+    return true;
+  }
+  if (in == "periodic") {
+    *mode = FsyncMode::PERIODIC;
+    return true;
+  }
+  if (in == "no") {
+    *mode = FsyncMode::NO;
+    return true;
+  }
+
+  *err = absl::StrCat("Unknown value ", in, " for journal_fsync flag");
+  return false;
+}
+
+std::string AbslUnparseFlag(FsyncMode mode) {
+  switch (mode) {
+    case FsyncMode::ALWAYS:
+      return "always";
+    case FsyncMode::PERIODIC:
+      return "periodic";
+    case FsyncMode::NO:
+      return "no";
+  }
+  DCHECK(false) << "Unknown journal_fsync flag value " << int(mode);
+  return "periodic";
+}
+
 #define CHECK_EC(x)                                                                 \
   do {                                                                              \
     auto __ec$ = (x);                                                               \
@@ -54,7 +105,7 @@ JournalSlice::JournalSlice() {
 }
 
 JournalSlice::~JournalSlice() {
-  // CHECK(!shard_file_);
+  DCHECK(!HasFile());
 }
 
 void JournalSlice::Init(unsigned index) {
@@ -65,66 +116,121 @@ void JournalSlice::Init(unsigned index) {
   ring_buffer_.emplace(2);
 }
 
-#if 0
-std::error_code JournalSlice::Open(std::string_view dir) {
-  CHECK(!shard_file_);
+void JournalSlice::OpenFile(string_view dir, uint64_t generation, FileProgress* progress) {
   DCHECK_NE(slice_index_, UINT32_MAX);
+  if (HasFile())
+    return;
 
-  fs::path dir_path;
-
-  if (dir.empty()) {
-  } else {
-    dir_path = dir;
-    error_code ec;
-
-    fs::file_status dir_status = fs::status(dir_path, ec);
-    if (ec) {
-      if (ec == errc::no_such_file_or_directory) {
-        fs::create_directory(dir_path, ec);
-        dir_status = fs::status(dir_path, ec);
-      }
-      if (ec)
-        return ec;
-    }
-    // LOG(INFO) << int(dir_status.type());
-  }
-
-  dir_path.append(ShardName("journal", slice_index_));
-  shard_path_ = dir_path;
+  dir_ = dir;
+  generation_ = generation;
+  closing_ = false;
+  status_ec_.clear();
+  progress_ = progress;
+  progress_->recorded.store(lsn_ - 1, memory_order_relaxed);
+  progress_->written.store(lsn_ - 1, memory_order_relaxed);
+  progress_->failed.store(false, memory_order_relaxed);
+  max_pending_bytes_ = absl::GetFlag(FLAGS_journal_max_pending_bytes);
 
   // For file integrity guidelines see:
   // https://lwn.net/Articles/457667/
   // https://www.evanjones.ca/durability-filesystem.html
-  // NOTE: O_DSYNC is omitted.
-  constexpr auto kJournalFlags = O_CLOEXEC | O_CREAT | O_TRUNC | O_RDWR;
-  io::Result<unique_ptr<LinuxFile>> res = OpenLinux(shard_path_, kJournalFlags, 0666);
-  if (!res) {
-    return res.error();
-  }
-  DVLOG(1) << "Opened journal " << shard_path_;
+  // With O_DSYNC every write completes only once its data is durable, so a batch is committed
+  // with a single io_uring write and no separate fsync.
+  file_flags_ = O_CLOEXEC | O_CREAT | O_TRUNC | O_WRONLY;
+  if (absl::GetFlag(FLAGS_journal_fsync) != FsyncMode::NO)
+    file_flags_ |= O_DSYNC;
 
-  shard_file_ = std::move(res).value();
-  file_offset_ = 0;
-  status_ec_.clear();
+  flush_fb_ = fb2::Fiber("journal_flush", &JournalSlice::FlushFb, this);
+}
 
-  return error_code{};
+void JournalSlice::RotateFile(uint64_t generation) {
+  DCHECK_GT(generation, generation_);
+  generation_ = generation;
 }
 
-error_code JournalSlice::Close() {
-  VLOG(1) << "JournalSlice::Close";
+void JournalSlice::CloseFile() {
+  if (!HasFile())
+    return;
 
-  CHECK(shard_file_);
-  lameduck_ = true;
+  VLOG(1) << "JournalSlice::CloseFile";
+  closing_ = true;
+  flush_waker_.notifyAll();
+  flush_fb_.Join();
+}
 
-  auto ec = shard_file_->Close();
+void JournalSlice::FlushFb() {
+  const bool always = absl::GetFlag(FLAGS_journal_fsync) == FsyncMode::ALWAYS;
+  const auto interval = chrono::milliseconds(absl::GetFlag(FLAGS_journal_fsync_interval_ms));
+
+  while (true) {
+    // Entries recorded while the previous batch was being written are committed together.
+    if (always) {
+      flush_waker_.await([this] { return !pending_.empty() || closing_; });
+    } else {
+      flush_waker_.await_until(
+          [this] { return closing_ || pending_bytes_ > max_pending_bytes_; },
+          chrono::steady_clock::now() + interval);
+    }
 
-  DVLOG(1) << "Closing " << shard_path_;
-  LOG_IF(ERROR, ec) << "Error closing journal file " << ec;
-  shard_file_.reset();
+    bool closing = closing_;
+    vector<Batch> batches = std::move(pending_);
+    pending_.clear();
+    pending_bytes_ = 0;
+
+    for (Batch& batch : batches) {
+      if (status_ec_)
+        break;
+      if (auto ec = WriteBatch(&batch); ec) {
+        // Write commands are refused from now on, see Journal::HasFileError.
+        LOG(ERROR) << "Error writing journal file " << ec.message()
+                   << ", the journal is not persisted anymore";
+        status_ec_ = ec;
+        progress_->failed.store(true, memory_order_release);
+      } else if (batch.last_lsn) {
+        progress_->written.store(batch.last_lsn, memory_order_release);
+      }
+    }
+    progress_->ec.notifyAll();
 
-  return ec;
+    if (closing)
+      break;
+  }
+
+  if (file_) {
+    auto ec = file_->Close();
+    LOG_IF(ERROR, ec) << "Error closing journal file " << ec;
+    file_.reset();
+  }
+}
+
+error_code JournalSlice::WriteBatch(Batch* batch) {
+  if (!file_ || batch->generation != file_generation_) {
+    if (file_) {
+      RETURN_ON_ERR(file_->Close());
+      file_.reset();
+    }
+
+    fs::path path{dir_};
+    RETURN_ON_ERR(CreateDir(path));
+    path.append(JournalFileName(slice_index_, batch->generation));
+
+    io::Result<unique_ptr<fb2::LinuxFile>> res = fb2::OpenLinux(path.string(), file_flags_, 0666);
+    if (!res)
+      return res.error();
+
+    DVLOG(1) << "Opened journal " << path;
+    file_ = std::move(res).value();
+    file_generation_ = batch->generation;
+    file_offset_ = 0;
+  }
+
+  if (batch->data.empty())
+    return {};
+
+  RETURN_ON_ERR(file_->Write(io::Buffer(batch->data), file_offset_, 0));
+  file_offset_ += batch->data.size();
+  return {};
 }
-#endif
 
 bool JournalSlice::IsLSNInBuffer(LSN lsn) const {
   DCHECK(ring_buffer_);
@@ -177,14 +283,17 @@ void JournalSlice::AddLogRecord(const Entry& entry, bool await) {
     VLOG(2) << "Writing item [" << item->lsn << "]: " << entry.ToString();
   }
 
-#if 0
-    if (shard_file_) {
-      string line = absl::StrCat(item.lsn, " ", entry.txid, " ", entry.opcode, "\n");
-      error_code ec = shard_file_->Write(io::Buffer(line), file_offset_, 0);
-      CHECK_EC(ec);
-      file_offset_ += line.size();
-    }
-#endif
+  if (HasFile() && !item->data.empty() && !status_ec_) {
+    bool was_empty = pending_.empty();
+    if (was_empty || pending_.back().generation != generation_)
+      pending_.push_back(Batch{generation_, {}});
+    pending_.back().data.append(item->data);
+    pending_.back().last_lsn = item->lsn;
+    pending_bytes_ += item->data.size();
+    progress_->recorded.store(item->lsn, memory_order_release);
+    if (was_empty)
+      flush_waker_.notifyAll();
+  }
 
   // TODO: Remove the callbacks, replace with notifiers
   {
@@ -196,6 +305,13 @@ void JournalSlice::AddLogRecord(const Entry& entry, bool await) {
       k_v.second(*item, await);
     }
   }
+
+  // Backpressure: the shard waits until the flush fiber catches up with its file.
+  if (await && HasFile() && pending_bytes_ > max_pending_bytes_) {
+    flush_waker_.notifyAll();
+    progress_->ec.await(
+        [this] { return closing_ || status_ec_ || pending_bytes_ <= max_pending_bytes_; });
+  }
 }
 
 uint32_t JournalSlice::RegisterOnChange(ChangeCallback cb) {
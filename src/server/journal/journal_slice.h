@@ -4,17 +4,35 @@
 
 #pragma once
 
+#include <atomic>
 #include <optional>
 #include <shared_mutex>
+#include <string>
 #include <string_view>
 
 #include "base/ring_buffer.h"
 #include "server/common.h"
 #include "server/journal/types.h"
+#include "util/fibers/uring_file.h"
 
 namespace dfly {
 namespace journal {
 
+// When the journal files are made durable, see journal_fsync flag.
+enum class FsyncMode { ALWAYS, PERIODIC, NO };
+
+bool AbslParseFlag(std::string_view in, FsyncMode* mode, std::string* err);
+std::string AbslUnparseFlag(FsyncMode mode);
+
+// Progress of writing the journal file of a shard. Shared with other threads, which wait
+// for the entries of their transactions to become durable (journal_fsync=always).
+struct FileProgress {
+  std::atomic<LSN> recorded{0};  // last entry added to the file
+  std::atomic<LSN> written{0};   // last entry written to the file
+  std::atomic_bool failed{false};
+  util::fb2::EventCount ec;  // notified on every write and on failure
+};
+
 // Journal slice is present for both shards and io threads.
 class JournalSlice {
  public:
@@ -55,9 +73,47 @@ class JournalSlice {
   bool IsLSNInBuffer(LSN lsn) const;
   std::string_view GetEntry(LSN lsn) const;
 
+  // Starts appending the entries to the journal file of generation in dir. Entries are
+  // written in batches by a background fiber (group commit), with durability controlled by
+  // journal_fsync. The progress of the writes is published to progress.
+  // Calling it when the file is already open is a no-op.
+  void OpenFile(std::string_view dir, uint64_t generation, FileProgress* progress);
+
+  // Entries added from now on belong to the file of the new generation.
+  void RotateFile(uint64_t generation);
+
+  // Writes the pending entries and closes the file.
+  void CloseFile();
+
+  bool HasFile() const {
+    return flush_fb_.IsJoinable();
+  }
+
  private:
-  // std::string shard_path_;
-  // std::unique_ptr<LinuxFile> shard_file_;
+  // Entries of a single generation that were not written yet.
+  struct Batch {
+    uint64_t generation;
+    std::string data;
+    LSN last_lsn = 0;
+  };
+
+  void FlushFb();
+  std::error_code WriteBatch(Batch* batch);
+
+  std::string dir_;
+  std::unique_ptr<util::fb2::LinuxFile> file_;
+  uint64_t file_generation_ = 0;  // generation of file_
+  off_t file_offset_ = 0;
+  uint64_t generation_ = 0;  // generation of newly added entries
+  int file_flags_ = 0;
+  std::vector<Batch> pending_;
+  size_t pending_bytes_ = 0;
+  size_t max_pending_bytes_ = 0;
+  bool closing_ = false;
+  util::fb2::Fiber flush_fb_;
+  util::fb2::EventCount flush_waker_;
+  FileProgress* progress_ = nullptr;
+
   std::optional<base::RingBuffer<JournalItem>> ring_buffer_;
   base::IoBuf ring_serialize_buf_;
 
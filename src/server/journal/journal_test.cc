@@ -1,7 +1,10 @@
+#include <filesystem>
+#include <fstream>
 #include <string>
 
 #include "base/gtest.h"
 #include "base/logging.h"
+#include "server/journal/journal.h"
 #include "server/journal/serializer.h"
 #include "server/journal/types.h"
 #include "server/serializer_commons.h"
@@ -127,5 +130,31 @@ TEST(Journal, WriteRead) {
   }
 }
 
+TEST(Journal, ListFiles) {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::path{::testing::TempDir()} / "journal_list_files";
+  fs::remove_all(dir);
+
+  auto files = ListJournalFiles(dir.string());
+  ASSERT_TRUE(files.has_value());
+  EXPECT_TRUE(files->empty());
+
+  fs::create_directories(dir);
+  vector<pair<unsigned, uint64_t>> written = {{1, 3}, {0, 12}, {0, 2}, {1, 1}};
+  for (auto [shard, generation] : written)
+    ofstream{dir / JournalFileName(shard, generation)};
+  ofstream{dir / "journal-0001.log"};
+  ofstream{dir / "dump-summary.dfs"};
+
+  files = ListJournalFiles(dir.string());
+  ASSERT_TRUE(files.has_value());
+  vector<pair<unsigned, uint64_t>> found;
+  for (const auto& file : *files)
+    found.emplace_back(file.shard, file.generation);
+  EXPECT_THAT(found, ElementsAre(Pair(0, 2), Pair(0, 12), Pair(1, 1), Pair(1, 3)));
+
+  fs::remove_all(dir);
+}
+
 }  // namespace journal
 }  // namespace dfly
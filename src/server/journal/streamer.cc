@@ -45,8 +45,19 @@ JournalStreamer::~JournalStreamer() {
 }
 
 void JournalStreamer::Start(util::FiberSocketBase* dest, bool send_lsn) {
-  CHECK(dest_ == nullptr && dest != nullptr);
+  CHECK(dest_ == nullptr && sink_ == nullptr && dest != nullptr);
   dest_ = dest;
+  RegisterOnChange(send_lsn);
+}
+
+void JournalStreamer::StartWithSink(io::Sink* dest, bool send_lsn) {
+  CHECK(dest_ == nullptr && sink_ == nullptr && dest != nullptr);
+  sink_ = dest;
+  sink_writer_fb_ = fb2::Fiber("journal_sink", &JournalStreamer::SinkWriterFb, this);
+  RegisterOnChange(send_lsn);
+}
+
+void JournalStreamer::RegisterOnChange(bool send_lsn) {
   journal_cb_id_ =
       journal_->RegisterOnChange([this, send_lsn](const JournalItem& item, bool allow_await) {
         if (allow_await) {
@@ -78,6 +89,11 @@ void JournalStreamer::Cancel() {
   VLOG(1) << "JournalStreamer::Cancel";
   waker_.notifyAll();
   journal_->UnregisterOnChange(journal_cb_id_);
+  if (sink_) {
+    sink_stopped_ = true;
+    waker_.notifyAll();
+    sink_writer_fb_.JoinIfNeeded();
+  }
   WaitForInflightToComplete();
 }
 
@@ -110,7 +126,7 @@ void JournalStreamer::Write(std::string_view str) {
     }
     v[next_buf_id++] = IoVec(io::Bytes(buf, str.size()));
 
-    dest_->AsyncWrite(
+    AsyncWrite(
         v, next_buf_id,
         [buf0 = std::move(pending_buf_), buf, this, len = total_pending](std::error_code ec) {
           delete[] buf;
@@ -129,6 +145,36 @@ void JournalStreamer::Write(std::string_view str) {
   memcpy(pending_buf_.data() + tail, str.data(), str.size());
 }
 
+void JournalStreamer::AsyncWrite(const iovec* v, uint32_t len, WriteCb cb) {
+  if (dest_) {
+    dest_->AsyncWrite(v, len, std::move(cb));
+    return;
+  }
+
+  DCHECK_LE(len, 2u);
+  SinkWrite& write = sink_queue_.emplace_back();
+  std::copy(v, v + len, write.v);
+  write.len = len;
+  write.cb = std::move(cb);
+  waker_.notifyAll();
+}
+
+void JournalStreamer::SinkWriterFb() {
+  while (true) {
+    waker_.await([this] { return !sink_queue_.empty() || sink_stopped_; });
+    if (sink_queue_.empty())
+      return;
+
+    SinkWrite write = std::move(sink_queue_.front());
+    sink_queue_.pop_front();
+
+    // After cancellation the queued writes are only completed, so their buffers are released.
+    std::error_code ec = sink_stopped_ ? make_error_code(errc::operation_canceled)
+                                       : sink_->Write(write.v, write.len);
+    write.cb(ec);
+  }
+}
+
 void JournalStreamer::OnCompletion(std::error_code ec, size_t len) {
   DCHECK_GE(in_flight_bytes_, len);
 
@@ -138,9 +184,9 @@ void JournalStreamer::OnCompletion(std::error_code ec, size_t len) {
     cntx_->ReportError(ec);
   } else if (in_flight_bytes_ == 0 && !pending_buf_.empty() && !IsStopped()) {
     // If everything was sent but we have a pending buf, flush it.
-    io::Bytes src(pending_buf_);
-    in_flight_bytes_ += src.size();
-    dest_->AsyncWrite(src, [buf = std::move(pending_buf_), this](std::error_code ec) {
+    iovec v = IoVec(pending_buf_);
+    in_flight_bytes_ += v.iov_len;
+    AsyncWrite(&v, 1, [buf = std::move(pending_buf_), this](std::error_code ec) {
       OnCompletion(ec, buf.size());
     });
   }
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <deque>
+#include <functional>
+
 #include "server/db_slice.h"
 #include "server/journal/journal.h"
 #include "server/journal/serializer.h"
@@ -25,6 +28,10 @@ class JournalStreamer {
   // Register journal listener and start writer in fiber.
   virtual void Start(util::FiberSocketBase* dest, bool send_lsn);
 
+  // Same as Start, but for sinks without asynchronous writes, like shared memory rings.
+  // The writes are issued by a dedicated fiber in the order they were made.
+  void StartWithSink(io::Sink* dest, bool send_lsn);
+
   // Must be called on context cancellation for unblocking
   // and manual cleanup.
   virtual void Cancel();
@@ -52,6 +59,21 @@ class JournalStreamer {
   Context* cntx_;
 
  private:
+  using WriteCb = std::function<void(std::error_code)>;
+
+  struct SinkWrite {
+    iovec v[2];
+    uint32_t len;
+    WriteCb cb;
+  };
+
+  void RegisterOnChange(bool send_lsn);
+
+  // Writes to the socket or hands the write over to the sink writer fiber.
+  void AsyncWrite(const iovec* v, uint32_t len, WriteCb cb);
+
+  void SinkWriterFb();
+
   void OnCompletion(std::error_code ec, size_t len);
 
   bool IsStopped() const {
@@ -66,6 +88,11 @@ class JournalStreamer {
   time_t last_lsn_time_ = 0;
   util::fb2::EventCount waker_;
   uint32_t journal_cb_id_{0};
+
+  io::Sink* sink_ = nullptr;
+  std::deque<SinkWrite> sink_queue_;
+  bool sink_stopped_ = false;
+  util::fb2::Fiber sink_writer_fb_;
 };
 
 // Serializes existing DB as RESTORE commands, and sends updates as regular commands.
@@ -13,6 +13,7 @@ extern "C" {
 
 #include "base/flags.h"
 #include "base/logging.h"
+#include "core/ring_list.h"
 #include "server/blocking_controller.h"
 #include "server/command_registry.h"
 #include "server/conn_context.h"
@@ -59,26 +60,91 @@ ABSL_FLAG(int32_t, list_max_listpack_size, -2, "Maximum listpack size, default i
 
 ABSL_FLAG(int32_t, list_compress_depth, 0, "Compress depth of the list. Default is no compression");
 
+ABSL_FLAG(uint32_t, list_ring_max_len, 64,
+          "Lists up to this length are kept in a compact ring buffer encoding. "
+          "Longer lists are converted to quicklist. 0 disables the ring buffer encoding");
+ABSL_FLAG(uint32_t, list_ring_max_entry_size, 64,
+          "Maximum size of an element in a list with the ring buffer encoding");
+
 namespace dfly {
 
 using namespace std;
 using namespace facade;
 using absl::GetFlag;
 using time_point = Transaction::time_point;
+using container_utils::ReadSlice;
 
 namespace {
 
 quicklist* GetQL(const PrimeValue& mv) {
+  DCHECK_EQ(mv.Encoding(), OBJ_ENCODING_QUICKLIST);
   return (quicklist*)mv.RObjPtr();
 }
 
+RingList* GetRL(const PrimeValue& mv) {
+  DCHECK_EQ(mv.Encoding(), kEncodingRingList);
+  return (RingList*)mv.RObjPtr();
+}
+
+bool IsRingList(const PrimeValue& mv) {
+  return mv.Encoding() == kEncodingRingList;
+}
+
+size_t ListLen(const PrimeValue& mv) {
+  return IsRingList(mv) ? GetRL(mv)->Size() : quicklistCount(GetQL(mv));
+}
+
+quicklist* CreateQL() {
+  quicklist* ql = quicklistCreate();
+  quicklistSetOptions(ql, GetFlag(FLAGS_list_max_listpack_size),
+                      GetFlag(FLAGS_list_compress_depth));
+  return ql;
+}
+
+// New lists start with the ring buffer encoding and are converted to quicklist
+// once they outgrow it, see MaybeConvertToQL.
+void InitList(PrimeValue* pv) {
+  if (GetFlag(FLAGS_list_ring_max_len) > 0) {
+    pv->InitRobj(OBJ_LIST, kEncodingRingList, CompactObj::AllocateMR<RingList>());
+  } else {
+    pv->InitRobj(OBJ_LIST, OBJ_ENCODING_QUICKLIST, CreateQL());
+  }
+}
+
+// Converts a ring buffer list to quicklist if it can not hold add_cnt more elements
+// or an element of max_entry_len bytes. The conversion is one way.
+void MaybeConvertToQL(PrimeValue* pv, size_t add_cnt, size_t max_entry_len) {
+  if (!IsRingList(*pv))
+    return;
+
+  RingList* rl = GetRL(*pv);
+  if (rl->Size() + add_cnt <= GetFlag(FLAGS_list_ring_max_len) &&
+      max_entry_len <= GetFlag(FLAGS_list_ring_max_entry_size)) {
+    return;
+  }
+
+  quicklist* ql = CreateQL();
+  for (size_t i = 0; i < rl->Size(); ++i) {
+    string_view sv = rl->At(i);
+    quicklistPushTail(ql, const_cast<char*>(sv.data()), sv.size());
+  }
+  CompactObj::DeleteMR<RingList>(rl);
+  pv->InitRobj(OBJ_LIST, OBJ_ENCODING_QUICKLIST, ql);
+}
+
 void* listPopSaver(unsigned char* data, size_t sz) {
   return new string((char*)data, sz);
 }
 
 enum InsertParam { INSERT_BEFORE, INSERT_AFTER };
 
-string ListPop(ListDir dir, quicklist* ql) {
+string ListPop(ListDir dir, const PrimeValue& pv) {
+  if (IsRingList(pv)) {
+    RingList* rl = GetRL(pv);
+    return dir == ListDir::LEFT ? rl->PopFront() : rl->PopBack();
+  }
+
+  quicklist* ql = GetQL(pv);
   long long vlong;
   string* pop_str = nullptr;
 
@@ -98,6 +164,21 @@ string ListPop(ListDir dir, quicklist* ql) {
   return res;
 }
 
+// Pushes val into a list that can hold it, see MaybeConvertToQL.
+void ListPush(ListDir dir, string_view val, const PrimeValue& pv) {
+  if (IsRingList(pv)) {
+    RingList* rl = GetRL(pv);
+    if (dir == ListDir::LEFT)
+      rl->PushFront(val);
+    else
+      rl->PushBack(val);
+    return;
+  }
+
+  int pos = (dir == ListDir::LEFT) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+  quicklistPush(GetQL(pv), const_cast<char*>(val.data()), val.size(), pos);
+}
+
 optional<ListDir> ParseDir(string_view arg) {
   if (arg == "LEFT") {
     return ListDir::LEFT;
@@ -199,14 +280,13 @@ std::string OpBPop(Transaction* t, EngineShard* shard, std::string_view key, Lis
   CHECK(it_res) << t->DebugId() << " " << key;  // must exist and must be ok.
 
   auto it = it_res->it;
-  quicklist* ql = GetQL(it->second);
 
   absl::StrAppend(debugMessages.Next(), "OpBPop: ", key, " by ", t->DebugId());
 
-  std::string value = ListPop(dir, ql);
+  std::string value = ListPop(dir, it->second);
   it_res->post_updater.Run();
 
-  if (quicklistCount(ql) == 0) {
+  if (ListLen(it->second) == 0) {
     DVLOG(1) << "deleting key " << key << " " << t->DebugId();
     absl::StrAppend(debugMessages.Next(), "OpBPop Del: ", key, " by ", t->DebugId());
 
@@ -229,18 +309,14 @@ OpResult<string> OpMoveSingleShard(const OpArgs& op_args, string_view src, strin
     return src_res.status();
 
   auto src_it = src_res->it;
-  quicklist* src_ql = GetQL(src_it->second);
 
   if (src == dest) {  // simple case.
-    string val = ListPop(src_dir, src_ql);
-
-    int pos = (dest_dir == ListDir::LEFT) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
-    quicklistPush(src_ql, val.data(), val.size(), pos);
+    string val = ListPop(src_dir, src_it->second);
+    ListPush(dest_dir, val, src_it->second);
 
     return val;
   }
 
-  quicklist* dest_ql = nullptr;
   src_res->post_updater.Run();
   auto op_res = db_slice.AddOrFind(op_args.db_cntx, dest);
   RETURN_ON_BAD_STATUS(op_res);
@@ -251,26 +327,21 @@ OpResult<string> OpMoveSingleShard(const OpArgs& op_args, string_view src, strin
   src_it = src_res->it;
 
   if (dest_res.is_new) {
-    dest_ql = quicklistCreate();
-    quicklistSetOptions(dest_ql, GetFlag(FLAGS_list_max_listpack_size),
-                        GetFlag(FLAGS_list_compress_depth));
-    dest_res.it->second.InitRobj(OBJ_LIST, OBJ_ENCODING_QUICKLIST, dest_ql);
+    InitList(&dest_res.it->second);
     DCHECK(IsValid(src_it));
   } else {
     if (dest_res.it->second.ObjType() != OBJ_LIST)
       return OpStatus::WRONG_TYPE;
-
-    dest_ql = GetQL(dest_res.it->second);
   }
 
-  string val = ListPop(src_dir, src_ql);
-  int pos = (dest_dir == ListDir::LEFT) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
-  quicklistPush(dest_ql, val.data(), val.size(), pos);
+  string val = ListPop(src_dir, src_it->second);
+  MaybeConvertToQL(&dest_res.it->second, 1, val.size());
+  ListPush(dest_dir, val, dest_res.it->second);
 
   src_res->post_updater.Run();
   dest_res.post_updater.Run();
 
-  if (quicklistCount(src_ql) == 0) {
+  if (ListLen(src_it->second) == 0) {
     CHECK(db_slice.Del(op_args.db_cntx.db_index, src_it));
   }
 
@@ -288,7 +359,13 @@ OpResult<string> Peek(const OpArgs& op_args, string_view key, ListDir dir, bool
   if (!fetch)
     return OpStatus::OK;
 
-  quicklist* ql = GetQL(it_res.value()->second);
+  const PrimeValue& pv = it_res.value()->second;
+  if (IsRingList(pv)) {
+    const RingList* rl = GetRL(pv);
+    return string{dir == ListDir::LEFT ? rl->At(0) : rl->At(rl->Size() - 1)};
+  }
+
+  quicklist* ql = GetQL(pv);
   quicklistEntry entry = container_utils::QLEntry();
   quicklistIter* iter = (dir == ListDir::LEFT) ? quicklistGetIterator(ql, AL_START_HEAD)
                                                : quicklistGetIterator(ql, AL_START_TAIL);
@@ -317,26 +394,35 @@ OpResult<uint32_t> OpPush(const OpArgs& op_args, std::string_view key, ListDir d
     res = std::move(*op_res);
   }
 
-  quicklist* ql = nullptr;
   DVLOG(1) << "OpPush " << key << " new_key " << res.is_new;
 
+  PrimeValue& pv = res.it->second;
   if (res.is_new) {
-    ql = quicklistCreate();
-    quicklistSetOptions(ql, GetFlag(FLAGS_list_max_listpack_size),
-                        GetFlag(FLAGS_list_compress_depth));
-    res.it->second.InitRobj(OBJ_LIST, OBJ_ENCODING_QUICKLIST, ql);
+    InitList(&pv);
   } else {
-    if (res.it->second.ObjType() != OBJ_LIST)
+    if (pv.ObjType() != OBJ_LIST)
       return OpStatus::WRONG_TYPE;
-    ql = GetQL(res.it->second);
   }
 
-  // Left push is LIST_HEAD.
-  int pos = (dir == ListDir::LEFT) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+  if (IsRingList(pv)) {
+    size_t max_len = 0;
+    for (string_view v : vals)
+      max_len = max(max_len, v.size());
+    MaybeConvertToQL(&pv, vals.Size(), max_len);
+  }
 
-  for (string_view v : vals) {
-    es->tmp_str1 = sdscpylen(es->tmp_str1, v.data(), v.size());
-    quicklistPush(ql, es->tmp_str1, sdslen(es->tmp_str1), pos);
+  if (IsRingList(pv)) {
+    for (string_view v : vals)
+      ListPush(dir, v, pv);
+  } else {
+    // Left push is LIST_HEAD.
+    int pos = (dir == ListDir::LEFT) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+    quicklist* ql = GetQL(pv);
+
+    for (string_view v : vals) {
+      es->tmp_str1 = sdscpylen(es->tmp_str1, v.data(), v.size());
+      quicklistPush(ql, es->tmp_str1, sdslen(es->tmp_str1), pos);
+    }
   }
 
   if (res.is_new) {
@@ -358,7 +444,7 @@ OpResult<uint32_t> OpPush(const OpArgs& op_args, std::string_view key, ListDir d
     RecordJournal(op_args, command, mapped, 2);
   }
 
-  return quicklistCount(ql);
+  return ListLen(pv);
 }
 
 OpResult<StringVec> OpPop(const OpArgs& op_args, string_view key, ListDir dir, uint32_t count,
@@ -369,27 +455,26 @@ OpResult<StringVec> OpPop(const OpArgs& op_args, string_view key, ListDir dir, u
     return it_res.status();
 
   auto it = it_res->it;
-  quicklist* ql = GetQL(it->second);
 
   StringVec res;
-  if (quicklistCount(ql) < count) {
-    count = quicklistCount(ql);
+  if (ListLen(it->second) < count) {
+    count = ListLen(it->second);
   }
   res.reserve(count);
 
   if (return_results) {
     for (unsigned i = 0; i < count; ++i) {
-      res.push_back(ListPop(dir, ql));
+      res.push_back(ListPop(dir, it->second));
     }
   } else {
     for (unsigned i = 0; i < count; ++i) {
-      ListPop(dir, ql);
+      ListPop(dir, it->second);
     }
   }
 
   it_res->post_updater.Run();
 
-  if (quicklistCount(ql) == 0) {
+  if (ListLen(it->second) == 0) {
     absl::StrAppend(debugMessages.Next(), "OpPop Del: ", key, " by ", op_args.tx->DebugId());
     CHECK(db_slice.Del(op_args.db_cntx.db_index, it));
   }
@@ -468,16 +553,25 @@ OpResult<uint32_t> OpLen(const OpArgs& op_args, std::string_view key) {
   if (!res)
     return res.status();
 
-  quicklist* ql = GetQL(res.value()->second);
-
-  return quicklistCount(ql);
+  return ListLen(res.value()->second);
 }
 
 OpResult<string> OpIndex(const OpArgs& op_args, std::string_view key, long index) {
   auto res = op_args.shard->db_slice().FindReadOnly(op_args.db_cntx, key, OBJ_LIST);
   if (!res)
     return res.status();
-  quicklist* ql = GetQL(res.value()->second);
+
+  const PrimeValue& pv = res.value()->second;
+  if (IsRingList(pv)) {
+    const RingList* rl = GetRL(pv);
+    if (index < 0)
+      index += rl->Size();
+    if (index < 0 || size_t(index) >= rl->Size())
+      return OpStatus::KEY_NOTFOUND;
+    return string{rl->At(index)};
+  }
+
+  quicklist* ql = GetQL(pv);
   quicklistEntry entry = container_utils::QLEntry();
   quicklistIter* iter = quicklistGetIteratorAtIdx(ql, AL_START_TAIL, index);
   if (!iter)
@@ -508,13 +602,32 @@ OpResult<vector<uint32_t>> OpPos(const OpArgs& op_args, std::string_view key,
     direction = AL_START_TAIL;
   }
 
-  quicklist* ql = GetQL(it_res.value()->second);
-  quicklistIter* ql_iter = quicklistGetIterator(ql, direction);
-  quicklistEntry entry;
-
   int index = 0;
   int matched = 0;
   vector<uint32_t> matches;
+
+  const PrimeValue& pv = it_res.value()->second;
+  if (IsRingList(pv)) {
+    const RingList* rl = GetRL(pv);
+    int len = rl->Size();
+    for (; index < len && (max_len == 0 || index < max_len); ++index) {
+      int k = (direction == AL_START_TAIL) ? len - index - 1 : index;
+      if (rl->At(k) == element) {
+        matched++;
+        if (matched >= rank) {
+          matches.push_back(k);
+          if (count && matched - rank + 1 >= count) {
+            break;
+          }
+        }
+      }
+    }
+    return matches;
+  }
+
+  quicklist* ql = GetQL(pv);
+  quicklistIter* ql_iter = quicklistGetIterator(ql, direction);
+  quicklistEntry entry;
   string str;
 
   while (quicklistNext(ql_iter, &entry) && (max_len == 0 || index < max_len)) {
@@ -546,15 +659,45 @@ OpResult<int> OpInsert(const OpArgs& op_args, string_view key, string_view pivot
   if (!it_res)
     return it_res.status();
 
-  quicklist* ql = GetQL(it_res->it->second);
+  PrimeValue& pv = it_res->it->second;
+
+  // Look up the pivot before converting the encoding, so that a missing pivot leaves
+  // the list as it is.
+  optional<size_t> pivot_index;
+  if (IsRingList(pv)) {
+    RingList* rl = GetRL(pv);
+    for (size_t i = 0; i < rl->Size(); ++i) {
+      if (rl->At(i) == pivot) {
+        pivot_index = i;
+        break;
+      }
+    }
+    if (!pivot_index)
+      return -1;
+
+    MaybeConvertToQL(&pv, 1, elem.size());
+    if (IsRingList(pv)) {
+      rl->Insert(insert_param == INSERT_AFTER ? *pivot_index + 1 : *pivot_index, elem);
+      return rl->Size();
+    }
+  }
+
+  quicklist* ql = GetQL(pv);
   quicklistEntry entry = container_utils::QLEntry();
-  quicklistIter* qiter = quicklistGetIterator(ql, AL_START_HEAD);
+  quicklistIter* qiter;
   bool found = false;
 
-  while (quicklistNext(qiter, &entry)) {
-    if (ElemCompare(entry, pivot)) {
-      found = true;
-      break;
+  if (pivot_index) {
+    qiter = quicklistGetIteratorAtIdx(ql, AL_START_HEAD, *pivot_index);
+    found = quicklistNext(qiter, &entry);
+    DCHECK(found);
+  } else {
+    qiter = quicklistGetIterator(ql, AL_START_HEAD);
+    while (quicklistNext(qiter, &entry)) {
+      if (ElemCompare(entry, pivot)) {
+        found = true;
+        break;
+      }
     }
   }
 
@@ -579,6 +722,35 @@ OpResult<uint32_t> OpRem(const OpArgs& op_args, string_view key, string_view ele
     return it_res.status();
 
   auto it = it_res->it;
+  if (IsRingList(it->second)) {
+    RingList* rl = GetRL(it->second);
+    size_t limit = count == 0 ? rl->Size() : size_t(count < 0 ? -count : count);
+    unsigned removed = 0;
+    if (count >= 0) {
+      for (size_t i = 0; i < rl->Size() && removed < limit;) {
+        if (rl->At(i) == elem) {
+          rl->Erase(i);
+          removed++;
+        } else {
+          ++i;
+        }
+      }
+    } else {
+      for (size_t i = rl->Size(); i > 0 && removed < limit; --i) {
+        if (rl->At(i - 1) == elem) {
+          rl->Erase(i - 1);
+          removed++;
+        }
+      }
+    }
+
+    it_res->post_updater.Run();
+    if (rl->Empty()) {
+      CHECK(db_slice.Del(op_args.db_cntx.db_index, it));
+    }
+    return removed;
+  }
+
   quicklist* ql = GetQL(it->second);
 
   int iter_direction = AL_START_HEAD;
@@ -620,8 +792,22 @@ OpStatus OpSet(const OpArgs& op_args, string_view key, string_view elem, long in
   if (!it_res)
     return it_res.status();
 
-  auto it = it_res->it;
-  quicklist* ql = GetQL(it->second);
+  PrimeValue& pv = it_res->it->second;
+  if (IsRingList(pv)) {
+    RingList* rl = GetRL(pv);
+    if (index < 0)
+      index += rl->Size();
+    if (index < 0 || size_t(index) >= rl->Size())
+      return OpStatus::OUT_OF_RANGE;
+    MaybeConvertToQL(&pv, 0, elem.size());
+  }
+
+  if (IsRingList(pv)) {
+    GetRL(pv)->Set(index, elem);
+    return OpStatus::OK;
+  }
+
+  quicklist* ql = GetQL(pv);
 
   int replaced = quicklistReplaceAtIndex(ql, index, elem.data(), elem.size());
 
@@ -638,8 +824,7 @@ OpStatus OpTrim(const OpArgs& op_args, string_view key, long start, long end) {
     return it_res.status();
 
   auto it = it_res->it;
-  quicklist* ql = GetQL(it->second);
-  long llen = quicklistCount(ql);
+  long llen = ListLen(it->second);
 
   /* convert negative indexes */
   if (start < 0)
@@ -664,24 +849,32 @@ OpStatus OpTrim(const OpArgs& op_args, string_view key, long start, long end) {
     rtrim = llen - end - 1;
   }
 
-  quicklistDelRange(ql, 0, ltrim);
-  quicklistDelRange(ql, -rtrim, rtrim);
+  if (IsRingList(it->second)) {
+    RingList* rl = GetRL(it->second);
+    rl->EraseFront(ltrim);
+    rl->EraseBack(rtrim);
+  } else {
+    quicklist* ql = GetQL(it->second);
+    quicklistDelRange(ql, 0, ltrim);
+    quicklistDelRange(ql, -rtrim, rtrim);
+  }
 
   it_res->post_updater.Run();
 
-  if (quicklistCount(ql) == 0) {
+  if (ListLen(it->second) == 0) {
     CHECK(db_slice.Del(op_args.db_cntx.db_index, it));
   }
   return OpStatus::OK;
 }
 
-OpResult<StringVec> OpRange(const OpArgs& op_args, std::string_view key, long start, long end) {
+OpStatus OpRange(const OpArgs& op_args, std::string_view key, long start, long end,
+                 ReadSlice* slice) {
   auto res = op_args.shard->db_slice().FindReadOnly(op_args.db_cntx, key, OBJ_LIST);
   if (!res)
     return res.status();
 
-  quicklist* ql = GetQL(res.value()->second);
-  long llen = quicklistCount(ql);
+  const PrimeValue& pv = res.value()->second;
+  long llen = ListLen(pv);
 
   /* convert negative indexes */
   if (start < 0)
@@ -690,24 +883,33 @@ OpResult<StringVec> OpRange(const OpArgs& op_args, std::string_view key, long st
     end = llen + end;
   if (start < 0)
     start = 0;
+  if (end >= llen)
+    end = llen - 1;
 
   /* Invariant: start >= 0, so this test will be true when end < 0.
    * The range is empty when start > end or start >= length. */
   if (start > end || start >= llen) {
     /* Out of range start or start > end result in empty list */
-    return StringVec{};
+    return OpStatus::OK;
   }
 
-  StringVec str_vec;
+  if (pv.HasExpire())
+    slice->DisableSlicing();
+
+  // The cursor is the number of elements read by the previous slices.
+  uint64_t cursor = slice->cursor;
+  slice->total = end - start + 1;
   container_utils::IterateList(
-      res.value()->second,
-      [&str_vec](container_utils::ContainerEntry ce) {
-        str_vec.emplace_back(ce.ToString());
-        return true;
+      pv,
+      [slice](container_utils::ContainerEntry ce) {
+        slice->Add(ce);
+        return !slice->Exhausted();
       },
-      start, end);
+      start + cursor, end);
 
-  return str_vec;
+  slice->cursor = cursor + slice->size();
+  slice->done = slice->cursor == slice->total;
+  return OpStatus::OK;
 }
 
 void MoveGeneric(ConnectionContext* cntx, string_view src, string_view dest, ListDir src_dir,
@@ -878,12 +1080,19 @@ OpResult<string> BPopPusher::RunSingle(ConnectionContext* cntx, time_point tp) {
                               std::string_view key) -> bool {
     return owner->db_slice().FindReadOnly(context, key, OBJ_LIST).ok();
   };
+  // The shard that wakes us may move the element right away, in the order the waiters blocked.
+  Transaction::WakeCb wake_cb = [&](Transaction* t, EngineShard* shard, std::string_view) {
+    cb_move(t, shard);
+  };
+
   // Block
-  auto status = t->WaitOnWatch(tp, std::move(wcb), key_checker, &(cntx->blocked), &(cntx->paused));
+  auto status = t->WaitOnWatch(tp, std::move(wcb), key_checker, &(cntx->blocked), &(cntx->paused),
+                               &wake_cb);
   if (status != OpStatus::OK)
     return status;
 
-  t->Execute(cb_move, true);
+  if (t->IsScheduled())
+    t->Execute(cb_move, true);
   return op_res;
 }
 
@@ -1098,17 +1307,17 @@ void ListFamily::LRange(CmdArgList args, ConnectionContext* cntx) {
     return;
   }
 
-  auto cb = [&](Transaction* t, EngineShard* shard) {
-    return OpRange(t->GetOpArgs(shard), key, start, end);
+  auto cb = [&](const OpArgs& op_args, ReadSlice* slice) {
+    return OpRange(op_args, key, start, end, slice);
   };
 
-  auto res = cntx->transaction->ScheduleSingleHopT(std::move(cb));
-  if (!res && res.status() != OpStatus::KEY_NOTFOUND) {
-    return cntx->SendError(res.status());
-  }
-
   auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
-  rb->SendStringArr(*res);
+  OpStatus status =
+      container_utils::ScheduleSlicedRead(cntx->transaction, cb, rb, RedisReplyBuilder::ARRAY);
+  if (status == OpStatus::KEY_NOTFOUND)
+    return rb->SendEmptyArray();
+  if (status != OpStatus::OK)
+    return cntx->SendError(status);
 }
 
 // lrem key 5 foo, will remove foo elements from the list if exists at most 5 times.
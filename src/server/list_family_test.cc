@@ -4,8 +4,10 @@
 
 #include "server/list_family.h"
 
+#include <absl/flags/reflection.h>
 #include <absl/strings/match.h>
 
+#include "base/flags.h"
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "facade/facade_test.h"
@@ -22,6 +24,10 @@ using namespace std;
 using namespace util;
 using absl::StrCat;
 
+ABSL_DECLARE_FLAG(uint32_t, list_ring_max_len);
+ABSL_DECLARE_FLAG(uint32_t, cmd_slice_max_bytes);
+ABSL_DECLARE_FLAG(uint32_t, cmd_slice_write_wait_usec);
+
 namespace dfly {
 
 class ListFamilyTest : public BaseFamilyTest {
@@ -140,6 +146,67 @@ TEST_F(ListFamilyTest, BLPopBlocking) {
   ASSERT_EQ(0, NumWatched());
 }
 
+TEST_F(ListFamilyTest, BLPopBatchWakeup) {
+  constexpr unsigned kWaiters = 8;
+  vector<RespExpr> resps(kWaiters);
+  vector<fb2::Fiber> fibers;
+
+  // The waiters block one after another, so their order in the watch queue is known.
+  for (unsigned i = 0; i < kWaiters; ++i) {
+    fibers.emplace_back(pp_->at(i % num_threads_)->LaunchFiber([&, i] {
+      resps[i] = Run(StrCat("blpop", i), {"blpop", "x", "0"});
+    }));
+    while (GetMetrics().facade_stats.conn_stats.num_blocked_clients < i + 1)
+      ThisFiber::SleepFor(1ms);
+  }
+
+  // A push serves as many waiters as it has elements, in the order they blocked, in one pass.
+  Run({"rpush", "x", "1", "2", "3"});
+  for (unsigned i = 0; i < 3; ++i)
+    fibers[i].Join();
+  EXPECT_EQ(GetMetrics().facade_stats.conn_stats.num_blocked_clients, kWaiters - 3);
+
+  auto metrics = GetMetrics();
+  EXPECT_EQ(3u, metrics.shard_stats.blocked_wakeup_total);
+  EXPECT_EQ(1u, metrics.shard_stats.blocked_wakeup_batch_total);
+
+  Run({"rpush", "x", "4", "5", "6", "7", "8"});
+  for (unsigned i = 3; i < kWaiters; ++i)
+    fibers[i].Join();
+
+  for (unsigned i = 0; i < kWaiters; ++i) {
+    ASSERT_THAT(resps[i], ArrLen(2));
+    EXPECT_EQ(resps[i].GetVec()[1].GetString(), StrCat(i + 1));
+  }
+  EXPECT_EQ(0, NumWatched());
+  EXPECT_EQ(0, Run({"exists", "x"}).GetInt());
+}
+
+TEST_F(ListFamilyTest, BLMoveBatchWakeup) {
+  constexpr unsigned kWaiters = 4;
+  vector<RespExpr> resps(kWaiters);
+  vector<fb2::Fiber> fibers;
+  for (unsigned i = 0; i < kWaiters; ++i) {
+    fibers.emplace_back(pp_->at(i % num_threads_)->LaunchFiber([&, i] {
+      resps[i] = Run(StrCat("blmove", i), {"blmove", "q", "q", "LEFT", "RIGHT", "0"});
+    }));
+    while (GetMetrics().facade_stats.conn_stats.num_blocked_clients < i + 1)
+      ThisFiber::SleepFor(1ms);
+  }
+
+  // Every waiter rotates the list by one element, in the order they blocked.
+  Run({"rpush", "q", "a", "b", "c"});
+  for (auto& fb : fibers)
+    fb.Join();
+
+  EXPECT_EQ(resps[0], "a");
+  EXPECT_EQ(resps[1], "b");
+  EXPECT_EQ(resps[2], "c");
+  EXPECT_EQ(resps[3], "a");
+  EXPECT_THAT(Run({"lrange", "q", "0", "-1"}).GetVec(), ElementsAre("b", "c", "a"));
+  EXPECT_EQ(0, NumWatched());
+}
+
 TEST_F(ListFamilyTest, BLPopMultiple) {
   RespExpr resp0, resp1;
 
@@ -384,6 +451,80 @@ TEST_F(ListFamilyTest, LRange) {
   ASSERT_THAT(resp.GetVec(), ElementsAre("1", "2"));
 }
 
+TEST_F(ListFamilyTest, LRangeSliced) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_cmd_slice_max_bytes, 64);
+
+  vector<string> args{"rpush", kKey1};
+  for (unsigned i = 0; i < 1000; ++i)
+    args.push_back(StrCat("val", i));
+  Run(absl::MakeSpan(args));
+
+  // Every slice holds only a few elements, so the reply is streamed over many hops.
+  auto resp = Run({"lrange", kKey1, "10", "-1"});
+  ASSERT_THAT(resp, ArrLen(990));
+  auto vec = resp.GetVec();
+  EXPECT_EQ(vec.front(), "val10");
+  EXPECT_EQ(vec.back(), "val999");
+
+  resp = Run({"lrange", kKey1, "3", "4"});
+  EXPECT_THAT(resp.GetVec(), ElementsAre("val3", "val4"));
+}
+
+TEST_F(ListFamilyTest, LRangeSlicedSocketBacksUp) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_cmd_slice_max_bytes, 64);
+  absl::SetFlag(&FLAGS_cmd_slice_write_wait_usec, 0);
+
+  vector<string> args{"rpush", kKey1};
+  for (unsigned i = 0; i < 1000; ++i)
+    args.push_back(StrCat("val", i));
+  Run(absl::MakeSpan(args));
+
+  // The read does not wait for a write of a slice that is not done yet, and reads the rest of
+  // the list at once instead. The reply still holds every element in order.
+  auto resp = Run({"lrange", kKey1, "0", "-1"});
+  ASSERT_THAT(resp, ArrLen(1000));
+  auto vec = resp.GetVec();
+  for (size_t i = 0; i < vec.size(); ++i)
+    ASSERT_EQ(vec[i].GetString(), StrCat("val", i));
+  EXPECT_EQ(NumLocked(), 0u);
+}
+
+TEST_F(ListFamilyTest, LRangeSlicedConcurrentWrites) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_cmd_slice_max_bytes, 64);
+
+  vector<string> args{"rpush", kKey1};
+  for (unsigned i = 0; i < 1000; ++i)
+    args.push_back(StrCat("val", i));
+  Run(absl::MakeSpan(args));
+
+  // Pushes to the key wait for the sliced read to finish, so every reply holds the list as it
+  // was at some point between the pushes, with a count that matches the header.
+  atomic_bool done = false;
+  auto writer = pp_->at(1)->LaunchFiber([&] {
+    for (unsigned i = 0; !done; ++i) {
+      Run("writer", {"rpush", kKey1, StrCat("w", i)});
+      Run("writer", {"rpush", kKey2, StrCat("w", i)});
+    }
+  });
+
+  for (unsigned round = 0; round < 5; ++round) {
+    auto resp = Run({"lrange", kKey1, "0", "-1"});
+    ASSERT_EQ(resp.type, RespExpr::ARRAY);
+    auto vec = resp.GetVec();
+    ASSERT_GE(vec.size(), 1000u);
+    for (size_t i = 0; i < vec.size(); ++i) {
+      string expected = i < 1000 ? StrCat("val", i) : StrCat("w", i - 1000);
+      ASSERT_EQ(vec[i].GetString(), expected);
+    }
+  }
+
+  done = true;
+  writer.Join();
+}
+
 TEST_F(ListFamilyTest, Lset) {
   Run({"rpush", kKey1, "0", "1", "2"});
   ASSERT_EQ(Run({"lset", kKey1, "0", "bar"}), "OK");
@@ -879,6 +1020,43 @@ TEST_F(ListFamilyTest, OtherMultiWakesBLpop) {
   f2.Join();
 }
 
+TEST_F(ListFamilyTest, RingListConversion) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_list_ring_max_len, 4);
+
+  Run({"rpush", kKey1, "b", "c"});
+  Run({"lpush", kKey1, "a"});
+  EXPECT_EQ(Run({"lindex", kKey1, "-1"}), "c");
+  EXPECT_THAT(Run({"lpos", kKey1, "b"}), IntArg(1));
+  EXPECT_THAT(Run({"debug", "object", kKey1}).GetString(), HasSubstr("encoding:ringlist"));
+
+  // A missing pivot does not convert the list.
+  EXPECT_THAT(Run({"linsert", kKey1, "after", "z", string(100, 'x')}), IntArg(-1));
+  EXPECT_THAT(Run({"debug", "object", kKey1}).GetString(), HasSubstr("encoding:ringlist"));
+
+  // Grows beyond the ring buffer limit.
+  EXPECT_THAT(Run({"linsert", kKey1, "after", "a", "x"}), IntArg(4));
+  EXPECT_THAT(Run({"rpush", kKey1, "d"}), IntArg(5));
+  auto resp = Run({"lrange", kKey1, "0", "-1"});
+  EXPECT_THAT(resp.GetVec(), ElementsAre("a", "x", "b", "c", "d"));
+  EXPECT_EQ(Run({"lindex", kKey1, "-1"}), "d");
+  EXPECT_THAT(Run({"debug", "object", kKey1}).GetString(), HasSubstr("encoding:quicklist"));
+
+  // An element that is too large for the ring buffer.
+  Run({"rpush", kKey2, "a", "b"});
+  ASSERT_EQ(Run({"lset", kKey2, "1", string(100, 'x')}), "OK");
+  EXPECT_EQ(Run({"rpop", kKey2}), string(100, 'x'));
+  EXPECT_EQ(Run({"rpop", kKey2}), "a");
+
+  // Moving between ring buffer lists.
+  Run({"rpush", kKey3, "1", "2", "3", "4"});
+  EXPECT_EQ(Run({"lmove", kKey3, kKey3, "LEFT", "RIGHT"}), "1");
+  EXPECT_THAT(Run({"lrem", kKey3, "-1", "1"}), IntArg(1));
+  ASSERT_EQ(Run({"ltrim", kKey3, "1", "-1"}), "OK");
+  resp = Run({"lrange", kKey3, "0", "-1"});
+  EXPECT_THAT(resp.GetVec(), ElementsAre("3", "4"));
+}
+
 TEST_F(ListFamilyTest, ContendExpire) {
   vector<fb2::Fiber> blpop_fibers;
   for (unsigned i = 0; i < num_threads_; ++i) {
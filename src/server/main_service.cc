@@ -17,6 +17,7 @@ extern "C" {
 #include <absl/cleanup/cleanup.h>
 #include <absl/functional/bind_front.h>
 #include <absl/strings/ascii.h>
+#include <absl/strings/escaping.h>
 #include <absl/strings/match.h>
 #include <absl/strings/str_format.h>
 #include <xxhash.h>
@@ -36,6 +37,7 @@ extern "C" {
 #include "server/acl/validator.h"
 #include "server/bitops_family.h"
 #include "server/bloom_family.h"
+#include "server/client_tracking.h"
 #include "server/cluster/cluster_family.h"
 #include "server/cluster/cluster_utility.h"
 #include "server/conn_context.h"
@@ -45,6 +47,7 @@ extern "C" {
 #include "server/hset_family.h"
 #include "server/http_api.h"
 #include "server/json_family.h"
+#include "server/journal/journal.h"
 #include "server/list_family.h"
 #include "server/multi_command_squasher.h"
 #include "server/script_mgr.h"
@@ -97,6 +100,10 @@ ABSL_FLAG(double, oom_deny_ratio, 1.1,
           "commands with flag denyoom will return OOM when the ratio between maxmemory and used "
           "memory is above this value");
 
+ABSL_FLAG(std::string, huffman_table, "",
+          "Base64 encoded huffman table for compacting short keys and values, as produced by "
+          "DEBUG COMPRESSION. Empty disables huffman encoding.");
+
 namespace dfly {
 
 #if defined(__linux__)
@@ -870,6 +877,15 @@ void Service::Init(util::AcceptServer* acceptor, std::vector<facade::Listener*>
   });
 
   shard_set->Init(shard_num, !opts.disable_time_update);
+
+  if (string huffman_table = GetFlag(FLAGS_huffman_table); !huffman_table.empty()) {
+    string decoded;
+    if (!absl::Base64Unescape(huffman_table, &decoded) || !InitHuffmanTable(decoded)) {
+      LOG(ERROR) << "Invalid huffman_table flag";
+      exit(1);
+    }
+  }
+
   const auto tcp_disabled = GetFlag(FLAGS_port) == 0u;
   // We assume that listeners.front() is the main_listener
   // see dfly_main RunEngine
@@ -1099,6 +1115,9 @@ std::optional<ErrorReply> Service::VerifyCommandState(const CommandId* cid, CmdA
   if (!etl.is_master && is_write_cmd && !dfly_cntx.is_replicating)
     return ErrorReply{"-READONLY You can't write against a read only replica."};
 
+  if (is_write_cmd && etl.journal() && etl.journal()->HasFileError())
+    return ErrorReply{"-MISCONF Errors writing to the journal file, write commands are disabled"};
+
   if (multi_active) {
     if (cmd_name == "SELECT" || absl::EndsWith(cmd_name, "SUBSCRIBE"))
       return ErrorReply{absl::StrCat("Can not call ", cmd_name, " within a transaction")};
@@ -1327,6 +1346,9 @@ bool Service::InvokeCmd(const CommandId* cid, CmdArgList tail_args, ConnectionCo
     // we will end up triggerring the callback on the following commands. To avoid this
     // we reset it.
     trans->SetTrackingCallback({});
+    trans->SetNoLoopClientId(info.IsTrackingOn() && info.IsBroadcast() && info.IsNoLoop()
+                                 ? cntx->conn()->GetClientId()
+                                 : 0);
     if (is_read_only && info.ShouldTrackKeys()) {
       auto conn = cntx->conn()->Borrow();
       trans->SetTrackingCallback([conn](Transaction* trans) {
@@ -2546,6 +2568,10 @@ void Service::OnClose(facade::ConnectionContext* cntx) {
 
   server_family_.OnClose(server_cntx);
 
+  // The tracking buckets of the shards drop the references of closed connections lazily.
+  if (conn_state.tracking_info_.IsTrackingOn() && conn_state.tracking_info_.IsBroadcast()) {
+    UnregisterBroadcastTracking(server_cntx);
+  }
   conn_state.tracking_info_.SetClientTracking(false);
 }
 
@@ -532,15 +532,15 @@ void RdbLoaderBase::OpaqueObjLoader::CreateSet(const LoadTrace* ltrace) {
 
     // TODO: to move this logic to set_family similarly to ConvertToStrSet.
 
-    /* It's faster to expand the dict to the right size asap in order
-     * to avoid rehashing */
-    set->Reserve(len);
-
     size_t increment = 1;
     if (rdb_type_ == RDB_TYPE_SET_WITH_EXPIRY) {
       increment = 2;
     }
 
+    /* It's faster to expand the dict to the right size asap in order
+     * to avoid rehashing */
+    set->Reserve(len / increment);
+
     for (const auto& seg : ltrace->arr) {
       for (size_t i = 0; i < seg.size(); i += increment) {
         string_view element = ToSV(seg[i].rdb_var);
@@ -592,7 +592,8 @@ void RdbLoaderBase::OpaqueObjLoader::CreateHMap(const LoadTrace* ltrace) {
   if (keep_lp) {
     Iterate(*ltrace, [&](const LoadBlob& blob) {
       size_t str_len = StrLen(blob.rdb_var);
-      lp_size += str_len;
+      // Short strings take one byte for the encoding and one for the back length.
+      lp_size += str_len + 2;
 
       if (str_len > server.max_map_field_len) {
         keep_lp = false;
@@ -1935,6 +1936,7 @@ error_code RdbLoader::Load(io::Source* src) {
 
   absl::Time start = absl::Now();
   src_ = src;
+  local_shard_ = EngineShard::tlocal();
 
   IoBuf::Bytes bytes = mem_buf_->AppendBuffer();
   io::Result<size_t> read_sz = src_->ReadAtLeast(bytes, 9);
@@ -1983,6 +1985,11 @@ error_code RdbLoader::Load(io::Source* src) {
 
     DVLOG(2) << "Opcode type: " << type;
 
+    if (type != RDB_OPCODE_AUX && aux_loaded_cb) {
+      aux_loaded_cb();
+      aux_loaded_cb = nullptr;
+    }
+
     /* Handle special types. */
     if (type == RDB_OPCODE_EXPIRETIME) {
       LOG(ERROR) << "opcode RDB_OPCODE_EXPIRETIME not supported";
@@ -2064,7 +2071,10 @@ error_code RdbLoader::Load(io::Source* src) {
         FlushShardAsync(i);
 
         // Active database if not existed before.
-        shard_set->Add(i, [dbid] { EngineShard::tlocal()->db_slice().ActivateDb(dbid); });
+        if (IsLocalShard(i))
+          local_shard_->db_slice().ActivateDb(dbid);
+        else
+          shard_set->Add(i, [dbid] { EngineShard::tlocal()->db_slice().ActivateDb(dbid); });
       }
 
       cur_db_index_ = dbid;
@@ -2393,6 +2403,17 @@ error_code RdbLoader::HandleAux() {
     /* Just ignored. */
   } else if (auxkey == "search-index") {
     LoadSearchIndexDefFromAux(std::move(auxval));
+  } else if (auxkey == "huffman-table") {
+    LoadHuffmanTableFromAux(std::move(auxval));
+  } else if (auxkey == "shard-id") {
+    if (!absl::SimpleAtoi(auxval, &shard_id_))
+      LOG(WARNING) << "Invalid shard id " << auxval;
+  } else if (auxkey == "shard-count") {
+    if (!absl::SimpleAtoi(auxval, &shard_count_))
+      LOG(WARNING) << "Invalid shard count " << auxval;
+  } else if (auxkey == "journal-gen") {
+    if (!absl::SimpleAtoi(auxval, &journal_generation_))
+      LOG(WARNING) << "Invalid journal generation " << auxval;
   } else {
     /* We ignore fields we don't understand, as by AUX field
      * contract. */
@@ -2419,6 +2440,14 @@ void RdbLoader::FlushShardAsync(ShardId sid) {
   if (out_buf.empty())
     return;
 
+  // Items of our own shard skip the shard queue and are inserted without preemption, keeping
+  // the buffer for the following items.
+  if (IsLocalShard(sid)) {
+    LoadItemsBuffer(cur_db_index_, out_buf);
+    out_buf.clear();
+    return;
+  }
+
   auto cb = [indx = this->cur_db_index_, this, ib = std::move(out_buf)] {
     this->LoadItemsBuffer(indx, ib);
   };
@@ -2426,6 +2455,10 @@ void RdbLoader::FlushShardAsync(ShardId sid) {
   shard_set->Add(sid, std::move(cb));
 }
 
+bool RdbLoader::IsLocalShard(ShardId sid) const {
+  return local_shard_ != nullptr && local_shard_->shard_id() == sid;
+}
+
 void RdbLoader::FlushAllShards() {
   for (ShardId i = 0; i < shard_set->size(); i++)
     FlushShardAsync(i);
@@ -2463,6 +2496,7 @@ void RdbLoader::LoadItemsBuffer(DbIndex db_ind, const ItemsBuf& ib) {
 
     auto& res = *op_res;
     res.it->first.SetSticky(item->is_sticky);
+    db_slice.TrackMemberExpiry(db_ind, item->key, res.it->second);
     if (!res.is_new) {
       LOG(WARNING) << "RDB has duplicated key '" << item->key << "' in DB " << db_ind;
     }
@@ -2476,8 +2510,35 @@ void RdbLoader::LoadItemsBuffer(DbIndex db_ind, const ItemsBuf& ib) {
 void RdbLoader::ResizeDb(size_t key_num, size_t expire_num) {
   DCHECK_LT(key_num, 1U << 31);
   DCHECK_LT(expire_num, 1U << 31);
-  // Note: To reserve space, it's necessary to allocate space at the shard level. We might
-  // load with different number of shards which makes database resizing unfeasible.
+  if (key_num == 0)
+    return;
+
+  // The tables are allocated at the shard level. A DF shard file saved with the same number of
+  // shards holds exactly the keys of one local shard. Otherwise the keys of the file, and of
+  // its sibling files of the same size, spread evenly over all local shards.
+  vector<ShardId> shards;
+  if (shard_count_ == shard_set->size() && shard_id_ < shard_count_) {
+    shards.push_back(shard_id_);
+  } else {
+    size_t file_count = max<size_t>(shard_count_, 1);
+    key_num = key_num * file_count / shard_set->size();
+    expire_num = expire_num * file_count / shard_set->size();
+    for (ShardId sid = 0; sid < shard_set->size(); ++sid)
+      shards.push_back(sid);
+  }
+
+  VLOG(1) << "Reserving " << key_num << " keys in DB " << cur_db_index_ << " of "
+          << shards.size() << " shards";
+
+  for (ShardId sid : shards) {
+    if (IsLocalShard(sid)) {
+      local_shard_->db_slice().Reserve(cur_db_index_, key_num, expire_num);
+    } else {
+      shard_set->Add(sid, [db_ind = cur_db_index_, key_num, expire_num] {
+        EngineShard::tlocal()->db_slice().Reserve(db_ind, key_num, expire_num);
+      });
+    }
+  }
 }
 
 error_code RdbLoader::LoadKeyValPair(int type, ObjSettings* settings) {
@@ -2543,6 +2604,22 @@ void RdbLoader::LoadScriptFromAux(string&& body) {
   }
 }
 
+void RdbLoader::LoadHuffmanTableFromAux(string&& table) {
+  string_view current = CompactObj::GetHuffmanTable();
+  if (current == table)
+    return;
+
+  // Strings are stored decoded in snapshots, so we can not switch the table of the
+  // running instance. We only adopt it if the instance has none.
+  if (!current.empty()) {
+    LOG(WARNING) << "Ignoring huffman table from snapshot, the instance already has one";
+    return;
+  }
+
+  if (!InitHuffmanTable(table))
+    LOG(ERROR) << "Invalid huffman table in snapshot";
+}
+
 void RdbLoader::LoadSearchIndexDefFromAux(string&& def) {
   facade::CapturingReplyBuilder crb{};
   ConnectionContext cntx{nullptr, nullptr, &crb};
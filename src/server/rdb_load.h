@@ -18,6 +18,7 @@ extern "C" {
 
 namespace dfly {
 
+class EngineShard;
 class EngineShardSet;
 class ScriptMgr;
 class CompactObj;
@@ -213,6 +214,11 @@ class RdbLoader : protected RdbLoaderBase {
     return journal_offset_;
   }
 
+  // Returns the journal generation stored in the snapshot, or 0 if there is none.
+  uint64_t journal_generation() const {
+    return journal_generation_;
+  }
+
   // Set callback for receiving RDB_OPCODE_FULLSYNC_END.
   // This opcode is used by a master instance to notify it finished streaming static data
   // and is ready to switch to stable state sync.
@@ -220,6 +226,12 @@ class RdbLoader : protected RdbLoaderBase {
     full_sync_cut_cb = std::move(cb);
   }
 
+  // Set callback that runs once the aux fields at the start of the stream were handled, before
+  // any key is loaded. They carry global state, e.g. the huffman table keys are encoded with.
+  void SetAuxLoadedCb(std::function<void()> cb) {
+    aux_loaded_cb = std::move(cb);
+  }
+
   // Perform pre load procedures after transitioning into the global LOADING state.
   static void PerformPreLoad(Service* service);
 
@@ -256,9 +268,14 @@ class RdbLoader : protected RdbLoaderBase {
 
   void FinishLoad(absl::Time start_time, size_t* keys_loaded);
 
+  // Hands the buffered items of shard sid over to that shard. Items of the shard that runs
+  // the loader are inserted in place, the others are dispatched to their shard queues.
   void FlushShardAsync(ShardId sid);
   void FlushAllShards();
 
+  // Returns true if sid is the shard of the thread running the loader.
+  bool IsLocalShard(ShardId sid) const;
+
   void LoadItemsBuffer(DbIndex db_ind, const ItemsBuf& ib);
 
   void LoadScriptFromAux(std::string&& value);
@@ -267,6 +284,9 @@ class RdbLoader : protected RdbLoaderBase {
   // issues an FT.CREATE call, but does not start indexing
   void LoadSearchIndexDefFromAux(std::string&& value);
 
+  // Adopts the huffman table of the snapshot if this instance does not have one.
+  void LoadHuffmanTableFromAux(std::string&& value);
+
  private:
   Service* service_;
   ScriptMgr* script_mgr_;
@@ -274,14 +294,24 @@ class RdbLoader : protected RdbLoaderBase {
 
   size_t keys_loaded_ = 0;
   double load_time_ = 0;
+  uint64_t journal_generation_ = 0;
+
+  // Shard that saved the file and the number of shards of its instance, if the file holds the
+  // keys of a single shard.
+  uint32_t shard_id_ = 0;
+  uint32_t shard_count_ = 0;
 
   DbIndex cur_db_index_ = 0;
 
+  // Set when the loader runs on a shard thread.
+  EngineShard* local_shard_ = nullptr;
+
   AggregateError ec_;
   std::atomic_bool stop_early_{false};
 
   // Callback when receiving RDB_OPCODE_FULLSYNC_END
   std::function<void()> full_sync_cut_cb;
+  std::function<void()> aux_loaded_cb;
 
   base::MPSCIntrusiveQueue<Item> item_queue_;
 };
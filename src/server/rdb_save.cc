@@ -29,6 +29,7 @@ extern "C" {
 #include "base/logging.h"
 #include "core/bloom.h"
 #include "core/json/json_object.h"
+#include "core/ring_list.h"
 #include "core/sorted_map.h"
 #include "core/string_map.h"
 #include "core/string_set.h"
@@ -162,7 +163,7 @@ uint8_t RdbObjectType(const PrimeValue& pv) {
     case OBJ_STRING:
       return RDB_TYPE_STRING;
     case OBJ_LIST:
-      if (compact_enc == OBJ_ENCODING_QUICKLIST)
+      if (compact_enc == OBJ_ENCODING_QUICKLIST || compact_enc == kEncodingRingList)
         return RDB_TYPE_LIST_QUICKLIST;
       break;
     case OBJ_SET:
@@ -410,6 +411,20 @@ error_code RdbSerializer::SaveObject(const PrimeValue& pv) {
 }
 
 error_code RdbSerializer::SaveListObject(const PrimeValue& pv) {
+  if (pv.Encoding() == kEncodingRingList) {
+    // Small lists are saved as a quicklist with a single node.
+    const RingList* rl = reinterpret_cast<const RingList*>(pv.RObjPtr());
+    uint8_t* lp = lpNew(0);
+    for (size_t i = 0; i < rl->Size(); ++i) {
+      string_view sv = rl->At(i);
+      lp = lpAppend(lp, reinterpret_cast<const uint8_t*>(sv.data()), sv.size());
+    }
+    auto cleanup = absl::MakeCleanup([lp] { lpFree(lp); });
+
+    RETURN_ON_ERR(SaveLen(1));
+    return SaveListPackAsZiplist(lp);
+  }
+
   /* Save a list value */
   DCHECK_EQ(OBJ_ENCODING_QUICKLIST, pv.Encoding());
   const quicklist* ql = reinterpret_cast<const quicklist*>(pv.RObjPtr());
@@ -1350,7 +1365,8 @@ RdbSaver::GlobalData RdbSaver::GetGlobalData(const Service* service) {
     });
   }
 
-  return RdbSaver::GlobalData{std::move(script_bodies), std::move(search_indices)};
+  return RdbSaver::GlobalData{std::move(script_bodies), std::move(search_indices),
+                              string{CompactObj::GetHuffmanTable()}};
 }
 
 void RdbSaver::Impl::FillFreqMap(RdbTypeFreqMap* dest) const {
@@ -1427,6 +1443,11 @@ error_code RdbSaver::SaveHeader(const GlobalData& glob_state) {
   RETURN_ON_ERR(impl_->serializer()->WriteRaw(Bytes{reinterpret_cast<uint8_t*>(magic), sz}));
   RETURN_ON_ERR(SaveAux(std::move(glob_state)));
 
+  if (save_mode_ == SaveMode::SINGLE_SHARD || save_mode_ == SaveMode::SINGLE_SHARD_WITH_SUMMARY) {
+    if (EngineShard* shard = EngineShard::tlocal(); shard)
+      RETURN_ON_ERR(SaveShardResizeHints(shard));
+  }
+
   return error_code{};
 }
 
@@ -1476,6 +1497,12 @@ error_code RdbSaver::SaveAux(const GlobalData& glob_state) {
   for (const string& s : glob_state.lua_scripts)
     RETURN_ON_ERR(impl_->SaveAuxFieldStrStr("lua", s));
 
+  if (!glob_state.huffman_table.empty())
+    RETURN_ON_ERR(impl_->SaveAuxFieldStrStr("huffman-table", glob_state.huffman_table));
+
+  if (glob_state.journal_generation)
+    RETURN_ON_ERR(SaveAuxFieldStrInt("journal-gen", glob_state.journal_generation));
+
   if (save_mode_ == SaveMode::RDB) {
     if (!glob_state.search_indices.empty())
       LOG(WARNING) << "Dragonfly search index data is incompatible with the RDB format";
@@ -1490,6 +1517,28 @@ error_code RdbSaver::SaveAux(const GlobalData& glob_state) {
   return error_code{};
 }
 
+error_code RdbSaver::SaveShardResizeHints(EngineShard* shard) {
+  RETURN_ON_ERR(SaveAuxFieldStrInt("shard-id", shard->shard_id()));
+  RETURN_ON_ERR(SaveAuxFieldStrInt("shard-count", shard_set->size()));
+
+  // The snapshot selects the db again before its first entry, so the selection here does not
+  // leak into the body.
+  const DbSlice& db_slice = shard->db_slice();
+  auto& ser = *impl_->serializer();
+  for (DbIndex db_ind = 0; db_ind < db_slice.db_array_size(); ++db_ind) {
+    const DbTable* table = db_slice.GetDBTable(db_ind);
+    if (table == nullptr || table->prime.size() == 0)
+      continue;
+
+    RETURN_ON_ERR(ser.SelectDb(db_ind));
+    RETURN_ON_ERR(ser.WriteOpcode(RDB_OPCODE_RESIZEDB));
+    RETURN_ON_ERR(ser.SaveLen(table->prime.size()));
+    RETURN_ON_ERR(ser.SaveLen(table->expire.size()));
+  }
+
+  return error_code{};
+}
+
 error_code RdbSaver::SaveEpilog() {
   uint8_t buf[8];
   uint64_t chksum;
@@ -74,6 +74,8 @@ class RdbSaver {
   struct GlobalData {
     const StringVec lua_scripts;     // bodies of lua scripts
     const StringVec search_indices;  // ft.create commands to re-create search indices
+    const std::string huffman_table;  // table used for compacting short strings, if any
+    uint64_t journal_generation = 0;  // first generation of the journal files after the snapshot
   };
 
   // single_shard - true means that we run RdbSaver on a single shard and we do not use
@@ -130,6 +132,10 @@ class RdbSaver {
   std::error_code SaveAux(const GlobalData&);
   std::error_code SaveAuxFieldStrInt(std::string_view key, int64_t val);
 
+  // Writes the shard identity and the sizes of its databases, used by the loader to size the
+  // tables upfront.
+  std::error_code SaveShardResizeHints(EngineShard* shard);
+
   std::unique_ptr<Impl> impl_;
   SaveMode save_mode_;
   CompressionMode compression_mode_;
@@ -3,6 +3,8 @@
 //
 #include "server/replica.h"
 
+#include <unistd.h>
+
 #include <chrono>
 
 #include "absl/strings/match.h"
@@ -24,6 +26,7 @@ extern "C" {
 
 #include "base/logging.h"
 #include "facade/redis_parser.h"
+#include "server/detail/shm_ring.h"
 #include "server/error.h"
 #include "server/journal/executor.h"
 #include "server/journal/serializer.h"
@@ -46,6 +49,11 @@ ABSL_FLAG(
     int, replica_priority, 100,
     "Published by info command for sentinel to pick replica based on score during a failover");
 
+ABSL_FLAG(uint32_t, replica_full_sync_resume_attempts, 5,
+          "Number of attempts to resume a full sync flow after its connection broke.");
+ABSL_FLAG(uint32_t, replication_shm_ring_size, 4u << 20,
+          "Size of the shared memory ring of each flow when replicating with REPLICAOF ... SHM.");
+
 // TODO: Remove this flag on release >= 1.22
 ABSL_FLAG(bool, replica_reconnect_on_master_restart, false,
           "Deprecated - please use --break_replication_on_master_restart.");
@@ -74,10 +82,64 @@ vector<vector<unsigned>> Partition(unsigned num_flows) {
 
 }  // namespace
 
+// Reads the full sync stream of a flow and counts the bytes received. If the connection breaks,
+// continues the stream on a new connection at that offset.
+class DflyShardReplica::FullSyncSource : public io::Source {
+ public:
+  FullSyncSource(DflyShardReplica* replica, Context* cntx, uint64_t offset)
+      : replica_(replica), cntx_(cntx), offset_(offset), buf_(128) {
+  }
+
+  io::Result<size_t> ReadSome(const iovec* v, uint32_t len) final {
+    unsigned max_attempts = GetFlag(FLAGS_replica_full_sync_resume_attempts);
+    for (unsigned attempt = 0;; ++attempt) {
+      io::Result<size_t> res = ReadBuffered(v, len);
+      if (res && *res > 0) {
+        offset_ += *res;
+        return res;
+      }
+
+      if (cntx_->IsCancelled() || !replica_->CanResumeFullSync() || attempt >= max_attempts)
+        return res;
+
+      if (attempt > 0)
+        ThisFiber::SleepFor(GetFlag(FLAGS_master_reconnect_timeout_ms) * 1ms);
+      if (error_code ec = replica_->ResumeFullSync(cntx_, offset_, &buf_); ec)
+        LOG(WARNING) << "Could not resume full sync of flow " << replica_->FlowId() << ": " << ec;
+    }
+  }
+
+  // Stream data that arrived with the last resume reply and was not read yet.
+  io::Bytes Unread() {
+    return buf_.InputBuffer();
+  }
+
+ private:
+  io::Result<size_t> ReadBuffered(const iovec* v, uint32_t len) {
+    if (buf_.InputLen() == 0)
+      return replica_->DataSource()->ReadSome(v, len);
+
+    size_t read = 0;
+    for (uint32_t i = 0; i < len && buf_.InputLen() > 0; ++i) {
+      size_t n = min<size_t>(v[i].iov_len, buf_.InputLen());
+      memcpy(v[i].iov_base, buf_.InputBuffer().data(), n);
+      buf_.ConsumeInput(n);
+      read += n;
+    }
+    return read;
+  }
+
+  DflyShardReplica* replica_;
+  Context* cntx_;
+  uint64_t offset_;  // Bytes of the flow stream received so far.
+  base::IoBuf buf_;
+};
+
 Replica::Replica(string host, uint16_t port, Service* se, std::string_view id,
-                 std::optional<cluster::SlotRange> slot_range)
+                 std::optional<cluster::SlotRange> slot_range, bool shm_transport)
     : ProtocolClient(std::move(host), port), service_(*se), id_{id}, slot_range_(slot_range) {
   proactor_ = ProactorBase::me();
+  master_context_.shm_transport = shm_transport;
 }
 
 Replica::~Replica() {
@@ -453,17 +515,24 @@ error_code Replica::InitiateDflySync() {
   // Initialize shard flows.
   shard_flows_.resize(num_df_flows_);
   for (unsigned i = 0; i < num_df_flows_; ++i) {
-    shard_flows_[i].reset(
-        new DflyShardReplica(server(), master_context_, i, &service_, multi_shard_exe_));
+    shard_flows_[i].reset(new DflyShardReplica(server(), master_context_, i, &service_,
+                                               multi_shard_exe_, &offsets_ec_));
   }
+  flows_epoch_.fetch_add(1, std::memory_order_relaxed);
+  offsets_ec_.notifyAll();
 
   // Blocked on until all flows got full sync cut.
   BlockingCounter sync_block{num_df_flows_};
 
+  // Only flow 0 carries the global state, e.g. the huffman table, which must be installed
+  // before the other flows load keys.
+  fb2::Done aux_loaded;
+
   // Switch to new error handler that closes flow sockets.
-  auto err_handler = [this, sync_block](const auto& ge) mutable {
-    // Unblock this function.
+  auto err_handler = [this, sync_block, aux_loaded](const auto& ge) mutable {
+    // Unblock this function and the flows waiting for flow 0.
     sync_block->Cancel();
+    aux_loaded.Notify();
 
     // Make sure the flows are not in a state transition
     lock_guard lk{flows_op_mu_};
@@ -500,7 +569,8 @@ error_code Replica::InitiateDflySync() {
         auto ec = shard_flows_[id]->StartSyncFlow(sync_block, &cntx_,
                                                   last_journal_LSNs_.has_value()
                                                       ? std::optional((*last_journal_LSNs_)[id])
-                                                      : std::nullopt);
+                                                      : std::nullopt,
+                                                  aux_loaded);
         if (ec.has_value())
           is_full_sync[id] = ec.value();
         else
@@ -694,7 +764,7 @@ error_code Replica::SendNextPhaseRequest(string_view kind) {
 }
 
 io::Result<bool> DflyShardReplica::StartSyncFlow(BlockingCounter sb, Context* cntx,
-                                                 std::optional<LSN> lsn) {
+                                                 std::optional<LSN> lsn, fb2::Done aux_loaded) {
   using nonstd::make_unexpected;
   DCHECK(!master_context_.master_repl_id.empty() && !master_context_.dfly_session_id.empty());
 
@@ -712,14 +782,43 @@ io::Result<bool> DflyShardReplica::StartSyncFlow(BlockingCounter sb, Context* cn
     absl::StrAppend(&cmd, " ", *lsn);
   }
 
+  // Offer the master a shared memory ring for the flow data.
+  string shm_arg;
+  shm_ring_.reset();
+  if (master_context_.shm_transport) {
+    string name = StrCat("/dfly_repl_", getpid(), "_", master_context_.dfly_session_id, "_",
+                         flow_id_);
+    auto ring = detail::ShmRing::Create(std::move(name), GetFlag(FLAGS_replication_shm_ring_size));
+    if (ring) {
+      shm_ring_ = std::move(*ring);
+      shm_arg = StrCat(" SHM ", shm_ring_->name());
+    } else {
+      LOG(WARNING) << "Could not create shared memory ring, replicating flow " << flow_id_
+                   << " over TCP: " << ring.error().message();
+    }
+  }
+
   ResetParser(/*server_mode=*/false);
   leftover_buf_.emplace(128);
-  RETURN_ON_ERR_T(make_unexpected, SendCommand(cmd));
+  RETURN_ON_ERR_T(make_unexpected, SendCommand(cmd + shm_arg));
   auto read_resp = ReadRespReply(&*leftover_buf_);
   if (!read_resp.has_value()) {
     return make_unexpected(read_resp.error());
   }
 
+  // The master can not open the ring if it runs on another host, retry without it.
+  if (shm_ring_ && CheckRespFirstTypes({RespExpr::ERROR})) {
+    LOG(WARNING) << "Master could not use shared memory ring " << shm_ring_->name()
+                 << ", replicating flow " << flow_id_ << " over TCP";
+    shm_ring_.reset();
+    leftover_buf_->ConsumeInput(read_resp->left_in_buffer);
+    RETURN_ON_ERR_T(make_unexpected, SendCommand(cmd));
+    read_resp = ReadRespReply(&*leftover_buf_);
+    if (!read_resp.has_value()) {
+      return make_unexpected(read_resp.error());
+    }
+  }
+
   PC_RETURN_ON_BAD_RESPONSE_T(make_unexpected,
                               CheckRespFirstTypes({RespExpr::STRING, RespExpr::STRING}));
 
@@ -729,14 +828,30 @@ io::Result<bool> DflyShardReplica::StartSyncFlow(BlockingCounter sb, Context* cn
                               flow_directive == "FULL" || flow_directive == "PARTIAL");
   bool is_full_sync = flow_directive == "FULL";
 
+  // A partial sync does not resend the global state.
+  if (!is_full_sync)
+    aux_loaded.Notify();
+
   eof_token = ToSV(LastResponseArgs()[1].GetBuf());
 
   leftover_buf_->ConsumeInput(read_resp->left_in_buffer);
 
+  if (shm_ring_) {
+    // The master mapped the ring, so the name is not needed anymore.
+    shm_ring_->Unlink();
+
+    // Sleep on the doorbell bytes the master writes to the flow connection.
+    shm_ring_->SetWaitWriter([this] {
+      uint8_t buf[64];
+      io::Result<size_t> res = Sock()->Recv(io::MutableBytes{buf, sizeof(buf)});
+      return res && *res > 0;
+    });
+  }
+
   // We can not discard io_buf because it may contain data
   // besides the response we parsed. Therefore we pass it further to ReplicateDFFb.
   sync_fb_ = fb2::Fiber("shard_full_sync", &DflyShardReplica::FullSyncDflyFb, this,
-                        std::move(eof_token), sb, cntx);
+                        std::move(eof_token), sb, cntx, aux_loaded);
 
   return is_full_sync;
 }
@@ -746,7 +861,7 @@ error_code DflyShardReplica::StartStableSyncFlow(Context* cntx) {
   ProactorBase* mythread = ProactorBase::me();
   CHECK(mythread);
 
-  if (!Sock()->IsOpen()) {
+  if (!Sock()->IsOpen() || (shm_ring_ && shm_ring_->IsClosed())) {
     return std::make_error_code(errc::io_error);
   }
 
@@ -756,9 +871,24 @@ error_code DflyShardReplica::StartStableSyncFlow(Context* cntx) {
   return std::error_code{};
 }
 
-void DflyShardReplica::FullSyncDflyFb(std::string eof_token, BlockingCounter bc, Context* cntx) {
+void DflyShardReplica::FullSyncDflyFb(std::string eof_token, BlockingCounter bc, Context* cntx,
+                                      fb2::Done aux_loaded) {
   DCHECK(leftover_buf_);
-  io::PrefixSource ps{leftover_buf_->InputBuffer(), Sock()};
+  FullSyncSource source{this, cntx, leftover_buf_->InputLen()};
+  io::PrefixSource ps{leftover_buf_->InputBuffer(), &source};
+
+  if (flow_id_ == 0) {
+    rdb_loader_->SetAuxLoadedCb([aux_loaded]() mutable { aux_loaded.Notify(); });
+  } else {
+    aux_loaded.Wait();
+    if (cntx->IsCancelled())
+      return;
+  }
+  // Also unblocks the other flows if flow 0 fails before loading any key.
+  absl::Cleanup notify_aux = [this, aux_loaded]() mutable {
+    if (flow_id_ == 0)
+      aux_loaded.Notify();
+  };
 
   rdb_loader_->SetFullSyncCutCb([bc, ran = false]() mutable {
     if (!ran) {
@@ -790,9 +920,11 @@ void DflyShardReplica::FullSyncDflyFb(std::string eof_token, BlockingCounter bc,
 
   // Keep loader leftover.
   io::Bytes unused = chained_tail.UnusedPrefix();
-  if (unused.size() > 0) {
-    leftover_buf_.emplace(unused.size());
+  io::Bytes unread = source.Unread();
+  if (unused.size() + unread.size() > 0) {
+    leftover_buf_.emplace(unused.size() + unread.size());
     leftover_buf_->WriteAndCommit(unused.data(), unused.size());
+    leftover_buf_->WriteAndCommit(unread.data(), unread.size());
   } else {
     leftover_buf_.reset();
   }
@@ -814,7 +946,7 @@ void DflyShardReplica::StableSyncDflyReadFb(Context* cntx) {
     prefix = leftover_buf_->InputBuffer();
   }
 
-  io::PrefixSource ps{prefix, Sock()};
+  io::PrefixSource ps{prefix, DataSource()};
 
   JournalReader reader{&ps, 0};
   DCHECK_GE(journal_rec_executed_, 1u);
@@ -842,6 +974,7 @@ void DflyShardReplica::StableSyncDflyReadFb(Context* cntx) {
       journal_rec_executed_.fetch_add(1, std::memory_order_relaxed);
     }
     shard_replica_waker_.notifyAll();
+    offsets_ec_->notifyAll();
   }
 }
 
@@ -902,11 +1035,13 @@ void DflyShardReplica::StableSyncDflyAcksFb(Context* cntx) {
 
 DflyShardReplica::DflyShardReplica(ServerContext server_context, MasterContext master_context,
                                    uint32_t flow_id, Service* service,
-                                   std::shared_ptr<MultiShardExecution> multi_shard_exe)
+                                   std::shared_ptr<MultiShardExecution> multi_shard_exe,
+                                   util::fb2::EventCount* offsets_ec)
     : ProtocolClient(server_context),
       service_(*service),
       master_context_(master_context),
       multi_shard_exe_(multi_shard_exe),
+      offsets_ec_(offsets_ec),
       flow_id_(flow_id) {
   executor_ = std::make_unique<JournalExecutor>(service);
   rdb_loader_ = std::make_unique<RdbLoader>(&service_);
@@ -1093,6 +1228,39 @@ std::vector<uint64_t> Replica::GetReplicaOffset() const {
   return flow_rec_count;
 }
 
+bool Replica::WaitForOffsets(const std::vector<LSN>& lsns,
+                             std::chrono::steady_clock::time_point deadline) {
+  // The replica thread replaces shard_flows_ on reconnects, so take the flows from it. They are
+  // then read from here until the epoch changes, and released on the replica thread again.
+  using Flows = std::vector<std::shared_ptr<DflyShardReplica>>;
+  auto take_flows = [this] { return pair<uint32_t, Flows>{flows_epoch_.load(), shard_flows_}; };
+  auto release_flows = [this](Flows flows) {
+    if (Sock())
+      Proactor()->DispatchBrief([flows = std::move(flows)] {});
+  };
+
+  while (true) {
+    auto [epoch, flows] = Sock() ? Proactor()->AwaitBrief(take_flows) : take_flows();
+
+    auto reached = [&flows = flows, &lsns] {
+      if (flows.size() != lsns.size())
+        return false;
+      for (const auto& flow : flows) {
+        if (flow->JournalExecutedCount() < lsns[flow->FlowId()])
+          return false;
+      }
+      return true;
+    };
+    auto done = [&, epoch = epoch] { return reached() || flows_epoch_.load() != epoch; };
+
+    bool timeout = offsets_ec_.await_until(done, deadline) == std::cv_status::timeout;
+    bool res = reached();
+    release_flows(std::move(flows));
+    if (res || timeout)
+      return res;
+  }
+}
+
 std::string Replica::GetSyncId() const {
   return master_context_.dfly_session_id;
 }
@@ -1113,7 +1281,40 @@ void DflyShardReplica::JoinFlow() {
 void DflyShardReplica::Cancel() {
   rdb_loader_->stop();
   CloseSocket();
+  if (shm_ring_)
+    shm_ring_->Close();
   shard_replica_waker_.notifyAll();
 }
 
+bool DflyShardReplica::CanResumeFullSync() const {
+  return !shm_ring_ && master_context_.version >= DflyVersion::VER5;
+}
+
+error_code DflyShardReplica::ResumeFullSync(Context* cntx, uint64_t offset, base::IoBuf* buf) {
+  LOG(WARNING) << "Full sync of flow " << flow_id_ << " broke at offset " << offset
+               << ", resuming";
+
+  // Connecting with the replication context fails once the replication is cancelled.
+  RETURN_ON_ERR(ConnectAndAuth(absl::GetFlag(FLAGS_master_connect_timeout_ms) * 1ms, cntx));
+
+  ResetParser(/*server_mode=*/false);
+  buf->Clear();
+  RETURN_ON_ERR(SendCommand(StrCat("DFLY FLOW ", master_context_.master_repl_id, " ",
+                                   master_context_.dfly_session_id, " ", flow_id_, " RESUME ",
+                                   offset)));
+  auto read_resp = ReadRespReply(buf);
+  if (!read_resp.has_value())
+    return read_resp.error();
+
+  PC_RETURN_ON_BAD_RESPONSE(CheckRespIsSimpleReply("OK"));
+  buf->ConsumeInput(read_resp->left_in_buffer);
+  return {};
+}
+
+io::Source* DflyShardReplica::DataSource() {
+  if (shm_ring_)
+    return shm_ring_.get();
+  return Sock();
+}
+
 }  // namespace dfly
@@ -32,11 +32,16 @@ class JournalExecutor;
 struct JournalReader;
 class DflyShardReplica;
 
+namespace detail {
+class ShmRing;
+}  // namespace detail
+
 // The attributes of the master we are connecting to.
 struct MasterContext {
   std::string master_repl_id;
   std::string dfly_session_id;  // Sync session id for dfly sync.
   DflyVersion version = DflyVersion::VER0;
+  bool shm_transport = false;  // The master runs on this host, send flow data over shared memory.
 };
 
 // This class manages replication from both Dragonfly and Redis masters.
@@ -55,7 +60,7 @@ class Replica : ProtocolClient {
 
  public:
   Replica(std::string master_host, uint16_t port, Service* se, std::string_view id,
-          std::optional<cluster::SlotRange> slot_range);
+          std::optional<cluster::SlotRange> slot_range, bool shm_transport);
   ~Replica();
 
   // Spawns a fiber that runs until link with master is broken or the replication is stopped.
@@ -144,6 +149,10 @@ class Replica : ProtocolClient {
   std::vector<uint64_t> GetReplicaOffset() const;
   std::string GetSyncId() const;
 
+  // Waits until the flows executed the journal of every master shard up to lsns, or until the
+  // deadline. Can be called from any thread. Returns false on timeout.
+  bool WaitForOffsets(const std::vector<LSN>& lsns, std::chrono::steady_clock::time_point deadline);
+
  private:
   util::fb2::ProactorBase* proactor_ = nullptr;
   Service& service_;
@@ -154,7 +163,11 @@ class Replica : ProtocolClient {
   util::fb2::Fiber acks_fb_;
   util::fb2::EventCount replica_waker_;
 
-  std::vector<std::unique_ptr<DflyShardReplica>> shard_flows_;
+  std::vector<std::shared_ptr<DflyShardReplica>> shard_flows_;  // shared with WaitForOffsets
+  std::atomic_uint32_t flows_epoch_ = 0;                         // bumped when flows are replaced
+
+  // Notified by the flows whenever they execute journal records, wakes up WaitForOffsets.
+  util::fb2::EventCount offsets_ec_;
   // A vector of the last executer LSNs when a replication is interrupted.
   // Allows partial sync on reconnects.
   std::optional<std::vector<LSN>> last_journal_LSNs_;
@@ -181,7 +194,8 @@ class RdbLoader;
 class DflyShardReplica : public ProtocolClient {
  public:
   DflyShardReplica(ServerContext server_context, MasterContext master_context, uint32_t flow_id,
-                   Service* service, std::shared_ptr<MultiShardExecution> multi_shard_exe);
+                   Service* service, std::shared_ptr<MultiShardExecution> multi_shard_exe,
+                   util::fb2::EventCount* offsets_ec);
   ~DflyShardReplica();
 
   void Cancel();
@@ -189,14 +203,17 @@ class DflyShardReplica : public ProtocolClient {
 
   // Start replica initialized as dfly flow.
   // Sets is_full_sync when successful.
+  // Flow 0 notifies aux_loaded once the global state at the start of its stream was loaded,
+  // the other flows wait for it before loading keys.
   io::Result<bool> StartSyncFlow(util::fb2::BlockingCounter block, Context* cntx,
-                                 std::optional<LSN>);
+                                 std::optional<LSN>, util::fb2::Done aux_loaded);
 
   // Transition into stable state mode as dfly flow.
   std::error_code StartStableSyncFlow(Context* cntx);
 
   // Single flow full sync fiber spawned by StartFullSyncFlow.
-  void FullSyncDflyFb(std::string eof_token, util::fb2::BlockingCounter block, Context* cntx);
+  void FullSyncDflyFb(std::string eof_token, util::fb2::BlockingCounter block, Context* cntx,
+                      util::fb2::Done aux_loaded);
 
   // Single flow stable state sync fiber spawned by StartStableSyncFlow.
   void StableSyncDflyReadFb(Context* cntx);
@@ -210,10 +227,23 @@ class DflyShardReplica : public ProtocolClient {
   uint64_t JournalExecutedCount() const;
 
  private:
+  class FullSyncSource;
+
+  // The shared memory ring if the master accepted one, the socket otherwise.
+  io::Source* DataSource();
+
+  // Whether a broken full sync can continue on a new connection.
+  bool CanResumeFullSync() const;
+
+  // Reconnects and asks the master to continue the full sync stream at offset. Data that
+  // follows the reply is left in buf.
+  std::error_code ResumeFullSync(Context* cntx, uint64_t offset, base::IoBuf* buf);
+
   Service& service_;
   MasterContext master_context_;
 
   std::optional<base::IoBuf> leftover_buf_;
+  std::unique_ptr<detail::ShmRing> shm_ring_;
 
   util::fb2::EventCount shard_replica_waker_;  // waker for trans_data_queue_
 
@@ -237,7 +267,8 @@ class DflyShardReplica : public ProtocolClient {
   bool force_ping_ = false;
 
   std::shared_ptr<MultiShardExecution> multi_shard_exe_;
-  uint32_t flow_id_ = UINT32_MAX;  // Flow id if replica acts as a dfly flow.
+  util::fb2::EventCount* offsets_ec_;  // Owned by the Replica, notified on journal_rec_executed_
+  uint32_t flow_id_ = UINT32_MAX;      // Flow id if replica acts as a dfly flow.
 };
 
 }  // namespace dfly
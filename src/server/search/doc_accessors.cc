@@ -67,8 +67,41 @@ SearchDocData BaseAccessor::Serialize(const search::Schema& schema,
   return out;
 }
 
+optional<string_view> ListPackAccessor::Find(string_view field) const {
+  // A single lookup is cheaper with a plain scan than with building the field map
+  if (!decoded_ && ++lookups_ < 2)
+    return container_utils::LpFind(lp_, field, intbuf_[0].data());
+
+  if (!decoded_)
+    Decode();
+
+  auto it = fields_.find(field);
+  return it != fields_.end() ? make_optional(it->second) : nullopt;
+}
+
+void ListPackAccessor::Decode() const {
+  fields_.reserve(lpLength(lp_) / 2);
+
+  // Integer encoded entries are printed into intbuf_, so they are copied to stable storage
+  auto stable = [this](string_view sv, const array<uint8_t, 33>& buf) -> string_view {
+    if (sv.data() != reinterpret_cast<const char*>(buf.data()))
+      return sv;
+    return int_values_.emplace_back(sv);
+  };
+
+  for (uint8_t* fptr = lpFirst(lp_); fptr;) {
+    string_view k = stable(container_utils::LpGetView(fptr, intbuf_[0].data()), intbuf_[0]);
+    fptr = lpNext(lp_, fptr);
+    string_view v = stable(container_utils::LpGetView(fptr, intbuf_[1].data()), intbuf_[1]);
+    fptr = lpNext(lp_, fptr);
+
+    fields_.emplace(k, v);
+  }
+  decoded_ = true;
+}
+
 BaseAccessor::StringList ListPackAccessor::GetStrings(string_view active_field) const {
-  auto strsv = container_utils::LpFind(lp_, active_field, intbuf_[0].data());
+  auto strsv = Find(active_field);
   return strsv.has_value() ? StringList{*strsv} : StringList{};
 }
 
@@ -7,6 +7,8 @@
 #include <absl/container/flat_hash_map.h>
 #include <absl/types/span.h>
 
+#include <deque>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -32,7 +34,9 @@ struct BaseAccessor : public search::DocumentAccessor {
                                   const SearchParams::FieldReturnList& fields) const;
 };
 
-// Accessor for hashes stored with listpack
+// Accessor for hashes stored with listpack. Every field lookup scans the listpack, so once a
+// second field is requested, the document is decoded in a single pass into a field map that
+// serves all further lookups of all indices.
 struct ListPackAccessor : public BaseAccessor {
   using LpPtr = uint8_t*;
 
@@ -44,8 +48,16 @@ struct ListPackAccessor : public BaseAccessor {
   SearchDocData Serialize(const search::Schema& schema) const override;
 
  private:
+  std::optional<std::string_view> Find(std::string_view field) const;
+  void Decode() const;
+
   mutable std::array<uint8_t, 33> intbuf_[2];
   LpPtr lp_;
+
+  mutable bool decoded_ = false;
+  mutable unsigned lookups_ = 0;
+  mutable absl::flat_hash_map<std::string_view, std::string_view> fields_;
+  mutable std::deque<std::string> int_values_;  // printed integer entries referenced by fields_
 };
 
 // Accessor for hashes stored with StringMap
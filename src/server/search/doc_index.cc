@@ -20,8 +20,8 @@ using namespace std;
 
 namespace {
 
-template <typename F>
-void TraverseAllMatching(const DocIndex& index, const OpArgs& op_args, F&& f) {
+// Traverses all documents of the database and calls f(key, pv) for each of them
+template <typename F> void TraverseAllDocs(const OpArgs& op_args, F&& f) {
   auto& db_slice = op_args.shard->db_slice();
   DCHECK(db_slice.IsDbValid(op_args.db_cntx.db_index));
   auto [prime_table, _] = db_slice.GetTables(op_args.db_cntx.db_index);
@@ -29,15 +29,11 @@ void TraverseAllMatching(const DocIndex& index, const OpArgs& op_args, F&& f) {
   string scratch;
   auto cb = [&](PrimeTable::iterator it) {
     const PrimeValue& pv = it->second;
-    if (pv.ObjType() != index.GetObjCode())
+    if (pv.ObjType() != OBJ_HASH && pv.ObjType() != OBJ_JSON)
       return;
 
     string_view key = it->first.GetSlice(&scratch);
-    if (key.rfind(index.prefix, 0) != 0)
-      return;
-
-    auto accessor = GetAccessor(op_args.db_cntx, pv);
-    f(key, accessor.get());
+    f(key, pv);
   };
 
   PrimeTable::Cursor cursor;
@@ -175,25 +171,29 @@ ShardDocIndex::ShardDocIndex(shared_ptr<DocIndex> index)
     : base_{std::move(index)}, indices_{{}, nullptr}, key_index_{} {
 }
 
-void ShardDocIndex::Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr) {
+void ShardDocIndex::Reset(PMR_NS::memory_resource* mr) {
   key_index_ = DocKeyIndex{};
   indices_ = search::FieldIndices{base_->schema, mr};
+}
 
-  auto cb = [this](string_view key, BaseAccessor* doc) { indices_.Add(key_index_.Add(key), doc); };
-  TraverseAllMatching(*base_, op_args, cb);
+void ShardDocIndex::Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr) {
+  Reset(mr);
+
+  TraverseAllDocs(op_args, [&](string_view key, const PrimeValue& pv) {
+    if (Matches(key, pv.ObjType()))
+      AddDoc(key, GetAccessor(op_args.db_cntx, pv).get());
+  });
 
   VLOG(1) << "Indexed " << key_index_.Size() << " docs on " << base_->prefix;
 }
 
-void ShardDocIndex::AddDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
-  auto accessor = GetAccessor(db_cntx, pv);
-  indices_.Add(key_index_.Add(key), accessor.get());
+void ShardDocIndex::AddDoc(string_view key, BaseAccessor* doc) {
+  indices_.Add(key_index_.Add(key), doc);
 }
 
-void ShardDocIndex::RemoveDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
-  auto accessor = GetAccessor(db_cntx, pv);
+void ShardDocIndex::RemoveDoc(string_view key, BaseAccessor* doc) {
   DocId id = key_index_.Remove(key);
-  indices_.Remove(id, accessor.get());
+  indices_.Remove(id, doc);
 }
 
 bool ShardDocIndex::Matches(string_view key, unsigned obj_code) const {
@@ -309,7 +309,12 @@ bool ShardDocIndices::DropIndex(string_view name) {
 
 void ShardDocIndices::RebuildAllIndices(const OpArgs& op_args) {
   for (auto& [_, ptr] : indices_)
-    ptr->Rebuild(op_args, &local_mr_);
+    ptr->Reset(&local_mr_);
+
+  // Traverse the table once for all indices instead of once per index
+  TraverseAllDocs(op_args, [&](string_view key, const PrimeValue& pv) {
+    AddDoc(key, op_args.db_cntx, pv);
+  });
 }
 
 vector<string> ShardDocIndices::GetIndexNames() const {
@@ -320,17 +325,30 @@ vector<string> ShardDocIndices::GetIndexNames() const {
   return names;
 }
 
+// The accessor is created once per document and shared by all matching indices, so its decoded
+// fields are reused between them.
+// Documents are indexed right away rather than batched until the end of the shard hop: callers
+// remove the old version, mutate the value and add the new one within the same callback, and
+// searches that run later in the same hop (MULTI, squashed pipelines) must already see it.
 void ShardDocIndices::AddDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
+  unique_ptr<BaseAccessor> accessor;
   for (auto& [_, index] : indices_) {
-    if (index->Matches(key, pv.ObjType()))
-      index->AddDoc(key, db_cntx, pv);
+    if (!index->Matches(key, pv.ObjType()))
+      continue;
+    if (!accessor)
+      accessor = GetAccessor(db_cntx, pv);
+    index->AddDoc(key, accessor.get());
   }
 }
 
 void ShardDocIndices::RemoveDoc(string_view key, const DbContext& db_cntx, const PrimeValue& pv) {
+  unique_ptr<BaseAccessor> accessor;
   for (auto& [_, index] : indices_) {
-    if (index->Matches(key, pv.ObjType()))
-      index->RemoveDoc(key, db_cntx, pv);
+    if (!index->Matches(key, pv.ObjType()))
+      continue;
+    if (!accessor)
+      accessor = GetAccessor(db_cntx, pv);
+    index->RemoveDoc(key, accessor.get());
   }
 }
 
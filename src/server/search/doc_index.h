@@ -66,6 +66,9 @@ struct SearchParams {
   std::optional<search::SortOption> sort_option;
   search::QueryParams query_params;
 
+  // SCORER BM25: rank text matches by relevance
+  bool rank_by_relevance = false;
+
   bool IdsOnly() const {
     return return_fields && return_fields->empty();
   }
@@ -97,6 +100,7 @@ struct DocIndexInfo {
 };
 
 class ShardDocIndices;
+struct BaseAccessor;
 
 // Stores internal search indices for documents of a document index on a specific shard.
 class ShardDocIndex {
@@ -133,12 +137,15 @@ class ShardDocIndex {
   // Return whether base index matches
   bool Matches(std::string_view key, unsigned obj_code) const;
 
-  void AddDoc(std::string_view key, const DbContext& db_cntx, const PrimeValue& pv);
-  void RemoveDoc(std::string_view key, const DbContext& db_cntx, const PrimeValue& pv);
+  void AddDoc(std::string_view key, BaseAccessor* doc);
+  void RemoveDoc(std::string_view key, BaseAccessor* doc);
 
   DocIndexInfo GetInfo() const;
 
  private:
+  // Clears internal data.
+  void Reset(PMR_NS::memory_resource* mr);
+
   // Clears internal data. Traverses all matching documents and assigns ids.
   void Rebuild(const OpArgs& op_args, PMR_NS::memory_resource* mr);
 
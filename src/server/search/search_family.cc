@@ -262,6 +262,17 @@ optional<SearchParams> ParseSearchParamsOrReply(CmdArgParser parser, ConnectionC
       continue;
     }
 
+    // SCORER BM25
+    if (parser.Check("SCORER").ExpectTail(1)) {
+      string scorer = absl::AsciiStrToUpper(parser.Next());
+      if (scorer != "BM25") {
+        cntx->SendError(absl::StrCat("Unsupported scorer ", scorer));
+        return nullopt;
+      }
+      params.rank_by_relevance = true;
+      continue;
+    }
+
     // Unsupported parameters are ignored for now
     parser.Skip(1);
   }
@@ -414,24 +425,42 @@ void ReplyWithResults(const SearchParams& params, absl::Span<SearchResult> resul
 
 void ReplySorted(search::AggregationInfo agg, const SearchParams& params,
                  absl::Span<SearchResult> results, ConnectionContext* cntx) {
+  auto less = [desc = agg.descending](const SerializedSearchDoc& l, const SerializedSearchDoc& r) {
+    return desc ? (r < l) : (l < r);
+  };
+
+  // Every shard selects its first documents in order, so the first ones overall are taken by
+  // merging the shard results instead of sorting all of them.
   size_t total = 0;
-  vector<SerializedSearchDoc*> docs;
+  using DocRange = pair<SerializedSearchDoc*, SerializedSearchDoc*>;
+  vector<DocRange> heap;
   for (auto& shard_results : results) {
     total += shard_results.total_hits;
-    for (auto& doc : shard_results.docs) {
-      docs.push_back(&doc);
-    }
+    auto& shard_docs = shard_results.docs;
+    if (!is_sorted(shard_docs.begin(), shard_docs.end(), less))
+      sort(shard_docs.begin(), shard_docs.end(), less);
+    if (!shard_docs.empty())
+      heap.emplace_back(shard_docs.data(), shard_docs.data() + shard_docs.size());
   }
 
   size_t agg_limit = agg.limit.value_or(total);
   size_t prefix = min(params.limit_offset + params.limit_total, agg_limit);
 
-  partial_sort(docs.begin(), docs.begin() + min(docs.size(), prefix), docs.end(),
-               [desc = agg.descending](const auto* l, const auto* r) {
-                 return desc ? (*l >= *r) : (*l < *r);
-               });
+  auto heap_cmp = [&less](const DocRange& l, const DocRange& r) {
+    return less(*r.first, *l.first);
+  };
+  make_heap(heap.begin(), heap.end(), heap_cmp);
 
-  docs.resize(min(docs.size(), agg_limit));
+  vector<SerializedSearchDoc*> docs;
+  while (docs.size() < prefix && !heap.empty()) {
+    pop_heap(heap.begin(), heap.end(), heap_cmp);
+    auto& [first, last] = heap.back();
+    docs.push_back(first++);
+    if (first == last)
+      heap.pop_back();
+    else
+      push_heap(heap.begin(), heap.end(), heap_cmp);
+  }
 
   size_t start_idx = min(params.limit_offset, docs.size());
   size_t result_count = min(docs.size() - start_idx, params.limit_total);
@@ -691,6 +720,9 @@ void SearchFamily::FtSearch(CmdArgList args, ConnectionContext* cntx) {
   if (!search_algo.Init(query_str, &params->query_params, sort_opt))
     return cntx->SendError("Query syntax error");
 
+  if (params->rank_by_relevance)
+    search_algo.EnableRanking();
+
   // Because our coordinator thread may not have a shard, we can't check ahead if the index exists.
   atomic<bool> index_not_found{false};
   vector<SearchResult> docs(shard_set->size());
@@ -730,6 +762,9 @@ void SearchFamily::FtProfile(CmdArgList args, ConnectionContext* cntx) {
   if (!search_algo.Init(query_str, &params->query_params, sort_opt))
     return cntx->SendError("Query syntax error");
 
+  if (params->rank_by_relevance)
+    search_algo.EnableRanking();
+
   search_algo.EnableProfiling();
 
   absl::Time start = absl::Now();
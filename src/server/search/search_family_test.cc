@@ -389,6 +389,30 @@ TEST_F(SearchFamilyTest, Numbers) {
   */
 }
 
+TEST_F(SearchFamilyTest, ManyFieldsManyIndices) {
+  // Listpack hashes with more than one indexed field are decoded once and shared by all indices
+  for (unsigned i = 0; i < 10; i++) {
+    Run({"hset", absl::StrCat("d", i), "a", absl::StrCat(i), "b", absl::StrCat(i * 10), "c",
+         absl::StrCat("word", i), "d", i % 2 ? "odd" : "even", "e", "123"});
+  }
+
+  EXPECT_EQ(Run({"ft.create", "i1", "schema", "a", "numeric", "b", "numeric", "c", "text", "d",
+                 "tag", "e", "numeric"}),
+            "OK");
+  EXPECT_EQ(Run({"ft.create", "i2", "schema", "d", "tag", "b", "numeric"}), "OK");
+
+  EXPECT_THAT(Run({"ft.search", "i1", "@a:[3 3] @b:[30 30] @c:word3 @d:{odd} @e:[123 123]"}),
+              AreDocIds("d3"));
+  EXPECT_THAT(Run({"ft.search", "i2", "@d:{even} @b:[50 80]"}), AreDocIds("d6", "d8"));
+
+  Run({"hset", "d6", "d", "odd", "b", "1"});
+  EXPECT_THAT(Run({"ft.search", "i1", "@d:{odd} @a:[6 6]"}), AreDocIds("d6"));
+  EXPECT_THAT(Run({"ft.search", "i2", "@d:{even} @b:[50 80]"}), AreDocIds("d8"));
+
+  Run({"del", "d8"});
+  EXPECT_THAT(Run({"ft.search", "i2", "@d:{even} @b:[50 80]"}), kNoResults);
+}
+
 TEST_F(SearchFamilyTest, TestLimit) {
   for (unsigned i = 0; i < 20; i++)
     Run({"hset", to_string(i), "match", "all"});
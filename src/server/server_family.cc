@@ -9,6 +9,7 @@
 #include <absl/strings/match.h>
 #include <absl/strings/str_join.h>
 #include <absl/strings/str_replace.h>
+#include <absl/strings/str_split.h>
 #include <absl/strings/strip.h>
 #include <croncpp.h>  // cron::cronexpr
 #include <sys/resource.h>
@@ -37,6 +38,7 @@ extern "C" {
 #include "io/proc_reader.h"
 #include "search/doc_index.h"
 #include "server/acl/acl_commands_def.h"
+#include "server/client_tracking.h"
 #include "server/command_registry.h"
 #include "server/conn_context.h"
 #include "server/debugcmd.h"
@@ -46,7 +48,9 @@ extern "C" {
 #include "server/engine_shard_set.h"
 #include "server/error.h"
 #include "server/generic_family.h"
+#include "server/journal/executor.h"
 #include "server/journal/journal.h"
+#include "server/journal/serializer.h"
 #include "server/main_service.h"
 #include "server/memory_cmd.h"
 #include "server/protocol_client.h"
@@ -89,6 +93,10 @@ ABSL_FLAG(string, dir, "", "working directory");
 ABSL_FLAG(string, dbfilename, "dump-{timestamp}",
           "the filename to save/load the DB, instead of/with {timestamp} can be used {Y}, {m}, and "
           "{d} macros");
+ABSL_FLAG(string, journal_dir, "",
+          "If set, the journal is persisted to this directory. On startup the journal entries "
+          "written after the loaded snapshot are replayed. Requires io_uring and is ignored on "
+          "replicas");
 ABSL_FLAG(string, requirepass, "",
           "password for AUTH authentication. "
           "If empty can also be set with DFLY_PASSWORD environment variable.");
@@ -251,6 +259,18 @@ bool IsCloudPath(string_view path) {
   return absl::StartsWith(path, kS3Prefix);
 }
 
+// Returns the shard of a dfs shard file named "<name>-NNNN.dfs".
+optional<ShardId> DfsFileShard(string_view path) {
+  constexpr string_view kExt = ".dfs";
+  if (!absl::ConsumeSuffix(&path, kExt) || path.size() < 5 || path[path.size() - 5] != '-')
+    return nullopt;
+
+  uint32_t sid;
+  if (!absl::SimpleAtoi(path.substr(path.size() - 4), &sid))
+    return nullopt;
+  return sid;
+}
+
 // Check that if TLS is used at least one form of client authentication is
 // enabled. That means either using a password or giving a root
 // certificate for authenticating client certificates which will
@@ -456,14 +476,31 @@ void ClientPauseCmd(CmdArgList args, vector<facade::Listener*> listeners, Connec
   }
 }
 
-void ClientTracking(CmdArgList args, ConnectionContext* cntx) {
-  auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
-  if (!rb->IsResp3())
-    return cntx->SendError(
-        "Client tracking is currently not supported for RESP2. Please use RESP3.");
+// Finds the connection with the given id on any thread and borrows a reference to it.
+optional<facade::Connection::WeakRef> FindRedirectTarget(uint32_t id,
+                                                         absl::Span<facade::Listener*> listeners) {
+  util::fb2::Mutex mu;
+  optional<facade::Connection::WeakRef> res;
+  auto cb = [&](unsigned thread_index, util::Connection* conn) {
+    facade::Connection* dconn = static_cast<facade::Connection*>(conn);
+    if (dconn->GetClientId() != id || !IsInvalidationSubscriber(dconn))
+      return;
+
+    // The subscription keeps the target from migrating, so it is safe to borrow.
+    lock_guard lk(mu);
+    res = dconn->Borrow();
+  };
+
+  for (auto* listener : listeners) {
+    listener->TraverseConnections(cb);
+  }
+  return res;
+}
 
+void ClientTracking(CmdArgList args, absl::Span<facade::Listener*> listeners,
+                    ConnectionContext* cntx) {
   CmdArgParser parser{args};
-  if (!parser.HasAtLeast(1) || args.size() > 3)
+  if (!parser.HasAtLeast(1))
     return cntx->SendError(kSyntaxErr);
 
   bool is_on = false;
@@ -476,34 +513,83 @@ void ClientTracking(CmdArgList args, ConnectionContext* cntx) {
   }
 
   bool noloop = false;
+  bool bcast = false;
+  optional<uint32_t> redirect_id;
+  vector<string> prefixes;
 
-  if (parser.HasNext()) {
-    if (parser.Check("OPTIN").IgnoreCase()) {
+  while (parser.HasNext()) {
+    if (option == Tracking::NONE && parser.Check("OPTIN").IgnoreCase()) {
       option = Tracking::OPTIN;
-    } else if (parser.Check("OPTOUT").IgnoreCase()) {
+    } else if (option == Tracking::NONE && parser.Check("OPTOUT").IgnoreCase()) {
       option = Tracking::OPTOUT;
-    } else if (parser.Check("NOLOOP").IgnoreCase()) {
+    } else if (!noloop && parser.Check("NOLOOP").IgnoreCase()) {
       noloop = true;
+    } else if (!bcast && parser.Check("BCAST").IgnoreCase()) {
+      bcast = true;
+    } else if (parser.Check("PREFIX").IgnoreCase().ExpectTail(1)) {
+      prefixes.emplace_back(parser.Next());
+    } else if (!redirect_id && parser.Check("REDIRECT").IgnoreCase().ExpectTail(1)) {
+      redirect_id = parser.Next<uint32_t>();
     } else {
       return cntx->SendError(kSyntaxErr);
     }
   }
 
-  if (parser.HasNext()) {
-    if (!noloop && parser.Check("NOLOOP").IgnoreCase()) {
-      noloop = true;
-    } else {
-      return cntx->SendError(kSyntaxErr);
+  if (auto err = parser.Error(); err)
+    return cntx->SendError(err->MakeReply());
+
+  // Without REDIRECT invalidations are delivered as RESP3 pushes on the same connection.
+  auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+  if (!rb->IsResp3() && !redirect_id)
+    return cntx->SendError(
+        "Client tracking is currently not supported for RESP2. Please use RESP3.");
+
+  if (bcast && option != Tracking::NONE)
+    return cntx->SendError("OPTIN and OPTOUT are not compatible with BCAST");
+
+  if (!bcast && !prefixes.empty())
+    return cntx->SendError("PREFIX option requires BCAST mode to be enabled");
+
+  // A key must match at most one prefix of a client, so that it is invalidated only once.
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    for (size_t j = 0; j < prefixes.size(); ++j) {
+      if (i != j && absl::StartsWith(prefixes[j], prefixes[i]))
+        return cntx->SendError(absl::StrCat("Prefix '", prefixes[j],
+                                            "' overlaps with another provided prefix '",
+                                            prefixes[i], "'"));
     }
   }
 
+  optional<facade::Connection::WeakRef> redirect;
+  if (is_on && redirect_id) {
+    redirect = FindRedirectTarget(*redirect_id, listeners);
+    if (!redirect)
+      return cntx->SendError(
+          "The client ID you want redirect to does not exist or is not subscribed to "
+          "__redis__:invalidate");
+  }
+
+  auto& info = cntx->conn_state.tracking_info_;
+  if (info.IsTrackingOn()) {
+    if (info.IsBroadcast())
+      UnregisterBroadcastTracking(cntx);
+    else
+      UntrackClient(cntx->conn()->GetClientId());
+  }
+
   if (is_on) {
     ++cntx->subscriptions;
   }
 
-  cntx->conn_state.tracking_info_.SetClientTracking(is_on);
-  cntx->conn_state.tracking_info_.SetOption(option);
-  cntx->conn_state.tracking_info_.SetNoLoop(noloop);
+  info.SetClientTracking(is_on);
+  info.SetOption(option);
+  info.SetNoLoop(noloop);
+  info.SetBroadcast(is_on && bcast, std::move(prefixes));
+  info.SetRedirect(std::move(redirect));
+
+  if (is_on && bcast) {
+    RegisterBroadcastTracking(cntx);
+  }
   return cntx->SendOk();
 }
 
@@ -623,6 +709,7 @@ struct ReplicaOfArgs {
   string host;
   uint16_t port;
   std::optional<cluster::SlotRange> slot_range;
+  bool shm_transport = false;
   static optional<ReplicaOfArgs> FromCmdArgs(CmdArgList args, ConnectionContext* cntx);
   bool IsReplicaOfNoOne() const {
     return port == 0;
@@ -636,6 +723,9 @@ struct ReplicaOfArgs {
       os << " SLOTS [" << args.slot_range.value().start << "-" << args.slot_range.value().end
          << "]";
     }
+    if (args.shm_transport) {
+      os << " SHM";
+    }
     return os;
   }
 };
@@ -654,13 +744,16 @@ optional<ReplicaOfArgs> ReplicaOfArgs::FromCmdArgs(CmdArgList args, ConnectionCo
       cntx->SendError("port is out of range");
       return nullopt;
     }
-    if (parser.HasNext()) {
+    if (parser.Check("SHM").IgnoreCase()) {
+      replicaof_args.shm_transport = true;
+    } else if (parser.HasNext()) {
       auto [slot_start, slot_end] = parser.Next<cluster::SlotId, cluster::SlotId>();
       replicaof_args.slot_range = cluster::SlotRange{slot_start, slot_end};
       if (auto err = parser.Error(); err || !replicaof_args.slot_range->IsValid()) {
         cntx->SendError("Invalid slot range");
         return nullopt;
       }
+      replicaof_args.shm_transport = static_cast<bool>(parser.Check("SHM").IgnoreCase());
     }
   }
 
@@ -847,10 +940,30 @@ void ServerFamily::Init(util::AcceptServer* acceptor, std::vector<facade::Listen
 
   // check for '--replicaof' before loading anything
   if (ReplicaOfFlag flag = GetFlag(FLAGS_replicaof); flag.has_value()) {
+    LOG_IF(WARNING, !GetFlag(FLAGS_journal_dir).empty()) << "journal_dir is ignored for replicas";
     service_.proactor_pool().GetNextProactor()->Await(
         [this, &flag]() { this->Replicate(flag.host, flag.port); });
   } else {  // load from snapshot only if --replicaof is empty
+    if (!GetFlag(FLAGS_journal_dir).empty()) {
+      if (pb_task_->GetKind() == ProactorBase::IOURING)
+        recover_journal_ = true;
+      else
+        LOG(WARNING) << "journal_dir requires io_uring, the journal is not persisted";
+    }
+
     LoadFromSnapshot();
+
+    // Without a snapshot the journal is replayed from its first generation.
+    if (!load_result_ && recover_journal_) {
+      service_.SwitchState(GlobalState::ACTIVE, GlobalState::LOADING);
+      fb2::Future<GenericError> future;
+      pb_task_->Dispatch([this, future]() mutable {
+        RecoverJournal(0);
+        service_.SwitchState(GlobalState::LOADING, GlobalState::ACTIVE);
+        future.Resolve(GenericError{});
+      });
+      load_result_ = future;
+    }
   }
 
   const auto create_snapshot_schedule_fb = [this] {
@@ -931,6 +1044,7 @@ void ServerFamily::Shutdown() {
 struct AggregateLoadResult {
   AggregateError first_error;
   std::atomic<size_t> keys_read;
+  std::atomic<uint64_t> journal_generation{0};
 };
 
 // Load starts as many fibers as there are files to load each one separately.
@@ -965,22 +1079,47 @@ std::optional<fb2::Future<GenericError>> ServerFamily::Load(const std::string& l
 
   auto aggregated_result = std::make_shared<AggregateLoadResult>();
 
-  for (auto& path : paths) {
+  // A snapshot saved with the same number of shards is loaded by the shard threads, each one
+  // inserting the keys of its own file directly into its db slice.
+  const bool per_shard_load = paths.size() == shard_count() + 1;
+
+  // The summary file of a dfs snapshot comes first. It holds the global state, including the
+  // huffman table that the shard files are decoded with, so the shard files are loaded only
+  // after it.
+  const bool has_summary = paths.size() > 1;
+  fb2::Done summary_done;
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    string& path = paths[i];
     // For single file, choose thread that does not handle shards if possible.
     // This will balance out the CPU during the load.
     ProactorBase* proactor;
-    if (paths.size() == 1 && shard_count() < pool.size()) {
+    optional<ShardId> file_shard = per_shard_load ? DfsFileShard(path) : nullopt;
+    if (file_shard && *file_shard < shard_count()) {
+      proactor = pool.at(*file_shard);
+    } else if (paths.size() == 1 && shard_count() < pool.size()) {
       proactor = pool.at(shard_count());
     } else {
       proactor = pool.GetNextProactor();
     }
 
-    auto load_fiber = [this, aggregated_result, path = std::move(path)]() {
-      auto load_result = LoadRdb(path);
+    const bool is_summary = has_summary && i == 0;
+    auto load_fiber = [this, aggregated_result, path = std::move(path), is_summary,
+                       wait_summary = has_summary && i > 0, summary_done]() mutable {
+      if (wait_summary)
+        summary_done.Wait();
+
+      uint64_t journal_generation = 0;
+      auto load_result = LoadRdb(path, &journal_generation);
       if (load_result.has_value())
         aggregated_result->keys_read.fetch_add(*load_result);
       else
         aggregated_result->first_error = load_result.error();
+      if (journal_generation)
+        aggregated_result->journal_generation.store(journal_generation);
+
+      if (is_summary)
+        summary_done.Notify();
     };
     load_fibers.push_back(proactor->LaunchFiber(std::move(load_fiber)));
   }
@@ -1002,6 +1141,8 @@ std::optional<fb2::Future<GenericError>> ServerFamily::Load(const std::string& l
     RdbLoader::PerformPostLoad(&service_);
 
     LOG(INFO) << "Load finished, num keys read: " << aggregated_result->keys_read;
+    if (recover_journal_)
+      RecoverJournal(aggregated_result->journal_generation);
     service_.SwitchState(GlobalState::LOADING, GlobalState::ACTIVE);
     future.Resolve(*(aggregated_result->first_error));
   };
@@ -1036,7 +1177,8 @@ void ServerFamily::SnapshotScheduling() {
   }
 }
 
-io::Result<size_t> ServerFamily::LoadRdb(const std::string& rdb_file) {
+io::Result<size_t> ServerFamily::LoadRdb(const std::string& rdb_file,
+                                         uint64_t* journal_generation) {
   error_code ec;
   io::ReadonlyFileOrError res = snapshot_storage_->OpenReadFile(rdb_file);
   if (res) {
@@ -1045,6 +1187,7 @@ io::Result<size_t> ServerFamily::LoadRdb(const std::string& rdb_file) {
     RdbLoader loader{&service_};
     ec = loader.Load(&fs);
     if (!ec) {
+      *journal_generation = loader.journal_generation();
       VLOG(1) << "Done loading RDB from " << rdb_file << ", keys loaded: " << loader.keys_loaded();
       VLOG(1) << "Loading finished after " << strings::HumanReadableElapsedTime(loader.load_time());
       return loader.keys_loaded();
@@ -1055,6 +1198,76 @@ io::Result<size_t> ServerFamily::LoadRdb(const std::string& rdb_file) {
   return nonstd::make_unexpected(ec);
 }
 
+// Executes the commands of a journal file, returns the number of executed commands.
+// A truncated entry at the end of the file is expected if the server crashed while writing it.
+static size_t ReplayJournalFile(const string& path, JournalExecutor* executor) {
+  auto file = fb2::OpenRead(path);
+  if (!file) {
+    LOG(ERROR) << "Could not open journal file " << path << " " << file.error().message();
+    return 0;
+  }
+
+  io::FileSource source{*file};
+  JournalReader reader{&source, 0};
+  size_t executed = 0;
+  while (true) {
+    auto entry = reader.ReadEntry();
+    if (!entry) {
+      LOG_IF(WARNING, entry.error() != errc::io_error)
+          << "Stopped replaying journal file " << path << " " << entry.error().message();
+      break;
+    }
+
+    // MULTI_COMMAND parts of a transaction are applied as they come, the recovery runs before
+    // any client can observe the intermediate state.
+    if (entry->opcode == journal::Op::COMMAND || entry->opcode == journal::Op::EXPIRED ||
+        entry->opcode == journal::Op::MULTI_COMMAND) {
+      executor->Execute(entry->dbid, entry->cmd);
+      ++executed;
+    }
+  }
+  return executed;
+}
+
+void ServerFamily::RecoverJournal(uint64_t generation) {
+  recover_journal_ = false;
+  string dir = GetFlag(FLAGS_journal_dir);
+
+  auto files = journal::ListJournalFiles(dir);
+  if (!files) {
+    LOG(ERROR) << "Could not list journal files in " << dir << " " << files.error().message();
+    exit(1);
+  }
+
+  // Files of every shard are replayed by a separate fiber. The shard of a key is fixed,
+  // so the entries of a key are applied in order even if the number of shards has changed.
+  absl::flat_hash_map<unsigned, vector<string>> shard_files;
+  uint64_t max_generation = generation;
+  for (journal::JournalFile& file : *files) {
+    max_generation = std::max(max_generation, file.generation);
+    if (file.generation >= generation)
+      shard_files[file.shard].push_back(std::move(file.path));
+  }
+
+  std::atomic<size_t> executed{0};
+  auto& pool = service_.proactor_pool();
+  vector<fb2::Fiber> fibers;
+  for (auto& [shard, paths] : shard_files) {
+    fibers.push_back(pool.at(shard % pool.size())->LaunchFiber([&, paths = &paths] {
+      JournalExecutor executor{&service_};
+      for (const string& path : *paths)
+        executed.fetch_add(ReplayJournalFile(path, &executor), memory_order_relaxed);
+    }));
+  }
+  for (auto& fiber : fibers)
+    fiber.Join();
+
+  LOG(INFO) << "Journal recovery finished, commands executed: " << executed;
+
+  journal_->SetPersistence(dir, max_generation + 1);
+  pool.AwaitFiberOnAll([this](auto*) { journal_->StartInThread(); });
+}
+
 enum MetricType { COUNTER, GAUGE, SUMMARY, HISTOGRAM };
 
 const char* MetricTypeName(MetricType type) {
@@ -1595,15 +1808,7 @@ void ServerFamily::SendInvalidationMessages() const {
   // send invalidation message (caused by flushdb) to all the clients which
   // turned on client tracking
   auto cb = [](unsigned thread_index, util::Connection* conn) {
-    facade::ConnectionContext* fc = static_cast<facade::Connection*>(conn)->cntx();
-    if (fc) {
-      ConnectionContext* cntx = static_cast<ConnectionContext*>(fc);
-      if (cntx->conn_state.tracking_info_.IsTrackingOn()) {
-        facade::Connection::InvalidationMessage x;
-        x.invalidate_due_to_flush = true;
-        cntx->conn()->SendInvalidationMessageAsync(x);
-      }
-    }
+    SendTrackingInvalidation(static_cast<facade::Connection*>(conn), {}, true);
   };
   for (auto* listener : listeners_) {
     listener->TraverseConnections(cb);
@@ -1685,7 +1890,7 @@ void ServerFamily::Client(CmdArgList args, ConnectionContext* cntx) {
   } else if (sub_cmd == "PAUSE") {
     return ClientPauseCmd(sub_args, GetNonPriviligedListeners(), cntx);
   } else if (sub_cmd == "TRACKING") {
-    return ClientTracking(sub_args, cntx);
+    return ClientTracking(sub_args, absl::MakeSpan(listeners_), cntx);
   } else if (sub_cmd == "KILL") {
     return ClientKill(sub_args, absl::MakeSpan(listeners_), cntx);
   } else if (sub_cmd == "CACHING") {
@@ -1881,6 +2086,8 @@ static void MergeDbSliceStats(const DbSlice::Stats& src, Metrics* dest) {
 
   dest->events += src.events;
   dest->small_string_bytes += src.small_string_bytes;
+  dest->huff_encode_total += src.huff_encode_total;
+  dest->huff_encode_success += src.huff_encode_success;
 }
 
 void ServerFamily::ResetStat() {
@@ -1944,6 +2151,7 @@ Metrics ServerFamily::GetMetrics() const {
       result.heap_used_bytes += shard->UsedMemory();
       MergeDbSliceStats(shard->db_slice().GetStats(), &result);
       result.shard_stats += shard->stats();
+      result.table_huge_page_stats += shard->table_huge_page_stats();
 
       if (shard->tiered_storage()) {
         result.tiered_stats += shard->tiered_storage()->GetStats();
@@ -2081,12 +2289,21 @@ void ServerFamily::Info(CmdArgList args, ConnectionContext* cntx) {
       }
     }
     append("table_used_memory", total.table_mem_usage);
+    if (const auto& huge = m.table_huge_page_stats; huge.reserved > 0) {
+      // Coverage is the percentage of the table memory that is backed by huge pages.
+      size_t table_bytes = huge.used + huge.fallback;
+      append("table_huge_pages_reserved", huge.reserved);
+      append("table_huge_pages_used", huge.used);
+      append("table_huge_pages_coverage", table_bytes ? huge.used * 100.0 / table_bytes : 100.0);
+    }
     append("num_buckets", total.bucket_count);
     append("num_entries", total.key_count);
     append("inline_keys", total.inline_keys);
     append("listpack_blobs", total.listpack_blob_cnt);
     append("listpack_bytes", total.listpack_bytes);
     append("small_string_bytes", m.small_string_bytes);
+    append("huffman_encode_total", m.huff_encode_total);
+    append("huffman_encode_success", m.huff_encode_success);
     append("pipeline_cache_bytes", m.facade_stats.conn_stats.pipeline_cmd_cache_bytes);
     append("dispatch_queue_bytes", m.facade_stats.conn_stats.dispatch_queue_bytes);
     append("dispatch_queue_subscriber_bytes",
@@ -2140,6 +2357,7 @@ void ServerFamily::Info(CmdArgList args, ConnectionContext* cntx) {
     append("instantaneous_output_kbps", -1);
     append("rejected_connections", -1);
     append("expired_keys", m.events.expired_keys);
+    append("expired_members", m.events.expired_members);
     append("evicted_keys", m.events.evicted_keys);
     append("hard_evictions", m.events.hard_evictions);
     append("garbage_checked", m.events.garbage_checked);
@@ -2234,12 +2452,18 @@ void ServerFamily::Info(CmdArgList args, ConnectionContext* cntx) {
     append("last_failed_save", save_info.last_error_time);
     append("last_error", save_info.last_error.Format());
     append("last_failed_save_duration_sec", save_info.failed_duration_sec);
+
+    if (journal_->IsPersistent())
+      append("journal_write_error", journal_->HasFileError());
   }
 
   if (should_enter("TRANSACTION", true)) {
     append("tx_shard_polls", m.shard_stats.poll_execution_total);
     append("tx_shard_immediate_total", m.shard_stats.tx_immediate_total);
     append("tx_shard_ooo_total", m.shard_stats.tx_ooo_total);
+    append("tx_blocked_wakeup_total", m.shard_stats.blocked_wakeup_total);
+    append("tx_blocked_wakeup_batch_total", m.shard_stats.blocked_wakeup_batch_total);
+    append("tx_blocked_wakeup_latency_usec", m.shard_stats.blocked_wakeup_latency_usec);
     append("tx_global_total", m.coordinator_stats.tx_global_cnt);
     append("tx_normal_total", m.coordinator_stats.tx_normal_cnt);
     append("tx_inline_runs_total", m.coordinator_stats.tx_inline_runs);
@@ -2481,7 +2705,8 @@ void ServerFamily::AddReplicaOf(CmdArgList args, ConnectionContext* cntx) {
   LOG(INFO) << "Add Replica " << *replicaof_args;
 
   auto add_replica = make_unique<Replica>(replicaof_args->host, replicaof_args->port, &service_,
-                                          master_replid(), replicaof_args->slot_range);
+                                          master_replid(), replicaof_args->slot_range,
+                                          replicaof_args->shm_transport);
   error_code ec = add_replica->Start(cntx);
   if (!ec) {
     cluster_replicas_.push_back(std::move(add_replica));
@@ -2544,7 +2769,8 @@ void ServerFamily::ReplicaOfInternal(CmdArgList args, ConnectionContext* cntx,
 
   // Create a new replica and assing it
   auto new_replica = make_shared<Replica>(replicaof_args->host, replicaof_args->port, &service_,
-                                          master_replid(), replicaof_args->slot_range);
+                                          master_replid(), replicaof_args->slot_range,
+                                          replicaof_args->shm_transport);
 
   replica_ = new_replica;
 
@@ -2715,7 +2941,7 @@ void ServerFamily::ReplConf(CmdArgList args, ConnectionContext* cntx) {
         return;
       }
       VLOG(2) << "Received client ACK=" << ack;
-      cntx->replication_flow->last_acked_lsn = ack;
+      dfly_cmd_->OnFlowAck(cntx->replication_flow, ack);
       return;
     } else if (cmd == "ACL-CHECK") {
       // TODO(kostasrim): Remove this branch 20/6/2024
@@ -2776,6 +3002,94 @@ void ServerFamily::Role(CmdArgList args, ConnectionContext* cntx) {
   }
 }
 
+namespace {
+
+// A token is "<master replid>:<lsn of shard 0>,<lsn of shard 1>,...".
+bool ParseReplToken(string_view token, string_view* master_id, vector<LSN>* lsns) {
+  size_t pos = token.find(':');
+  if (pos == string_view::npos)
+    return false;
+
+  *master_id = token.substr(0, pos);
+  for (string_view part : absl::StrSplit(token.substr(pos + 1), ',')) {
+    if (!absl::SimpleAtoi(part, &lsns->emplace_back()))
+      return false;
+  }
+  return !master_id->empty();
+}
+
+}  // namespace
+
+void ServerFamily::ReplToken(CmdArgList args, ConnectionContext* cntx) {
+  auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+  CmdArgParser parser{args};
+
+  // REPLTOKEN returns the journal LSNs of all shards, which cover every write that was
+  // acknowledged to the caller before.
+  if (!parser.HasNext()) {
+    if (!ServerState::tlocal()->is_master)
+      return cntx->SendError("REPLTOKEN can only be issued on a master");
+
+    vector<LSN> lsns(shard_set->size());
+    shard_set->RunBriefInParallel([&](EngineShard* shard) {
+      auto* journal = shard->journal();
+      lsns[shard->shard_id()] = journal ? journal->GetLsn() : 0;
+    });
+    return rb->SendBulkString(StrCat(master_replid_, ":", absl::StrJoin(lsns, ",")));
+  }
+
+  // REPLTOKEN WAIT <token> <timeout_ms> replies with 1 once this replica has applied all the
+  // writes covered by the token, or with 0 if the timeout expires first.
+  parser.ExpectTag("WAIT");
+  auto [token, timeout_ms] = parser.Next<string_view, uint32_t>();
+  if (auto err = parser.Error(); err)
+    return cntx->SendError(err->MakeReply());
+
+  string_view master_id;
+  vector<LSN> lsns;
+  if (!ParseReplToken(token, &master_id, &lsns))
+    return cntx->SendError("invalid replication token");
+
+  if (ServerState::tlocal()->is_master) {
+    if (master_id != master_replid_)
+      return cntx->SendError("replication token was issued by another master");
+    return rb->SendLong(1);
+  }
+
+  shared_ptr<Replica> repl_ptr;
+  {
+    unique_lock lk(replicaof_mu_);
+    repl_ptr = replica_;
+  }
+  if (!repl_ptr || repl_ptr->GetInfo().master_id != master_id)
+    return cntx->SendError("replication token was issued by another master");
+
+  auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeout_ms);
+  rb->SendLong(repl_ptr->WaitForOffsets(lsns, deadline) ? 1 : 0);
+}
+
+void ServerFamily::Wait(CmdArgList args, ConnectionContext* cntx) {
+  CmdArgParser parser{args};
+  auto [num_replicas, timeout_ms] = parser.Next<uint32_t, uint64_t>();
+  if (auto err = parser.Error(); err)
+    return cntx->SendError(err->MakeReply());
+
+  if (!ServerState::tlocal()->is_master)
+    return cntx->SendError("WAIT cannot be used with replica instances");
+
+  // The journal LSNs of all shards cover every write that was acknowledged to the caller.
+  vector<LSN> lsns(shard_set->size());
+  shard_set->RunBriefInParallel([&](EngineShard* shard) {
+    auto* journal = shard->journal();
+    lsns[shard->shard_id()] = journal ? journal->GetLsn() : 0;
+  });
+
+  auto deadline = timeout_ms ? chrono::steady_clock::now() + chrono::milliseconds(timeout_ms)
+                             : chrono::steady_clock::time_point::max();
+  unsigned acked = dfly_cmd_->WaitForAcks(lsns, num_replicas, deadline);
+  cntx->reply_builder()->SendLong(acked);
+}
+
 void ServerFamily::Script(CmdArgList args, ConnectionContext* cntx) {
   ToUpper(&args.front());
 
@@ -2923,6 +3237,8 @@ constexpr uint32_t kReplicaOf = ADMIN | SLOW | DANGEROUS;
 constexpr uint32_t kReplTakeOver = DANGEROUS;
 constexpr uint32_t kReplConf = ADMIN | SLOW | DANGEROUS;
 constexpr uint32_t kRole = ADMIN | FAST | DANGEROUS;
+constexpr uint32_t kReplToken = SLOW | CONNECTION;
+constexpr uint32_t kWait = SLOW | CONNECTION;
 constexpr uint32_t kSlowLog = ADMIN | SLOW | DANGEROUS;
 constexpr uint32_t kScript = SLOW | SCRIPTING;
 constexpr uint32_t kModule = ADMIN | SLOW | DANGEROUS;
@@ -2959,6 +3275,8 @@ void ServerFamily::Register(CommandRegistry* registry) {
              ReplTakeOver)
       << CI{"REPLCONF", CO::ADMIN | CO::LOADING, -1, 0, 0, acl::kReplConf}.HFUNC(ReplConf)
       << CI{"ROLE", CO::LOADING | CO::FAST | CO::NOSCRIPT, 1, 0, 0, acl::kRole}.HFUNC(Role)
+      << CI{"REPLTOKEN", CO::LOADING | CO::NOSCRIPT, -1, 0, 0, acl::kReplToken}.HFUNC(ReplToken)
+      << CI{"WAIT", CO::NOSCRIPT, 3, 0, 0, acl::kWait}.HFUNC(Wait)
       << CI{"SLOWLOG", CO::ADMIN | CO::FAST, -2, 0, 0, acl::kSlowLog}.HFUNC(SlowLog)
       << CI{"SCRIPT", CO::NOSCRIPT | CO::NO_KEY_TRANSACTIONAL, -2, 0, 0, acl::kScript}.HFUNC(Script)
       << CI{"DFLY", CO::ADMIN | CO::GLOBAL_TRANS | CO::HIDDEN, -2, 0, 0, acl::kDfly}.HFUNC(Dfly)
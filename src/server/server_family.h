@@ -81,6 +81,7 @@ struct Metrics {
 
   facade::FacadeStats facade_stats;  // client stats and buffer sizes
   TieredStats tiered_stats;
+  HugePageMemoryResource::Stats table_huge_page_stats;  // huge pages backing the hash tables
 
   SearchStats search_stats;
   ServerState::Stats coordinator_stats;  // stats on transaction running
@@ -91,6 +92,7 @@ struct Metrics {
 
   size_t heap_used_bytes = 0;
   size_t small_string_bytes = 0;
+  uint64_t huff_encode_total = 0, huff_encode_success = 0;
   uint32_t traverse_ttl_per_sec = 0;
   uint32_t delete_ttl_per_sec = 0;
   uint64_t fiber_switch_cnt = 0;
@@ -258,6 +260,8 @@ class ServerFamily {
   void ReplTakeOver(CmdArgList args, ConnectionContext* cntx);
   void ReplConf(CmdArgList args, ConnectionContext* cntx);
   void Role(CmdArgList args, ConnectionContext* cntx);
+  void ReplToken(CmdArgList args, ConnectionContext* cntx);
+  void Wait(CmdArgList args, ConnectionContext* cntx);
   void Save(CmdArgList args, ConnectionContext* cntx);
   void BgSave(CmdArgList args, ConnectionContext* cntx);
   void Script(CmdArgList args, ConnectionContext* cntx);
@@ -276,7 +280,11 @@ class ServerFamily {
   void ReplicaOfInternal(CmdArgList args, ConnectionContext* cntx, ActionOnConnectionFail on_error);
 
   // Returns the number of loaded keys if successful.
-  io::Result<size_t> LoadRdb(const std::string& rdb_file);
+  io::Result<size_t> LoadRdb(const std::string& rdb_file, uint64_t* journal_generation);
+
+  // Replays the persistent journal files of generation and later, then starts the
+  // persistent journal. Runs in the LOADING state after the snapshot is loaded.
+  void RecoverJournal(uint64_t generation);
 
   void SnapshotScheduling();
 
@@ -325,6 +333,8 @@ class ServerFamily {
   // be --dbfilename.
   bool save_on_shutdown_{true};
 
+  bool recover_journal_ = false;  // set until the journal is replayed on startup
+
   util::fb2::Done schedule_done_;
   std::unique_ptr<util::fb2::FiberQueueThreadPool> fq_threadpool_;
   std::shared_ptr<detail::SnapshotStorage> snapshot_storage_;
@@ -4,14 +4,19 @@
 
 #include "server/server_family.h"
 
+#include <absl/flags/reflection.h>
 #include <absl/strings/match.h>
 
 #include "absl/strings/str_cat.h"
+#include "base/flags.h"
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "facade/facade_test.h"
 #include "server/test_utils.h"
 
+ABSL_DECLARE_FLAG(dfly::MemoryBytesFlag, tracking_table_max_bytes);
+ABSL_DECLARE_FLAG(uint32_t, tracking_table_buckets);
+
 using namespace testing;
 using namespace std;
 using namespace util;
@@ -419,7 +424,7 @@ TEST_F(ServerFamilyTest, ClientTrackingUpdateKey) {
   Run({"GET", "FOO"});
   Run({"SET", "FOO", "10"});
   const auto& msg = GetInvalidationMessage("IO0", 0);
-  EXPECT_EQ(msg.key, "FOO");
+  EXPECT_THAT(msg.keys, ElementsAre("FOO"));
 
   // make sure invalidation message only gets sent once.
   Run({"GET", "FOO"});
@@ -431,7 +436,7 @@ TEST_F(ServerFamilyTest, ClientTrackingUpdateKey) {
   pp_->at(1)->Await([&] { return Run({"SET", "FOO", "30"}); });
   pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
   const auto& msg2 = GetInvalidationMessage("IO0", 1);
-  EXPECT_EQ(msg2.key, "FOO");
+  EXPECT_THAT(msg2.keys, ElementsAre("FOO"));
 
   // case 4. test multi command
   Run({"MGET", "X1", "X2", "X3", "X4", "Y1", "Y2", "Y3", "Y4", "Z1", "Z2", "Z3", "Z4"});
@@ -440,7 +445,7 @@ TEST_F(ServerFamilyTest, ClientTrackingUpdateKey) {
   EXPECT_EQ(InvalidationMessagesLen("IO0"), 6);
   std::vector<std::string_view> keys_invalidated;
   for (unsigned int i = 2; i < 6; ++i)
-    keys_invalidated.push_back(GetInvalidationMessage("IO0", i).key);
+    keys_invalidated.push_back(GetInvalidationMessage("IO0", i).keys[0]);
   ASSERT_THAT(keys_invalidated, ElementsAre("X1", "Y3", "Z2", "Z4"));
 
   // The following doesn't work correctly as we currently can't mock listener.
@@ -455,7 +460,7 @@ TEST_F(ServerFamilyTest, ClientTrackingDeleteKey) {
   Run({"GET", "FOO"});
   pp_->at(1)->Await([&] { return Run({"DEL", "FOO"}); });
   pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
-  EXPECT_EQ(GetInvalidationMessage("IO0", 0).key, "FOO");
+  EXPECT_THAT(GetInvalidationMessage("IO0", 0).keys, ElementsAre("FOO"));
 }
 
 TEST_F(ServerFamilyTest, ClientTrackingRenameKey) {
@@ -465,7 +470,7 @@ TEST_F(ServerFamilyTest, ClientTrackingRenameKey) {
   Run({"GET", "FOO"});
   pp_->at(1)->Await([&] { return Run({"RENAME", "FOO", "BAR"}); });
   pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
-  EXPECT_EQ(GetInvalidationMessage("IO0", 0).key, "FOO");
+  EXPECT_THAT(GetInvalidationMessage("IO0", 0).keys, ElementsAre("FOO"));
 }
 
 TEST_F(ServerFamilyTest, ClientTrackingExpireKey) {
@@ -478,7 +483,7 @@ TEST_F(ServerFamilyTest, ClientTrackingExpireKey) {
   auto resp = Run({"GET", "C"});
   EXPECT_THAT(resp, ArgType(RespExpr::NIL));
   EXPECT_EQ(InvalidationMessagesLen("IO0"), 1);
-  EXPECT_EQ(GetInvalidationMessage("IO0", 0).key, "C");
+  EXPECT_THAT(GetInvalidationMessage("IO0", 0).keys, ElementsAre("C"));
 }
 
 TEST_F(ServerFamilyTest, ClientTrackingSelectDB) {
@@ -490,7 +495,114 @@ TEST_F(ServerFamilyTest, ClientTrackingSelectDB) {
   pp_->at(1)->Await([&] { return Run({"SET", "C", "1000"}); });
   pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
   EXPECT_EQ(InvalidationMessagesLen("IO0"), 1);
-  EXPECT_EQ(GetInvalidationMessage("IO0", 0).key, "C");
+  EXPECT_THAT(GetInvalidationMessage("IO0", 0).keys, ElementsAre("C"));
+}
+
+TEST_F(ServerFamilyTest, ClientTrackingBroadcast) {
+  // RESP2 is allowed only with REDIRECT.
+  auto resp = Run({"CLIENT", "TRACKING", "ON", "BCAST"});
+  EXPECT_THAT(resp.GetString(),
+              "ERR Client tracking is currently not supported for RESP2. Please use RESP3.");
+  resp = Run({"CLIENT", "TRACKING", "ON", "REDIRECT", "1000"});
+  EXPECT_THAT(resp, ErrArg("The client ID you want redirect to does not exist"));
+
+  Run({"HELLO", "3"});
+  resp = Run({"CLIENT", "TRACKING", "ON", "PREFIX", "a"});
+  EXPECT_THAT(resp, ErrArg("PREFIX option requires BCAST mode"));
+  resp = Run({"CLIENT", "TRACKING", "ON", "BCAST", "OPTIN"});
+  EXPECT_THAT(resp, ErrArg("not compatible with BCAST"));
+  resp = Run({"CLIENT", "TRACKING", "ON", "BCAST", "PREFIX", "a", "PREFIX", "ab"});
+  EXPECT_THAT(resp, ErrArg("Prefix 'ab' overlaps with another provided prefix 'a'"));
+
+  resp = Run({"CLIENT", "TRACKING", "ON", "BCAST", "PREFIX", "user:", "PREFIX", "item:"});
+  EXPECT_EQ(resp, "OK");
+
+  // Keys do not have to be read in order to be invalidated.
+  pp_->at(1)->Await(
+      [&] { return Run({"MSET", "user:1", "a", "other", "b", "item:1", "c", "user:2", "d"}); });
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+
+  // Keys of the same hop are sent together, so there is at most a message per shard.
+  vector<string> keys;
+  size_t num_messages = InvalidationMessagesLen("IO0");
+  EXPECT_LE(num_messages, shard_set->size());
+  for (size_t i = 0; i < num_messages; ++i) {
+    const auto& msg = GetInvalidationMessage("IO0", i);
+    keys.insert(keys.end(), msg.keys.begin(), msg.keys.end());
+  }
+  EXPECT_THAT(keys, UnorderedElementsAre("user:1", "item:1", "user:2"));
+
+  Run({"DEL", "other"});
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  EXPECT_EQ(InvalidationMessagesLen("IO0"), num_messages);
+
+  Run({"CLIENT", "TRACKING", "OFF"});
+  Run({"SET", "user:1", "x"});
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  EXPECT_EQ(InvalidationMessagesLen("IO0"), num_messages);
+}
+
+TEST_F(ServerFamilyTest, ClientTrackingBroadcastNoLoop) {
+  Run({"HELLO", "3"});
+  EXPECT_EQ(Run({"CLIENT", "TRACKING", "ON", "BCAST", "NOLOOP"}), "OK");
+
+  // Own writes are not sent back.
+  Run({"SET", "a", "1"});
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  EXPECT_EQ(InvalidationMessagesLen("IO0"), 0);
+
+  pp_->at(1)->Await([&] { return Run({"SET", "a", "2"}); });
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  ASSERT_EQ(InvalidationMessagesLen("IO0"), 1);
+  EXPECT_THAT(GetInvalidationMessage("IO0", 0).keys, ElementsAre("a"));
+}
+
+TEST_F(ServerFamilyTest, ClientTrackingBoundedTable) {
+  absl::FlagSaver fs;
+  // A budget of a single byte per shard, only the first key fits into the table.
+  absl::SetFlag(&FLAGS_tracking_table_max_bytes, MemoryBytesFlag{shard_set->size()});
+  absl::SetFlag(&FLAGS_tracking_table_buckets, 1);
+
+  Run({"HELLO", "3"});
+  Run({"CLIENT", "TRACKING", "ON"});
+
+  // The keys beyond the table share a bucket.
+  vector<string> keys;
+  for (unsigned i = 0; i < 20; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+    Run({"GET", keys.back()});
+  }
+
+  // No invalidation is missed, and every key is invalidated on its own.
+  vector<string> invalidated;
+  for (const auto& key : keys) {
+    pp_->at(1)->Await([&] { return Run({"SET", key, "1"}); });
+  }
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  size_t num_messages = InvalidationMessagesLen("IO0");
+  for (size_t i = 0; i < num_messages; ++i) {
+    const auto& msg = GetInvalidationMessage("IO0", i);
+    EXPECT_FALSE(msg.invalidate_due_to_flush);
+    invalidated.insert(invalidated.end(), msg.keys.begin(), msg.keys.end());
+  }
+  EXPECT_THAT(invalidated, IsSupersetOf(keys));
+
+  // Buckets stay populated, so keys that were never read can be invalidated as well.
+  for (unsigned i = 0; i < 20; ++i) {
+    pp_->at(1)->Await([&] { return Run({"SET", absl::StrCat("other", i), "1"}); });
+  }
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  EXPECT_GT(InvalidationMessagesLen("IO0"), num_messages);
+
+  // Turning tracking off clears the buckets of the client.
+  Run({"CLIENT", "TRACKING", "OFF"});
+  Run({"CLIENT", "TRACKING", "ON"});
+  num_messages = InvalidationMessagesLen("IO0");
+  for (unsigned i = 0; i < 20; ++i) {
+    pp_->at(1)->Await([&] { return Run({"SET", absl::StrCat("other", i), "2"}); });
+  }
+  pp_->AwaitFiberOnAll([](ProactorBase* pb) {});
+  EXPECT_EQ(InvalidationMessagesLen("IO0"), num_messages);
 }
 
 TEST_F(ServerFamilyTest, ClientTrackingNonTransactionalBug) {
@@ -12,6 +12,7 @@
 #include "core/interpreter.h"
 #include "server/acl/acl_log.h"
 #include "server/acl/user_registry.h"
+#include "server/client_tracking.h"
 #include "server/common.h"
 #include "server/script_mgr.h"
 #include "server/slowlog.h"
@@ -215,6 +216,10 @@ class ServerState {  // public struct - to allow initialization.
     return monitors_;
   }
 
+  TrackingPrefixTable& tracking_prefixes() {
+    return tracking_prefixes_;
+  }
+
   const absl::flat_hash_map<std::string, base::Histogram>& call_latency_histos() const {
     return call_latency_histos_;
   }
@@ -304,6 +309,7 @@ class ServerState {  // public struct - to allow initialization.
   Counter qps_;
 
   MonitorsRepo monitors_;
+  TrackingPrefixTable tracking_prefixes_;  // broadcasting tracking connections of this thread.
 
   absl::flat_hash_map<std::string, base::Histogram> call_latency_histos_;
   uint32_t thread_index_ = 0;
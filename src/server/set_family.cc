@@ -13,6 +13,7 @@ extern "C" {
 #include "base/flags.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "core/intset_ops.h"
 #include "core/string_set.h"
 #include "facade/cmd_arg_parser.h"
 #include "server/acl/acl_commands_def.h"
@@ -37,6 +38,8 @@ using ResultStringVec = vector<OpResult<StringVec>>;
 using ResultSetView = OpResult<absl::flat_hash_set<std::string_view>>;
 using SvArray = vector<std::string_view>;
 using SetType = pair<void*, unsigned>;
+using intset_ops::IntVec;
+using container_utils::ReadSlice;
 
 namespace {
 
@@ -255,6 +258,26 @@ int32_t GetExpiry(const DbContext& db_context, const SetType& st, string_view me
 
 void FindInSet(StringVec& memberships, const DbContext& db_context, const SetType& st,
                facade::ArgRange members) {
+  if (st.second == kEncodingIntSet) {
+    // Probe all members in a single merge pass over the intset.
+    IntVec set_vals, probes;
+    intset_ops::Decode((const intset*)st.first, &set_vals);
+
+    vector<uint8_t> parsed;
+    parsed.reserve(members.Size());
+    for (string_view member : members) {
+      long long llval;
+      parsed.push_back(string2ll(member.data(), member.size(), &llval));
+      probes.push_back(parsed.back() ? llval : 0);
+    }
+
+    vector<uint8_t> found(probes.size());
+    intset_ops::Contains(set_vals, probes, found.data());
+    for (size_t i = 0; i < found.size(); ++i)
+      memberships.emplace_back(to_string(parsed[i] && found[i]));
+    return;
+  }
+
   for (string_view member : members) {
     bool status = IsInSet(db_context, st, member);
     memberships.emplace_back(to_string(status));
@@ -273,11 +296,15 @@ void DiffStrSet(const DbContext& db_context, const SetType& st,
   }
 }
 
-void InterStrSet(const DbContext& db_context, const vector<SetType>& vec, StringVec* result) {
+void InterStrSet(const DbContext& db_context, const vector<SetType>& vec, unsigned limit,
+                 StringVec* result) {
   if (true) {
     StringSet* ss = (StringSet*)vec.front().first;
     ss->set_time(MemberTimeSeconds(db_context.time_now_ms));
     for (const sds ptr : *ss) {
+      if (limit != 0 && result->size() >= limit)
+        break;
+
       std::string_view str{ptr, sdslen(ptr)};
       size_t j = 1;
       for (j = 1; j < vec.size(); ++j) {
@@ -349,6 +376,12 @@ StringVec RandMemberSet(const DbContext& db_context, const CompactObj& co,
   return RandMemberStrSet(db_context, co, generator, picks_count);
 }
 
+void AppendInts(const IntVec& vals, StringVec* dest) {
+  dest->reserve(dest->size() + vals.size());
+  for (int64_t val : vals)
+    dest->push_back(absl::StrCat(val));
+}
+
 vector<string> ToVec(absl::flat_hash_set<string>&& set) {
   vector<string> result(set.size());
   size_t i = 0;
@@ -585,6 +618,7 @@ OpResult<uint32_t> OpAddEx(const OpArgs& op_args, string_view key, uint32_t ttl_
   }
 
   uint32_t res = AddStrSet(op_args.db_cntx, vals, ttl_sec, &co);
+  db_slice.TrackMemberExpiry(op_args.db_cntx.db_index, key, co);
 
   return res;
 }
@@ -712,10 +746,20 @@ OpResult<StringVec> OpUnion(const OpArgs& op_args, ShardArgs::Iterator start,
   DCHECK(start != end);
   absl::flat_hash_set<string> uniques;
 
+  // Integer sets are merged in integer form and stringified once at the end.
+  IntVec ints, tmp, cur;
+
   for (; start != end; ++start) {
     auto find_res = op_args.shard->db_slice().FindReadOnly(op_args.db_cntx, *start, OBJ_SET);
     if (find_res) {
       const PrimeValue& pv = find_res.value()->second;
+      if (pv.Encoding() == kEncodingIntSet) {
+        intset_ops::Decode((const intset*)pv.RObjPtr(), &cur);
+        intset_ops::Union(ints, cur, &tmp);
+        ints.swap(tmp);
+        continue;
+      }
+
       if (IsDenseEncoding(pv)) {
         StringSet* ss = (StringSet*)pv.RObjPtr();
         ss->set_time(MemberTimeSeconds(op_args.db_cntx.time_now_ms));
@@ -732,9 +776,62 @@ OpResult<StringVec> OpUnion(const OpArgs& op_args, ShardArgs::Iterator start,
     }
   }
 
+  if (uniques.empty()) {
+    StringVec result;
+    AppendInts(ints, &result);
+    return result;
+  }
+
+  for (int64_t val : ints)
+    uniques.emplace(absl::StrCat(val));
+
   return ToVec(std::move(uniques));
 }
 
+// OpDiff for an integer source set. Subtracts other integer sets in integer form and
+// checks the remaining members against string sets at the end.
+OpResult<StringVec> OpDiffIntSet(const OpArgs& op_args, const intset* src,
+                                 ShardArgs::Iterator start, ShardArgs::Iterator end) {
+  IntVec result, tmp, cur;
+  intset_ops::Decode(src, &result);
+
+  vector<SetType> str_sets;
+  for (; start != end; ++start) {
+    auto diff_res = op_args.shard->db_slice().FindReadOnly(op_args.db_cntx, *start, OBJ_SET);
+    if (!diff_res) {
+      if (diff_res.status() == OpStatus::WRONG_TYPE) {
+        return OpStatus::WRONG_TYPE;
+      }
+      continue;  // KEY_NOTFOUND
+    }
+
+    const PrimeValue& pv = diff_res.value()->second;
+    if (pv.Encoding() == kEncodingIntSet) {
+      intset_ops::Decode((const intset*)pv.RObjPtr(), &cur);
+      intset_ops::Diff(result, cur, &tmp);
+      result.swap(tmp);
+    } else {
+      str_sets.emplace_back(pv.RObjPtr(), pv.Encoding());
+    }
+  }
+
+  StringVec res;
+  res.reserve(result.size());
+  for (int64_t val : result) {
+    bool found = false;
+    for (const SetType& st : str_sets) {
+      if (IsInSet(op_args.db_cntx, st, val)) {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      res.push_back(absl::StrCat(val));
+  }
+
+  return res;
+}
+
 // Read-only OpDiff op on sets.
 OpResult<StringVec> OpDiff(const OpArgs& op_args, ShardArgs::Iterator start,
                            ShardArgs::Iterator end) {
@@ -747,8 +844,11 @@ OpResult<StringVec> OpDiff(const OpArgs& op_args, ShardArgs::Iterator start,
     return find_res.status();
   }
 
-  absl::flat_hash_set<string> uniques;
   const PrimeValue& pv = find_res.value()->second;
+  if (pv.Encoding() == kEncodingIntSet)
+    return OpDiffIntSet(op_args, (const intset*)pv.RObjPtr(), ++start, end);
+
+  absl::flat_hash_set<string> uniques;
   if (IsDenseEncoding(pv)) {
     StringSet* ss = (StringSet*)pv.RObjPtr();
     ss->set_time(MemberTimeSeconds(op_args.db_cntx.time_now_ms));
@@ -789,8 +889,9 @@ OpResult<StringVec> OpDiff(const OpArgs& op_args, ShardArgs::Iterator start,
   return ToVec(std::move(uniques));
 }
 
-// Read-only OpInter op on sets.
-OpResult<StringVec> OpInter(const Transaction* t, EngineShard* es, bool remove_first) {
+// Read-only OpInter op on sets. If limit is not 0, stops after finding limit members.
+OpResult<StringVec> OpInter(const Transaction* t, EngineShard* es, bool remove_first,
+                            unsigned limit = 0) {
   ShardArgs args = t->GetShardArgs(es->shard_id());
   auto it = args.begin();
   if (remove_first) {
@@ -811,9 +912,9 @@ OpResult<StringVec> OpInter(const Transaction* t, EngineShard* es, bool remove_f
     }
 
     container_utils::IterateSet(find_res.value()->second,
-                                [&result](container_utils::ContainerEntry ce) {
+                                [&result, limit](container_utils::ContainerEntry ce) {
                                   result.push_back(ce.ToString());
-                                  return true;
+                                  return limit == 0 || result.size() < limit;
                                 });
     return result;
   }
@@ -848,14 +949,26 @@ OpResult<StringVec> OpInter(const Transaction* t, EngineShard* es, bool remove_f
 
   int encoding = sets.front().second;
   if (encoding == kEncodingIntSet) {
-    int ii = 0;
-    intset* is = (intset*)sets.front().first;
-    int64_t intele;
+    const intset* is = (const intset*)sets.front().first;
+    IntVec inter, tmp, cur;
+    intset_ops::Decode(is, &inter);
+
+    // Intersect with other integer sets in integer form first, they are the cheapest to probe.
+    for (size_t j = 1; j < sets.size() && !inter.empty(); j++) {
+      if (sets[j].second != kEncodingIntSet || sets[j].first == is)
+        continue;
+      intset_ops::Decode((const intset*)sets[j].first, &cur);
+      intset_ops::Intersect(inter, cur, &tmp);
+      inter.swap(tmp);
+    }
+
+    for (int64_t intele : inter) {
+      if (limit != 0 && result.size() >= limit)
+        break;
 
-    while (intsetGet(is, ii++, &intele)) {
       size_t j = 1;
       for (j = 1; j < sets.size(); j++) {
-        if (sets[j].first != is && !IsInSet(t->GetDbContext(), sets[j], intele))
+        if (sets[j].second != kEncodingIntSet && !IsInSet(t->GetDbContext(), sets[j], intele))
           break;
       }
 
@@ -865,7 +978,201 @@ OpResult<StringVec> OpInter(const Transaction* t, EngineShard* es, bool remove_f
       }
     }
   } else {
-    InterStrSet(t->GetDbContext(), sets, &result);
+    InterStrSet(t->GetDbContext(), sets, limit, &result);
+  }
+
+  return result;
+}
+
+// Finds the sets of the shard, optionally skipping the first (destination) key.
+OpResult<vector<SetType>> FindSets(const Transaction* t, EngineShard* es, bool remove_first) {
+  ShardArgs args = t->GetShardArgs(es->shard_id());
+  auto it = args.begin();
+  if (remove_first)
+    ++it;
+
+  vector<SetType> sets;
+  OpStatus status = OpStatus::OK;
+  for (; it != args.end(); ++it) {
+    auto find_res = es->db_slice().FindReadOnly(t->GetDbContext(), *it, OBJ_SET);
+    if (!find_res) {
+      if (status == OpStatus::OK || status == OpStatus::KEY_NOTFOUND ||
+          find_res.status() != OpStatus::KEY_NOTFOUND) {
+        status = find_res.status();
+      }
+      continue;
+    }
+    const PrimeValue& pv = find_res.value()->second;
+    sets.emplace_back(pv.RObjPtr(), pv.Encoding());
+  }
+
+  if (status != OpStatus::OK)
+    return status;
+  return sets;
+}
+
+// Per shard state of a multi-shard intersection.
+struct InterShardState {
+  OpStatus status = OpStatus::SKIPPED;  // SKIPPED if the shard holds no source keys.
+  uint32_t min_size = 0;                // size of the smallest set on the shard.
+  optional<StringVec> inter;            // local intersection, computed eagerly for small sets.
+  vector<uint8_t> found;                // whether each candidate is in all sets of the shard.
+};
+
+// Whether the last multi-shard intersection of the thread had only small sets. The shards can
+// not decide together whether to conclude in the first hop, so the next intersection is
+// expected to look alike: it is computed eagerly by all the shards and concludes in one hop.
+thread_local bool tl_small_inter = true;
+
+// Intersects sets spread over multiple shards. Instead of copying every partial intersection
+// to the coordinator, we find the shard with the smallest set, compute its local intersection
+// and ship only these candidates to the other shards for probing. Small sets are intersected
+// eagerly in the first hop, and when the previous intersection had only small sets, all the
+// shards are, so that intersections of small sets take a single hop.
+// dest_shard holds the destination key that is skipped, if set.
+OpResult<StringVec> InterMultiShard(Transaction* tx, optional<ShardId> dest_shard, unsigned limit,
+                                    bool conclude) {
+  // Sets below this size are intersected in the first hop.
+  constexpr uint32_t kEagerInterSize = 512;
+
+  vector<InterShardState> states(shard_set->size());
+  bool single_shard = tx->GetUniqueShardCnt() == 1;
+  bool all_shards_eager = single_shard || tl_small_inter;
+  auto is_dest_only = [&](Transaction* t, ShardId sid) {
+    return dest_shard == sid && t->GetShardArgs(sid).Size() == 1;
+  };
+
+  auto size_cb = [&](Transaction* t, EngineShard* shard) {
+    ShardId sid = shard->shard_id();
+    if (is_dest_only(t, sid))
+      return OpStatus::OK;
+
+    auto& state = states[sid];
+    auto sets = FindSets(t, shard, dest_shard == sid);
+    state.status = sets.status();
+    if (!sets)
+      return OpStatus::OK;
+
+    state.min_size = UINT32_MAX;
+    for (const SetType& st : *sets)
+      state.min_size = min(state.min_size, SetTypeLen(t->GetDbContext(), st));
+
+    if (all_shards_eager || state.min_size <= kEagerInterSize) {
+      auto res = OpInter(t, shard, dest_shard == sid, single_shard ? limit : 0);
+      if (res)
+        state.inter = std::move(*res);
+    }
+    return OpStatus::OK;
+  };
+
+  // When all the shards are eager the intersection is complete after the first hop, so it
+  // concludes right away.
+  bool concluded = conclude && all_shards_eager;
+  tx->Execute(std::move(size_cb), concluded);
+
+  if (!single_shard) {
+    tl_small_inter = all_of(states.begin(), states.end(), [&](const InterShardState& state) {
+      return state.status != OpStatus::OK || state.min_size <= kEagerInterSize;
+    });
+  }
+
+  auto finish = [&](OpResult<StringVec> res) {
+    if (conclude && !concluded)
+      tx->Conclude();
+    return res;
+  };
+
+  for (const auto& state : states) {
+    if (!base::_in(state.status, {OpStatus::OK, OpStatus::SKIPPED, OpStatus::KEY_NOTFOUND}))
+      return finish(state.status);
+  }
+
+  optional<ShardId> min_shard;
+  unsigned participants = 0;
+  bool all_eager = true;
+  for (ShardId sid = 0; sid < states.size(); ++sid) {
+    const auto& state = states[sid];
+    if (state.status == OpStatus::KEY_NOTFOUND)
+      return finish(StringVec{});  // empty set.
+    if (state.status == OpStatus::SKIPPED)
+      continue;
+
+    ++participants;
+    all_eager &= state.inter.has_value();
+    if (!min_shard || state.min_size < states[*min_shard].min_size)
+      min_shard = sid;
+  }
+
+  if (!min_shard)
+    return finish(StringVec{});
+
+  if (all_eager) {
+    ResultStringVec result_vec(states.size(), OpStatus::SKIPPED);
+    for (ShardId sid = 0; sid < states.size(); ++sid) {
+      if (states[sid].inter)
+        result_vec[sid] = std::move(*states[sid].inter);
+    }
+
+    OpResult<SvArray> res = InterResultVec(result_vec, participants, limit);
+    if (!res)
+      return finish(res.status());
+    return finish(StringVec{res->begin(), res->end()});
+  }
+
+  bool need_probe = participants > 1;
+  StringVec candidates;
+  if (states[*min_shard].inter) {
+    candidates = std::move(*states[*min_shard].inter);
+  } else {
+    OpResult<StringVec> res;
+    auto inter_cb = [&](Transaction* t, EngineShard* shard) {
+      if (shard->shard_id() == *min_shard) {
+        res = OpInter(t, shard, dest_shard == *min_shard, need_probe ? 0 : limit);
+      }
+      return OpStatus::OK;
+    };
+    tx->Execute(std::move(inter_cb), conclude && !need_probe);
+    if (!need_probe)
+      return res;
+    if (!res)
+      return finish(res.status());
+    candidates = std::move(*res);
+  }
+
+  if (candidates.empty())
+    return finish(std::move(candidates));
+
+  auto probe_cb = [&](Transaction* t, EngineShard* shard) {
+    ShardId sid = shard->shard_id();
+    auto& state = states[sid];
+    if (sid == *min_shard || state.status != OpStatus::OK)
+      return OpStatus::OK;
+
+    // Can not fail, the keys are locked since the first hop.
+    auto sets = FindSets(t, shard, dest_shard == sid);
+    DCHECK(sets);
+    state.found.resize(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      state.found[i] = all_of(sets->begin(), sets->end(), [&](const SetType& st) {
+        return IsInSet(t->GetDbContext(), st, candidates[i]);
+      });
+    }
+    return OpStatus::OK;
+  };
+  tx->Execute(std::move(probe_cb), conclude);
+
+  StringVec result;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (limit != 0 && result.size() >= limit)
+      break;
+
+    bool in_all = true;
+    for (ShardId sid = 0; sid < states.size() && in_all; ++sid) {
+      if (sid != *min_shard && states[sid].status == OpStatus::OK)
+        in_all = states[sid].found[i];
+    }
+    if (in_all)
+      result.push_back(std::move(candidates[i]));
   }
 
   return result;
@@ -1237,7 +1544,60 @@ void SDiffStore(CmdArgList args, ConnectionContext* cntx) {
   cntx->SendLong(result_size);
 }
 
+// Reads the members of a set in slices. The cursor is the scan cursor of a dense set.
+OpStatus OpMembers(const OpArgs& op_args, string_view key, ReadSlice* slice) {
+  auto find_res = op_args.shard->db_slice().FindReadOnly(op_args.db_cntx, key, OBJ_SET);
+  if (!find_res) {
+    if (find_res.status() == OpStatus::KEY_NOTFOUND)
+      return OpStatus::OK;
+    return find_res.status();
+  }
+
+  const PrimeValue& pv = find_res.value()->second;
+  StringSet* ss = IsDenseEncoding(pv) ? (StringSet*)pv.RObjPtr() : nullptr;
+
+  // Expired members are removed while reading, so the size is known only after reading all.
+  if (!ss || pv.HasExpire() || ss->ExpirationUsed()) {
+    if (ss)
+      ss->set_time(MemberTimeSeconds(op_args.db_cntx.time_now_ms));
+
+    container_utils::IterateSet(pv, [slice](container_utils::ContainerEntry ce) {
+      slice->Add(ce);
+      return true;
+    });
+    slice->total = slice->size();
+    return OpStatus::OK;
+  }
+
+  auto scan_cb = [slice](const sds ptr) { slice->Add(string_view{ptr, sdslen(ptr)}); };
+  slice->total = ss->UpperBoundSize();
+  uint64_t cursor = slice->cursor;
+  do {
+    cursor = ss->Scan(cursor, scan_cb);
+  } while (cursor && !slice->Exhausted());
+
+  slice->cursor = cursor;
+  slice->done = cursor == 0;
+  return OpStatus::OK;
+}
+
 void SMembers(CmdArgList args, ConnectionContext* cntx) {
+  auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+
+  // Scripts get the members sorted, so they are not streamed.
+  if (!cntx->conn_state.script_info) {
+    string_view key = ArgS(args, 0);
+    auto cb = [key](const OpArgs& op_args, ReadSlice* slice) {
+      return OpMembers(op_args, key, slice);
+    };
+
+    OpStatus status =
+        container_utils::ScheduleSlicedRead(cntx->transaction, cb, rb, RedisReplyBuilder::SET);
+    if (status != OpStatus::OK)
+      cntx->SendError(status);
+    return;
+  }
+
   auto cb = [](Transaction* t, EngineShard* shard) { return OpInter(t, shard, false); };
 
   OpResult<StringVec> result = cntx->transaction->ScheduleSingleHopT(std::move(cb));
@@ -1245,10 +1605,7 @@ void SMembers(CmdArgList args, ConnectionContext* cntx) {
   if (result || result.status() == OpStatus::KEY_NOTFOUND) {
     StringVec& svec = result.value();
 
-    if (cntx->conn_state.script_info) {  // sort under script
-      sort(svec.begin(), svec.end());
-    }
-    auto* rb = static_cast<RedisReplyBuilder*>(cntx->reply_builder());
+    sort(svec.begin(), svec.end());
     rb->SendStringArr(*result, RedisReplyBuilder::SET);
   } else {
     cntx->SendError(result.status());
@@ -1288,18 +1645,9 @@ void SRandMember(CmdArgList args, ConnectionContext* cntx) {
 }
 
 void SInter(CmdArgList args, ConnectionContext* cntx) {
-  ResultStringVec result_set(shard_set->size(), OpStatus::SKIPPED);
-
-  auto cb = [&](Transaction* t, EngineShard* shard) {
-    result_set[shard->shard_id()] = OpInter(t, shard, false);
-
-    return OpStatus::OK;
-  };
-
-  cntx->transaction->ScheduleSingleHop(std::move(cb));
-  OpResult<SvArray> result = InterResultVec(result_set, cntx->transaction->GetUniqueShardCnt());
+  OpResult<StringVec> result = InterMultiShard(cntx->transaction, nullopt, 0, true);
   if (result) {
-    SvArray arr = std::move(*result);
+    SvArray arr{result->begin(), result->end()};
     if (cntx->conn_state.script_info) {  // sort under script
       sort(arr.begin(), arr.end());
     }
@@ -1311,42 +1659,27 @@ void SInter(CmdArgList args, ConnectionContext* cntx) {
 }
 
 void SInterStore(CmdArgList args, ConnectionContext* cntx) {
-  ResultStringVec result_set(shard_set->size(), OpStatus::SKIPPED);
   string_view dest_key = ArgS(args, 0);
-  ShardId dest_shard = Shard(dest_key, result_set.size());
-  atomic_uint32_t inter_shard_cnt{0};
+  ShardId dest_shard = Shard(dest_key, shard_set->size());
 
-  auto inter_cb = [&](Transaction* t, EngineShard* shard) {
-    ShardArgs largs = t->GetShardArgs(shard->shard_id());
-    if (shard->shard_id() == dest_shard) {
-      CHECK_EQ(largs.Front(), dest_key);
-      if (largs.Size() == 1)
-        return OpStatus::OK;
-    }
-    inter_shard_cnt.fetch_add(1, memory_order_relaxed);
-    result_set[shard->shard_id()] = OpInter(t, shard, shard->shard_id() == dest_shard);
-    return OpStatus::OK;
-  };
-
-  cntx->transaction->Execute(std::move(inter_cb), false);
-
-  OpResult<SvArray> result = InterResultVec(result_set, inter_shard_cnt.load(memory_order_relaxed));
+  OpResult<StringVec> result = InterMultiShard(cntx->transaction, dest_shard, 0, false);
   if (!result) {
     cntx->transaction->Conclude();
     cntx->SendError(result.status());
     return;
   }
 
+  SvArray members{result->begin(), result->end()};
   auto store_cb = [&](Transaction* t, EngineShard* shard) {
     if (shard->shard_id() == dest_shard) {
-      OpAdd(t->GetOpArgs(shard), dest_key, result.value(), true, true);
+      OpAdd(t->GetOpArgs(shard), dest_key, members, true, true);
     }
 
     return OpStatus::OK;
   };
 
   cntx->transaction->Execute(std::move(store_cb), true);
-  cntx->SendLong(result->size());
+  cntx->SendLong(members.size());
 }
 
 void SInterCard(CmdArgList args, ConnectionContext* cntx) {
@@ -1361,15 +1694,9 @@ void SInterCard(CmdArgList args, ConnectionContext* cntx) {
   } else if (args.size() > (num_keys + 1))
     return cntx->SendError(kSyntaxErr);
 
-  ResultStringVec result_set(shard_set->size(), OpStatus::SKIPPED);
-  auto cb = [&](Transaction* t, EngineShard* shard) {
-    result_set[shard->shard_id()] = OpInter(t, shard, false);
-    return OpStatus::OK;
-  };
-
-  cntx->transaction->ScheduleSingleHop(std::move(cb));
-  OpResult<SvArray> result =
-      InterResultVec(result_set, cntx->transaction->GetUniqueShardCnt(), limit);
+  OpResult<StringVec> result = InterMultiShard(cntx->transaction, nullopt, limit, true);
+  if (!result)
+    return cntx->SendError(result.status());
 
   return cntx->SendLong(result->size());
 }
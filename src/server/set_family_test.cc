@@ -4,6 +4,10 @@
 
 #include "server/set_family.h"
 
+#include <absl/container/flat_hash_set.h>
+#include <absl/flags/reflection.h>
+
+#include "base/flags.h"
 #include "base/gtest.h"
 #include "base/logging.h"
 #include "facade/facade_test.h"
@@ -15,6 +19,8 @@ using namespace std;
 using namespace util;
 using namespace boost;
 
+ABSL_DECLARE_FLAG(uint32_t, cmd_slice_max_bytes);
+
 namespace dfly {
 
 class SetFamilyTest : public BaseFamilyTest {
@@ -109,6 +115,30 @@ TEST_F(SetFamilyTest, SInter) {
   EXPECT_THAT(resp, IntArg(0));
 }
 
+TEST_F(SetFamilyTest, IntSetAlgebra) {
+  Run({"sadd", "s1", "1", "2", "3", "4", "-5"});
+  Run({"sadd", "s2", "3", "4", "-5", "100000000000"});
+  Run({"sadd", "s3", "4", "-5", "x"});
+
+  auto resp = Run({"sinter", "s1", "s2"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("3", "4", "-5"));
+  resp = Run({"sinter", "s1", "s2", "s3"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("4", "-5"));
+
+  resp = Run({"sunion", "s1", "s2"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("1", "2", "3", "4", "-5", "100000000000"));
+  resp = Run({"sunion", "s1", "s3"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("1", "2", "3", "4", "-5", "x"));
+
+  resp = Run({"sdiff", "s1", "s2"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("1", "2"));
+  resp = Run({"sdiff", "s2", "s1", "s3"});
+  EXPECT_THAT(resp, "100000000000");
+
+  resp = Run({"smismember", "s1", "4", "x", "1", "4", "5"});
+  EXPECT_THAT(resp.GetVec(), ElementsAre("1", "0", "1", "1", "0"));
+}
+
 TEST_F(SetFamilyTest, SInterCard) {
   Run({"sadd", "s1", "2", "b", "1", "a"});
   Run({"sadd", "s2", "3", "c", "2", "b"});
@@ -134,6 +164,31 @@ TEST_F(SetFamilyTest, SInterCard) {
   EXPECT_THAT(resp, ErrArg("value is not an integer or out of range"));
 }
 
+TEST_F(SetFamilyTest, SInterLarge) {
+  // Large sets are intersected by probing the members of the smallest set on other shards.
+  vector<string> cmd{"sadd", "big1"}, cmd2{"sadd", "big2"};
+  for (unsigned i = 0; i < 2000; ++i) {
+    cmd.push_back(absl::StrCat("m", i));
+    cmd2.push_back(absl::StrCat("m", i * 2));
+  }
+  Run(absl::MakeSpan(cmd));
+  Run(absl::MakeSpan(cmd2));
+  Run({"sadd", "small", "m2", "m3", "m4", "m4000"});
+
+  EXPECT_EQ(1000, CheckedInt({"sintercard", "2", "big1", "big2"}));
+  EXPECT_EQ(10, CheckedInt({"sintercard", "2", "big1", "big2", "LIMIT", "10"}));
+  EXPECT_EQ(2, CheckedInt({"sintercard", "3", "big1", "big2", "small"}));
+
+  auto resp = Run({"sinter", "big2", "small", "big1"});
+  EXPECT_THAT(resp.GetVec(), UnorderedElementsAre("m2", "m4"));
+  EXPECT_EQ(1000, CheckedInt({"sinterstore", "dest", "big1", "big2"}));
+  EXPECT_EQ(1000, CheckedInt({"scard", "dest"}));
+
+  EXPECT_EQ(0, CheckedInt({"sintercard", "3", "big1", "big2", "nokey"}));
+  Run({"set", "str", "foo"});
+  EXPECT_THAT(Run({"sinter", "big1", "big2", "str"}), ErrArg("WRONGTYPE"));
+}
+
 TEST_F(SetFamilyTest, SMove) {
   auto resp = Run({"sadd", "a", "1", "2", "3", "4"});
   Run({"sadd", "b", "3", "5", "6", "2"});
@@ -353,4 +408,42 @@ TEST_F(SetFamilyTest, SScan) {
   EXPECT_THAT(vec.size(), 0);
 }
 
+TEST_F(SetFamilyTest, SMembersSlicedConcurrentWrites) {
+  absl::FlagSaver fs;
+  absl::SetFlag(&FLAGS_cmd_slice_max_bytes, 64);
+
+  vector<string> args{"sadd", "key"};
+  for (unsigned i = 0; i < 1000; ++i)
+    args.push_back(absl::StrCat("m", i));
+  Run(absl::MakeSpan(args));
+
+  // Writes to the key wait for the sliced read to finish, writes to other keys run between
+  // the slices.
+  atomic_bool done = false;
+  auto writer = pp_->at(1)->LaunchFiber([&] {
+    for (unsigned i = 0; !done; ++i) {
+      Run("writer", {"sadd", "key", absl::StrCat("w", i)});
+      Run("writer", {"sadd", "other", absl::StrCat("w", i)});
+    }
+  });
+
+  for (unsigned round = 0; round < 5; ++round) {
+    auto resp = Run({"smembers", "key"});
+    ASSERT_EQ(resp.type, RespExpr::ARRAY);
+
+    // No member is missing or repeated, and the added members are a prefix of the writes.
+    absl::flat_hash_set<string> members;
+    for (const auto& member : resp.GetVec())
+      ASSERT_TRUE(members.insert(member.GetString()).second);
+    ASSERT_GE(members.size(), 1000u);
+    for (unsigned i = 0; i < 1000; ++i)
+      ASSERT_TRUE(members.contains(absl::StrCat("m", i)));
+    for (unsigned i = 0; i < members.size() - 1000; ++i)
+      ASSERT_TRUE(members.contains(absl::StrCat("w", i)));
+  }
+
+  done = true;
+  writer.Join();
+}
+
 }  // namespace dfly
@@ -102,6 +102,8 @@ void DbTable::Clear() {
   expire.Clear();
   mcflag.Clear();
   stats = DbTableStats{};
+  member_expiry_keys.clear();
+  member_expiry_heap = {};
 }
 
 PrimeIterator DbTable::Launder(PrimeIterator it, string_view key) {
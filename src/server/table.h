@@ -8,6 +8,7 @@
 
 #include <boost/smart_ptr/intrusive_ptr.hpp>
 #include <boost/smart_ptr/intrusive_ref_counter.hpp>
+#include <queue>
 
 #include "core/expire_period.h"
 #include "core/intent_lock.h"
@@ -130,6 +131,13 @@ struct DbTable : boost::intrusive_ref_counter<DbTable, boost::thread_unsafe_coun
   std::vector<SlotStats> slots_stats;
   ExpireTable::Cursor expire_cursor;
 
+  // Hashes and sets with member ttls by the next expiry time of their members. The min-heap may
+  // hold stale records, the time in member_expiry_keys is the valid one.
+  using MemberExpiryRecord = std::pair<uint32_t, std::string>;
+  absl::flat_hash_map<std::string, uint32_t> member_expiry_keys;
+  std::priority_queue<MemberExpiryRecord, std::vector<MemberExpiryRecord>, std::greater<>>
+      member_expiry_heap;
+
   TopKeys top_keys;
   DbIndex index;
   uint32_t thread_index;
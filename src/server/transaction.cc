@@ -628,6 +628,7 @@ void Transaction::RunCallback(EngineShard* shard) {
 
   RunnableResult result;
   shard->db_slice().LockChangeCb();
+  shard->db_slice().SetNoLoopClientId(noloop_client_id_);
   try {
     result = (*cb_ptr_)(this, shard);
 
@@ -837,6 +838,7 @@ void Transaction::Execute(RunnableType cb, bool conclude) {
   DispatchHop();
   run_barrier_.Wait();
   cb_ptr_ = nullptr;
+  AwaitJournalDurable();
 
   if (coordinator_state_ & COORD_CONCLUDING)
     coordinator_state_ &= ~COORD_SCHED;
@@ -896,6 +898,17 @@ void Transaction::DispatchHop() {
   });
 }
 
+void Transaction::AwaitJournalDurable() {
+  auto* journal = ServerState::tlocal()->journal();
+  if (!journal || !journal->IsSyncDurable() || !cid_ || cid_->IsReadOnly())
+    return;
+
+  IterateActiveShards([journal](auto& sd, auto i) {
+    if (!journal->AwaitDurable(i))
+      LOG_EVERY_T(ERROR, 1) << "Journal file of shard " << i << " could not be written";
+  });
+}
+
 void Transaction::FinishHop() {
   boost::intrusive_ptr<Transaction> guard(this);  // Keep alive until Dec() fully finishes
   run_barrier_.Dec();
@@ -1167,13 +1180,16 @@ ShardArgs Transaction::GetShardArgs(ShardId sid) const {
 }
 
 OpStatus Transaction::WaitOnWatch(const time_point& tp, WaitKeysProvider wkeys_provider,
-                                  KeyReadyChecker krc, bool* block_flag, bool* pause_flag) {
+                                  KeyReadyChecker krc, bool* block_flag, bool* pause_flag,
+                                  const WakeCb* wake_cb) {
   if (blocking_barrier_.IsClaimed()) {  // Might have been cancelled ahead by a dropping connection
     Conclude();
     return OpStatus::CANCELLED;
   }
 
   DCHECK(!IsAtomicMulti());  // blocking inside MULTI is not allowed
+  DCHECK(!wake_cb || unique_shard_cnt_ == 1);
+  wake_cb_ = wake_cb;
 
   // Register keys on active shards blocking controllers and mark shard state as suspended.
   auto cb = [&](Transaction* t, EngineShard* shard) {
@@ -1197,6 +1213,15 @@ OpStatus Transaction::WaitOnWatch(const time_point& tp, WaitKeysProvider wkeys_p
 
   DVLOG(1) << "WaitOnWatch done " << int(status) << " " << DebugId();
   --stats->num_blocked_clients;
+  wake_cb_ = nullptr;
+
+  // The shard that woke us already ran the action and concluded, we only wait for its journal.
+  if (status != cv_status::timeout && unique_shard_cnt_ == 1 &&
+      (shard_data_[SidToId(unique_shard_id_)].local_mask & SERVED_ON_WAKE)) {
+    coordinator_state_ &= ~COORD_SCHED;
+    AwaitJournalDurable();
+    return OpStatus::OK;
+  }
 
   *pause_flag = true;
   ServerState::tlocal()->AwaitPauseState(true);  // blocking are always write commands
@@ -1252,6 +1277,7 @@ OpStatus Transaction::RunSquashedMultiCb(RunnableType cb) {
 
   auto* shard = EngineShard::tlocal();
   shard->db_slice().LockChangeCb();
+  shard->db_slice().SetNoLoopClientId(noloop_client_id_);
   auto result = cb(this, shard);
   shard->db_slice().OnCbFinish();
   LogAutoJournalOnShard(shard, result);
@@ -1319,7 +1345,8 @@ bool Transaction::IsGlobal() const {
 // Runs only in the shard thread.
 // Returns true if the transacton has changed its state from suspended to awakened,
 // false, otherwise.
-bool Transaction::NotifySuspended(TxId committed_txid, ShardId sid, string_view key) {
+bool Transaction::NotifySuspended(TxId committed_txid, ShardId sid, string_view key,
+                                  bool* served) {
   // Wake a transaction only once on the first notify.
   // We don't care about preserving the strict order with multiple operations running on blocking
   // keys in parallel, because the internal order is not observable from outside either way.
@@ -1345,10 +1372,35 @@ bool Transaction::NotifySuspended(TxId committed_txid, ShardId sid, string_view
   sd.local_mask |= AWAKED_Q;
   sd.wake_key_pos = it.index();
 
+  if (served && wake_cb_) {
+    ServeOnWakeInShard(EngineShard::tlocal(), key);
+    *served = true;
+  }
+
   blocking_barrier_.Close();
   return true;
 }
 
+void Transaction::ServeOnWakeInShard(EngineShard* shard, string_view key) {
+  auto& sd = shard_data_[SidToId(shard->shard_id())];
+  sd.stats.total_runs++;
+  DCHECK(coordinator_state_ & COORD_CONCLUDING);  // set by the hop of WaitOnWatch
+
+  auto cb = [this, key](Transaction* t, EngineShard* shard) -> RunnableResult {
+    (*wake_cb_)(t, shard, key);
+    return OpStatus::OK;
+  };
+  RunnableType runnable{cb};
+  cb_ptr_ = &runnable;
+  RunCallback(shard);
+
+  // Suspended transactions keep their locks, release them like the concluding hop would.
+  DCHECK(sd.local_mask & KEYLOCK_ACQUIRED);
+  shard->db_slice().Release(LockMode(), GetLockArgs(shard->shard_id()));
+  sd.local_mask &= ~(KEYLOCK_ACQUIRED | OUT_OF_ORDER);
+  sd.local_mask |= SERVED_ON_WAKE;
+}
+
 optional<string_view> Transaction::GetWakeKey(ShardId sid) const {
   auto& sd = shard_data_[SidToId(sid)];
   if ((sd.local_mask & AWAKED_Q) == 0)
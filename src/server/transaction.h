@@ -135,6 +135,9 @@ class Transaction {
   using WaitKeysProvider =
       std::function<std::variant<ShardArgs, ArgSlice>(Transaction*, EngineShard* shard)>;
 
+  // Action of a blocking transaction, run on the shard with the key that woke it.
+  using WakeCb = std::function<void(Transaction*, EngineShard*, std::string_view /* key */)>;
+
   // Modes in which a multi transaction can run.
   enum MultiMode {
     // Invalid state.
@@ -167,6 +170,7 @@ class Transaction {
     AWAKED_Q = 1 << 5,         // Whether it was awakened (by NotifySuspended())
     UNLOCK_MULTI = 1 << 6,     // Whether this shard executed UnlockMultiShardCb
     RAN_IMMEDIATELY = 1 << 7,  // Whether the shard executed immediately (during schedule)
+    SERVED_ON_WAKE = 1 << 8,   // Whether it ran its WakeCb and concluded in NotifySuspended()
   };
 
   explicit Transaction(const CommandId* cid);
@@ -205,12 +209,18 @@ class Transaction {
   // or b) tp is reached. If tp is time_point::max() then waits indefinitely.
   // Expects that the transaction had been scheduled before, and uses Execute(.., true) to register.
   // Returns false if timeout occurred, true if was notified by one of the keys.
+  // wake_cb can be set by single shard transactions that watch a single key. The shard may then
+  // run it and conclude the transaction as soon as the key is ready, in which case the
+  // transaction is no longer scheduled when OK is returned.
   facade::OpStatus WaitOnWatch(const time_point& tp, WaitKeysProvider cb, KeyReadyChecker krc,
-                               bool* block_flag, bool* pause_flag);
+                               bool* block_flag, bool* pause_flag,
+                               const WakeCb* wake_cb = nullptr);
 
   // Returns true if transaction is awaked, false if it's timed-out and can be removed from the
-  // blocking queue.
-  bool NotifySuspended(TxId committed_ts, ShardId sid, std::string_view key);
+  // blocking queue. If served is not null, a transaction that passed a wake_cb to WaitOnWatch
+  // runs it right away and concludes, and *served is set to true.
+  bool NotifySuspended(TxId committed_ts, ShardId sid, std::string_view key,
+                       bool* served = nullptr);
 
   // Cancel all blocking watches. Set COORD_CANCELLED.
   // Must be called from coordinator thread.
@@ -365,6 +375,12 @@ class Transaction {
     tracking_cb_ = std::move(f);
   }
 
+  // Client id of a NOLOOP broadcasting tracking connection that runs the transaction,
+  // so that its own writes are not broadcast back to it.
+  void SetNoLoopClientId(uint32_t client_id) {
+    noloop_client_id_ = client_id;
+  }
+
   void MaybeInvokeTrackingCb() {
     if (tracking_cb_) {
       tracking_cb_(this);
@@ -522,6 +538,10 @@ class Transaction {
   // Finish hop, decrement run barrier
   void FinishHop();
 
+  // With journal_fsync=always, waits until the journal entries of the active shards are
+  // durable, so that the reply of a write command is not sent before.
+  void AwaitJournalDurable();
+
   // Run actual callback on shard, store result if single shard or OOM was catched
   void RunCallback(EngineShard* shard);
 
@@ -534,6 +554,10 @@ class Transaction {
 
   void ExpireShardCb(std::variant<ShardArgs, ArgSlice> keys, EngineShard* shard);
 
+  // Runs wake_cb_ for the key in the shard that woke the transaction and concludes the
+  // transaction there, instead of in a hop of the coordinator.
+  void ServeOnWakeInShard(EngineShard* shard, std::string_view key);
+
   // Returns true if we need to follow up with PollExecution on this shard.
   bool CancelShardCb(EngineShard* shard);
 
@@ -618,6 +642,7 @@ class Transaction {
   bool re_enabled_auto_journal_ = false;
 
   RunnableType* cb_ptr_ = nullptr;    // Run on shard threads
+  const WakeCb* wake_cb_ = nullptr;   // Set while blocked in WaitOnWatch
   const CommandId* cid_ = nullptr;    // Underlying command
   std::unique_ptr<MultiData> multi_;  // Initialized when the transaction is multi/exec.
 
@@ -649,6 +674,7 @@ class Transaction {
   } stats_;
 
   std::function<void(Transaction* trans)> tracking_cb_;
+  uint32_t noloop_client_id_ = 0;
 
  private:
   struct TLTmpSpace {
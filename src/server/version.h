@@ -36,8 +36,11 @@ enum class DflyVersion {
   // - Periodic lag checks from master to replica
   VER4,
 
+  // - Resumes broken full sync flows with DFLY FLOW ... RESUME <offset>
+  VER5,
+
   // Always points to the latest version
-  CURRENT_VER = VER4,
+  CURRENT_VER = VER5,
 };
 
 }  // namespace dfly
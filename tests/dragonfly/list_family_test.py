@@ -3,6 +3,9 @@ from redis import asyncio as aioredis
 
 import pytest
 
+from . import dfly_args
+from .instance import DflyInstance
+
 
 @pytest.mark.parametrize("index", range(50))
 class TestBlPop:
@@ -20,3 +23,41 @@ class TestBlPop:
     async def test_blpop_multiple_keys(self, async_client: aioredis.Redis, index):
         await TestBlPop.blpop_mult_keys(async_client, "list1{t}", "a")
         await TestBlPop.blpop_mult_keys(async_client, "list2{t}", "b")
+
+
+"""
+Test that the replies of pipelined LRANGE commands on a big list are written in slices of at most
+cmd_slice_max_bytes, instead of being batched whole in the connection.
+"""
+
+
+@dfly_args(
+    {
+        "proactor_threads": 2,
+        "cmd_slice_max_bytes": 4096,
+        "cmd_slice_write_wait_usec": 1000000,
+    }
+)
+async def test_pipelined_lrange_bounded(async_client: aioredis.Redis, df_server: DflyInstance):
+    num_elements, value = 20000, "x" * 100
+    for _ in range(0, num_elements, 1000):
+        await async_client.rpush("list", *([value] * 1000))
+
+    reply_len = len(f"*{num_elements}\r\n") + num_elements * len(f"$100\r\n{value}\r\n")
+    num_commands = 4
+
+    before = await async_client.info("stats")
+    reader, writer = await asyncio.open_connection("127.0.0.1", df_server.port)
+    writer.write(b"LRANGE list 0 -1\r\n" * num_commands)
+    await writer.drain()
+    await asyncio.wait_for(reader.readexactly(num_commands * reply_len), timeout=10)
+    writer.close()
+    await writer.wait_closed()
+    after = await async_client.info("stats")
+
+    # Every write holds at most one slice and the batched replies before it, so a reply that was
+    # batched whole would show up as a handful of huge writes.
+    writes = after["total_writes_processed"] - before["total_writes_processed"]
+    written = after["total_net_output_bytes"] - before["total_net_output_bytes"]
+    assert written >= num_commands * reply_len
+    assert writes * 2 * 4096 >= written
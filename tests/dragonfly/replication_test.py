@@ -2203,3 +2203,160 @@ async def test_replica_reconnect(df_local_factory, break_conn):
     assert await c_replica.execute_command("get k") == "6789"
 
     await disconnect_clients(c_master, c_replica)
+
+
+@pytest.mark.asyncio
+async def test_replication_shm(df_local_factory, df_seeder_factory):
+    master = df_local_factory.create(proactor_threads=4)
+    replica = df_local_factory.create(proactor_threads=2)
+    df_local_factory.start_all([master, replica])
+
+    seeder = df_seeder_factory.create(port=master.port, keys=2000)
+    await seeder.run(target_deviation=0.1)
+
+    c_master = master.client()
+    c_replica = replica.client()
+
+    # Full sync and stable sync both go over the shared memory rings
+    await c_replica.execute_command(f"REPLICAOF localhost {master.port} SHM")
+    await wait_available_async(c_replica)
+
+    # The replica unlinks the rings once the master mapped them
+    ring_prefix = f"dfly_repl_{replica.proc.pid}_"
+    assert not [f for f in os.listdir("/dev/shm") if f.startswith(ring_prefix)]
+
+    await seeder.run(target_ops=2000)
+    await check_all_replicas_finished([c_replica], c_master)
+
+    capture = await seeder.capture()
+    assert await seeder.compare(capture, replica.port)
+
+    await disconnect_clients(c_master, c_replica)
+
+
+@dfly_args({"proactor_threads": 2})
+async def test_replication_read_your_writes(df_local_factory):
+    master = df_local_factory.create()
+    replica = df_local_factory.create()
+    df_local_factory.start_all([master, replica])
+
+    c_master = master.client()
+    c_replica = replica.client()
+
+    await c_replica.execute_command(f"REPLICAOF localhost {master.port}")
+    await wait_available_async(c_replica)
+
+    for i in range(100):
+        await c_master.set(f"key{i}", f"value{i}")
+    token = await c_master.execute_command("REPLTOKEN")
+
+    assert await c_replica.execute_command("REPLTOKEN", "WAIT", token, 5000) == 1
+    assert await c_replica.get("key99") == "value99"
+
+    # A token ahead of what the replica applied times out
+    master_id, lsns = token.split(":")
+    ahead = ",".join(str(int(lsn) + 1000) for lsn in lsns.split(","))
+    assert await c_replica.execute_command("REPLTOKEN", "WAIT", f"{master_id}:{ahead}", 100) == 0
+
+    # The master has applied its own writes, tokens from other masters are rejected
+    assert await c_master.execute_command("REPLTOKEN", "WAIT", token, 0) == 1
+    with pytest.raises(redis.exceptions.ResponseError):
+        await c_replica.execute_command("REPLTOKEN", "WAIT", "other:1,1", 0)
+
+    await disconnect_clients(c_master, c_replica)
+
+
+@dfly_args({"proactor_threads": 2})
+async def test_replication_wait(df_local_factory):
+    master = df_local_factory.create()
+    replicas = [df_local_factory.create() for _ in range(2)]
+    df_local_factory.start_all([master, *replicas])
+
+    c_master = master.client()
+    c_replicas = [replica.client() for replica in replicas]
+
+    for c_replica in c_replicas:
+        await c_replica.execute_command(f"REPLICAOF localhost {master.port}")
+        await wait_available_async(c_replica)
+
+    for i in range(100):
+        await c_master.set(f"key{i}", f"value{i}")
+
+    # The replicas acknowledge right away, far before their periodic ACKs
+    start = time.time()
+    assert await c_master.execute_command("WAIT", 2, 10000) == 2
+    assert time.time() - start < 2
+    for c_replica in c_replicas:
+        assert await c_replica.get("key99") == "value99"
+
+    # Times out when asking for more replicas than there are
+    assert await c_master.execute_command("WAIT", 3, 200) == 2
+
+    with pytest.raises(redis.exceptions.ResponseError):
+        await c_replicas[0].execute_command("WAIT", 1, 0)
+
+    await disconnect_clients(c_master, *c_replicas)
+
+
+@pytest.mark.slow
+async def test_resume_full_sync_flow(df_local_factory):
+    master = df_local_factory.create(proactor_threads=4)
+    replica = df_local_factory.create(proactor_threads=2)
+    df_local_factory.start_all([master, replica])
+
+    c_master = master.client()
+    c_replica = replica.client()
+
+    seeder = SeederV2(key_target=100_000)
+    await seeder.run(c_master, target_deviation=0.1)
+
+    await c_replica.execute_command(f"REPLICAOF localhost {master.port}")
+    async with async_timeout.timeout(3):
+        await wait_for_replicas_state(c_replica, state="full_sync", timeout=0.05)
+    syncid, _ = await c_replica.execute_command("DEBUG REPLICA OFFSET")
+
+    # Break a single flow connection in the middle of the full sync
+    flows = [c for c in await c_master.client_list() if c["name"].startswith("repl_flow")]
+    assert flows
+    await c_master.execute_command("CLIENT KILL ID", flows[0]["id"])
+    if (await c_replica.role())[3] != "full_sync":
+        logging.error("!!! Full sync finished too fast. Adjust test parameters !!!")
+        return
+
+    # The flow resumes, the sync is not restarted
+    async with async_timeout.timeout(30):
+        await wait_for_replicas_state(c_replica)
+    assert (await c_replica.execute_command("DEBUG REPLICA OFFSET"))[0] == syncid
+
+    await check_all_replicas_finished([c_replica], c_master)
+    hash1, hash2 = await asyncio.gather(*(SeederV2.capture(c) for c in (c_master, c_replica)))
+    assert hash1 == hash2
+
+    await disconnect_clients(c_master, c_replica)
+
+
+@dfly_args({"proactor_threads": 2})
+async def test_replica_expires_members(df_local_factory):
+    master = df_local_factory.create()
+    replica = df_local_factory.create()
+    df_local_factory.start_all([master, replica])
+
+    c_master = master.client()
+    c_replica = replica.client()
+
+    await c_replica.execute_command(f"REPLICAOF localhost {master.port}")
+    await wait_available_async(c_replica)
+
+    for i in range(100):
+        await c_master.execute_command("HSETEX", "hash", 1, f"f{i}", "v")
+    await c_master.hset("hash", "keep", "v")
+    await check_all_replicas_finished([c_replica], c_master)
+    assert await c_replica.hlen("hash") == 101
+
+    # Member deletions are not replicated, the replica sweeps its expired members itself
+    async with async_timeout.timeout(10):
+        while await c_replica.hlen("hash") != 1:
+            await asyncio.sleep(0.1)
+    assert (await c_replica.info("stats"))["expired_members"] > 0
+
+    await disconnect_clients(c_master, c_replica)
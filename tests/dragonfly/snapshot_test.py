@@ -243,6 +243,31 @@ async def test_info_persistence_field(async_client):
     assert "loading:0" in (await async_client.execute_command("INFO PERSISTENCE"))
 
 
+@dfly_args(
+    {
+        **BASIC_ARGS,
+        "dbfilename": "test-journal-always",
+        "journal_dir": "{DRAGONFLY_TMP}/journal",
+        "journal_fsync": "always",
+    }
+)
+async def test_journal_fsync_always(df_server):
+    """Acknowledged writes survive a crash with journal_fsync=always"""
+    client = df_server.client()
+    for i in range(100):
+        await client.set(f"key{i}", i)
+    assert "journal_write_error:0" in await client.execute_command("INFO PERSISTENCE")
+
+    await client.connection_pool.disconnect()
+    df_server.stop(kill=True)
+    df_server.start()
+    client = df_server.client()
+
+    await wait_available_async(client)
+    assert await client.mget([f"key{i}" for i in range(100)]) == [str(i) for i in range(100)]
+    await client.connection_pool.disconnect()
+
+
 # If DRAGONFLY_S3_BUCKET is configured, AWS credentials must also be
 # configured.
 @pytest.mark.skipif(